@@ -0,0 +1,174 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Persistent helper threads that share the work of one audio block.
+//------------------------------------------------------------------------
+
+#include "audioWorkerPool.hpp"
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#include <immintrin.h>
+#define DELAY2_SPIN_PAUSE() _mm_pause()
+#elif defined(__aarch64__) || defined(__arm__)
+#define DELAY2_SPIN_PAUSE() __asm__ __volatile__("yield")
+#else
+#define DELAY2_SPIN_PAUSE() ((void)0)
+#endif
+
+namespace {
+
+// Polls before a helper goes to sleep, a few tens of microseconds
+const int kSpinCount = 2000;
+
+uint64_t makeClaim(uint32_t generation, int numTasks, int next)
+{
+    return uint64_t(generation) << 32 | uint64_t(numTasks) << 16 | uint64_t(next);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+AudioWorkerPool::AudioWorkerPool()
+{
+    m_Claim = 0;
+    m_Generation = 0;
+    m_Finished = 0;
+    m_Task = nullptr;
+    m_Context = nullptr;
+    m_Running = false;
+    m_Sleeping = 0;
+}
+
+//------------------------------------------------------------------------
+AudioWorkerPool::~AudioWorkerPool()
+{
+    stop();
+}
+
+//------------------------------------------------------------------------
+void AudioWorkerPool::start(int numWorkers)
+{
+    const int hardwareThreads = static_cast<int>(std::thread::hardware_concurrency());
+    numWorkers = std::min(numWorkers, kMaxWorkers);
+    if (hardwareThreads > 0)
+        numWorkers = std::min(numWorkers, hardwareThreads - 1);
+    numWorkers = std::max(numWorkers, 0);
+    if (numWorkers == getNumWorkers())
+        return;
+
+    stop();
+    m_Running = true;
+    for (int w = 0; w < numWorkers; w++)
+        m_Threads.emplace_back(&AudioWorkerPool::work, this);
+}
+
+//------------------------------------------------------------------------
+void AudioWorkerPool::stop()
+{
+    if (m_Threads.empty())
+        return;
+    {
+        std::lock_guard<std::mutex> lock(m_SleepMutex);
+        m_Running = false;
+    }
+    m_Wake.notify_all();
+    for (std::thread& thread : m_Threads)
+        thread.join();
+    m_Threads.clear();
+}
+
+//------------------------------------------------------------------------
+void AudioWorkerPool::run(Task task, void* context, int numTasks)
+{
+    numTasks = std::min(numTasks, kMaxTasks);
+    if (m_Threads.empty() || numTasks <= 1)
+    {
+        for (int i = 0; i < numTasks; i++)
+            task(context, i);
+        return;
+    }
+
+    // The previous run has finished completely, so nobody reads these any more
+    m_Task.store(task, std::memory_order_relaxed);
+    m_Context.store(context, std::memory_order_relaxed);
+    m_Finished.store(0, std::memory_order_relaxed);
+    const uint32_t generation = m_Generation.load(std::memory_order_relaxed) + 1;
+    m_Claim.store(makeClaim(generation, numTasks, 0), std::memory_order_release);
+    m_Generation.store(generation, std::memory_order_seq_cst);
+
+    // Only sleeping helpers need the kernel. A helper counts itself as sleeping before it checks
+    // the generation, so either it sees this run or it is counted here. It holds the mutex from
+    // that check until it waits, so passing through the mutex makes sure the notify reaches it.
+    // try_lock keeps the audio thread from sleeping on it; the helper only holds it briefly.
+    if (m_Sleeping.load(std::memory_order_seq_cst) > 0)
+    {
+        while (!m_SleepMutex.try_lock())
+            DELAY2_SPIN_PAUSE();
+        m_SleepMutex.unlock();
+        m_Wake.notify_all();
+    }
+
+    int index = 0;
+    while (claim(generation, index))
+    {
+        task(context, index);
+        m_Finished.fetch_add(1, std::memory_order_release);
+    }
+
+    // Whatever is left is already running on a helper
+    while (m_Finished.load(std::memory_order_acquire) < numTasks)
+        DELAY2_SPIN_PAUSE();
+}
+
+//------------------------------------------------------------------------
+bool AudioWorkerPool::claim(uint32_t generation, int& index)
+{
+    uint64_t claim = m_Claim.load(std::memory_order_acquire);
+    while (true)
+    {
+        const int numTasks = static_cast<int>((claim >> 16) & 0xFFFF);
+        const int next = static_cast<int>(claim & 0xFFFF);
+        if (static_cast<uint32_t>(claim >> 32) != generation || next >= numTasks)
+            return false;
+        if (m_Claim.compare_exchange_weak(claim, claim + 1, std::memory_order_acq_rel, std::memory_order_acquire))
+        {
+            index = next;
+            return true;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+void AudioWorkerPool::work()
+{
+    uint32_t seen = m_Generation.load(std::memory_order_acquire);
+    while (m_Running.load(std::memory_order_relaxed))
+    {
+        // Spin for a while, then sleep until a run wakes us
+        uint32_t generation = m_Generation.load(std::memory_order_acquire);
+        for (int spin = 0; generation == seen && spin < kSpinCount; spin++)
+        {
+            DELAY2_SPIN_PAUSE();
+            generation = m_Generation.load(std::memory_order_acquire);
+        }
+        if (generation == seen)
+        {
+            std::unique_lock<std::mutex> lock(m_SleepMutex);
+            m_Sleeping.fetch_add(1, std::memory_order_seq_cst);
+            m_Wake.wait(lock, [this, seen] {
+                return !m_Running.load(std::memory_order_relaxed)
+                    || m_Generation.load(std::memory_order_seq_cst) != seen;
+            });
+            m_Sleeping.fetch_sub(1, std::memory_order_relaxed);
+            continue;
+        }
+
+        seen = generation;
+        int index = 0;
+        while (claim(generation, index))
+        {
+            m_Task.load(std::memory_order_relaxed)(m_Context.load(std::memory_order_relaxed), index);
+            m_Finished.fetch_add(1, std::memory_order_release);
+        }
+    }
+}
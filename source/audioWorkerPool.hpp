@@ -0,0 +1,77 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Persistent helper threads that share the work of one audio block.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+//------------------------------------------------------------------------
+//  AudioWorkerPool
+//------------------------------------------------------------------------
+// Runs the independent parts of a block (channel groups) on the calling
+// audio thread and a few helper threads, and returns once all of them are
+// done. The threads are started and stopped outside of processing.
+//
+// Handing out work never takes a lock: a run publishes one atomic word with
+// its generation, task count and next task, and every thread claims tasks
+// from it with a compare-exchange. The audio thread claims tasks too, so a
+// helper that is slow to wake only costs parallelism, never the deadline.
+// Helpers spin briefly after each run, since the next block usually follows
+// soon, then sleep without a timeout until a run wakes them. Waking them only
+// spins on try_lock, so the audio thread never sleeps on the mutex.
+class AudioWorkerPool
+{
+public:
+    // Called once per task index of a run
+    typedef void (*Task)(void* context, int index);
+
+    static const int kMaxWorkers = 15;
+    static const int kMaxTasks = 0xFFFF;
+
+    AudioWorkerPool();
+    ~AudioWorkerPool();
+
+    AudioWorkerPool(const AudioWorkerPool&) = delete;
+    AudioWorkerPool& operator=(const AudioWorkerPool&) = delete;
+
+    /** Starts 'numWorkers' helper threads, at most kMaxWorkers and one less than the hardware
+        threads. Keeps the current threads if the count is the same. Not for the audio thread. */
+    void start(int numWorkers);
+
+    /** Joins the helper threads. Not for the audio thread. */
+    void stop();
+
+    int getNumWorkers() const { return static_cast<int>(m_Threads.size()); }
+
+    /** Runs task(context, i) for every i below 'numTasks' on the calling thread and the helpers,
+        and returns once all have finished. Without helpers the tasks simply run in order here. */
+    void run(Task task, void* context, int numTasks);
+
+private:
+    void work();
+
+    // Takes the next task of generation 'generation' from m_Claim, false once none is left
+    bool claim(uint32_t generation, int& index);
+
+    // Generation in the upper 32 bits, task count and next task index in 16 bits each
+    std::atomic<uint64_t> m_Claim;
+    std::atomic<uint32_t> m_Generation;
+    std::atomic<int> m_Finished;
+
+    // Read after a successful claim, which orders them behind the run that set them
+    std::atomic<Task> m_Task;
+    std::atomic<void*> m_Context;
+
+    std::atomic<bool> m_Running;
+    std::atomic<int> m_Sleeping;
+    std::mutex m_SleepMutex;
+    std::condition_variable m_Wake;
+    std::vector<std::thread> m_Threads;
+};
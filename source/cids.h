@@ -6,30 +6,7 @@
 
 #include "pluginterfaces/base/funknown.h"
 #include "pluginterfaces/vst/vsttypes.h"
-
-enum AudioParams : Steinberg::Vst::ParamID
-{
-    kParamGainId_Master = 102, // should be a unique id
-    kParamDryMixId = 103,
-    kParamWetMixId = 104,
-    
-    kParamDelayLengthId_Tap1 = 105,
-    kParamDelayGainId_Tap1 = 106,
-    kParamFeedbackId_Tap1 = 107,
-    
-    kParamDelayLengthId_Tap2 = 108,
-    kParamDelayGainId_Tap2 = 109,
-    kParamFeedbackId_Tap2 = 110,
-    
-    kParamDelayLengthId_Tap3 = 111,
-    kParamDelayGainId_Tap3 = 112,
-    kParamFeedbackId_Tap3 = 113,
-    
-    kParamDelayLengthId_Tap4 = 114,
-    kParamDelayGainId_Tap4 = 115,
-    kParamFeedbackId_Tap4 = 116,
-    
-};
+#include "parameters.hpp"
 
 namespace delayEffectProcessor {
 //------------------------------------------------------------------------
@@ -38,5 +15,13 @@ static const Steinberg::FUID kdelay2ControllerUID (0x161AA0FB, 0xAE725FD4, 0xBF4
 
 #define delay2VST3Category "Fx"
 
+// Controller to processor message with a new max delay range in seconds, applied off the audio thread
+static const char* const kMaxDelayMessageId = "MaxDelay";
+static const char* const kMaxDelaySecondsAttr = "Seconds";
+
+// Controller to processor message switching the convolution mode on or off
+static const char* const kConvolutionMessageId = "Convolution";
+static const char* const kConvolutionEnabledAttr = "Enabled";
+
 //------------------------------------------------------------------------
 } // namespace delayEffectProcessor
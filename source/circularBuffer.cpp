@@ -10,11 +10,25 @@
 #include "circularBuffer.hpp"
 #include <algorithm>
 
-CircularBuffer::CircularBuffer(int size)
+CircularBuffer::CircularBuffer(int size, Mode mode)
 {
+    m_Size = size;
+    m_Mask = 0;
+    int guard = 0;
+
+    // Round up to the next power of two so the position can wrap with a mask
+    if (mode == kPowerOfTwo)
+    {
+        m_Size = 1;
+        while (m_Size < size)
+            m_Size <<= 1;
+        m_Mask = m_Size - 1;
+        guard = kGuardSamples;
+    }
+
     // Create buffer with the specified size, initially filled with 0s
     // Set current position to 0
-    m_Buffer = std::vector<double>(size, 0);
+    m_Buffer = std::vector<double>(m_Size + guard, 0);
     currentPos = 0;
 }
 
@@ -25,6 +39,10 @@ CircularBuffer::~CircularBuffer()
 
 double CircularBuffer::performRead(int input)
 {
+    // Delays past the end are clamped to the oldest sample in both modes, the mask then only wraps
+    if (m_Mask)
+        return m_Buffer[(currentPos - std::min(input, m_Mask)) & m_Mask];
+
     input = std::min(input, static_cast<int>(m_Buffer.size() - 1));
     int index = currentPos - input;
     if (index < 0) index += m_Buffer.size();
@@ -35,10 +53,24 @@ double CircularBuffer::performInterpolation(double input)
 {
     // Read four samples and perform cubic interpolation between them
     int sampleIndex = static_cast<int>(input);
-    double v0 = performRead(sampleIndex - 1);
-    double v1 = performRead(sampleIndex);
-    double v2 = performRead(sampleIndex + 1);
-    double v3 = performRead(sampleIndex + 2);
+    double v0, v1, v2, v3;
+    if (m_Mask)
+    {
+        // One contiguous window thanks to the guard samples, oldest sample first. Clamped like
+        // performRead, so the window never reaches past the oldest sample.
+        const double* window = &m_Buffer[(currentPos - std::min(sampleIndex, m_Size - 3) - 2) & m_Mask];
+        v3 = window[0];
+        v2 = window[1];
+        v1 = window[2];
+        v0 = window[3];
+    }
+    else
+    {
+        v0 = performRead(sampleIndex - 1);
+        v1 = performRead(sampleIndex);
+        v2 = performRead(sampleIndex + 1);
+        v3 = performRead(sampleIndex + 2);
+    }
 
     // Fractional part of the input
     double fraction = input - sampleIndex;
@@ -57,5 +89,16 @@ void CircularBuffer::performWrite(double input)
 {
     // Write the input at the current position
     m_Buffer[currentPos] = input;
-    currentPos = (currentPos + 1) % m_Buffer.size();
+
+    if (m_Mask)
+    {
+        // Keep the mirrored copy of the first samples in step
+        if (currentPos < kGuardSamples)
+            m_Buffer[currentPos + m_Size] = input;
+        currentPos = (currentPos + 1) & m_Mask;
+    }
+    else
+    {
+        currentPos = (currentPos + 1) % m_Buffer.size();
+    }
 }
@@ -9,27 +9,53 @@
 #include <vector>
 #pragma once
 
+// The single channel ring of the original processor. The engine runs on
+// MultiChannelBuffer now; this class stays as the reference the benchmark
+// measures the buffer primitives on, in both modes.
 class CircularBuffer {
 public:
-    
-    CircularBuffer(int capacity);
+
+    // Storage layout of the buffer
+    enum Mode
+    {
+        kExact,      // exactly 'capacity' samples, wraps with % and compares
+        kPowerOfTwo  // capacity rounded up to a power of two, wraps with a bit mask
+                     // and mirrors kGuardSamples past the end
+    };
+
+    // Samples mirrored after the end in kPowerOfTwo mode, so a 4 point
+    // interpolation window starting anywhere in the buffer is contiguous
+    static const int kGuardSamples = 3;
+
+    CircularBuffer(int capacity, Mode mode = kExact);
     ~CircularBuffer();
 
-    // Read Operation
+    // Read Operation, 'delay' samples back. Delays past the capacity read the oldest sample.
     double performRead(int delay);
 
     // Write Operation
     void performWrite(double value);
 
-    // Interpolation Operation
+    // Interpolation Operation, clamped the same way
     double performInterpolation(double delay);
+
+    // Number of samples the buffer can hold
+    int getCapacity() const { return m_Size; }
+
+    // True when the guard samples are kept up to date
+    bool hasGuard() const { return m_Mask != 0; }
    
 private:
     
-    // Buffer for storing the samples
+    // Buffer for storing the samples (plus the guard in kPowerOfTwo mode)
     std::vector<double> m_Buffer;
 
+    // Number of samples before the guard
+    int m_Size;
+
+    // m_Size - 1 in kPowerOfTwo mode, 0 otherwise
+    int m_Mask;
+
     // Current position
     int currentPos;
 };
-
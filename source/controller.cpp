@@ -4,13 +4,53 @@
 
 #include "controller.h"
 #include "cids.h"
+#include "delayEngine.hpp"
+#include "pluginState.h"
 #include "base/source/fstreamer.h"
+#include "pluginterfaces/vst/ivstmessage.h"
 
 
 using namespace Steinberg;
 
 namespace delayEffectProcessor {
 
+namespace {
+
+//------------------------------------------------------------------------
+// List parameter with the entry names of a list descriptor, nullptr for any other
+Vst::StringListParameter* createListParameter (const ParamDescriptor& descriptor)
+{
+    const char16_t* const* names = nullptr;
+    int numNames = 0;
+    switch (descriptor.id)
+    {
+        case kParamNoteValueId:
+        {
+            auto* list = new Vst::StringListParameter (descriptor.title, descriptor.id);
+            for (const NoteValue& note : kNoteValues)
+                list->appendString (note.name);
+            return list;
+        }
+        case kParamModShapeId:
+            names = kModShapeNames;
+            numNames = kNumModShapes;
+            break;
+        case kParamInterpolationId:
+            names = kInterpolationNames;
+            numNames = kNumInterpolationModes;
+            break;
+        default:
+            return nullptr;
+    }
+
+    auto* list = new Vst::StringListParameter (descriptor.title, descriptor.id);
+    for (int i = 0; i < numNames; i++)
+        list->appendString (names[i]);
+    return list;
+}
+
+} // namespace
+
 //------------------------------------------------------------------------
 // delay2Controller Implementation
 //------------------------------------------------------------------------
@@ -26,125 +66,45 @@ tresult PLUGIN_API delay2Controller::initialize (FUnknown* context)
 	}
 
     //---Create Parameters------------
-    parameters.addParameter(STR16("Master Gain"),
-                            STR16("dB"),
-                            0,
-                            0.5,
-                            Vst::ParameterInfo::kCanAutomate,
-                            AudioParams::kParamGainId_Master,
-                            0);
-
-    parameters.addParameter(STR16("Delay Time Tap 1"),
-                            STR16("sec"),
-                            0,
-                            0.5,
-                            Vst::ParameterInfo::kCanAutomate,
-                            AudioParams::kParamDelayLengthId_Tap1,
-                            0);
-
-    parameters.addParameter(STR16("Delay Gain Tap 1"),
-                            STR16("dB"),
-                            0,
-                            0.5,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayGainId_Tap1,
-                            0);
-
-    parameters.addParameter(STR16("Feedback Gain Tap 1"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamFeedbackId_Tap1,
-                            0);
-
-    parameters.addParameter(STR16("Delay Time Tap 2"),
-                            STR16("sec"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayLengthId_Tap2,
-                            0);
-
-    parameters.addParameter(STR16("Delay Gain Tap 2"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayGainId_Tap2,
-                            0);
-
-    parameters.addParameter(STR16("Feedback Gain Tap 2"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamFeedbackId_Tap2,
-                            0);
-
-    parameters.addParameter(STR16("Delay Time Tap 3"),
-                            STR16("sec"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayLengthId_Tap3,
-                            0);
-
-    parameters.addParameter(STR16("Delay Gain Tap 3"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayGainId_Tap3,
-                            0);
-
-    parameters.addParameter(STR16("Feedback Gain Tap 3"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamFeedbackId_Tap3,
-                            0);
-
-    parameters.addParameter(STR16("Delay Time Tap 4"),
-                            STR16("sec"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayLengthId_Tap4,
-                            0);
-
-    parameters.addParameter(STR16("Delay Gain Tap 4"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamDelayGainId_Tap4,
-                            0);
-
-    parameters.addParameter(STR16("Feedback Gain Tap 4"),
-                            STR16("dB"),
-                            0,
-                            0.0,
-                            Vst::ParameterInfo::kCanAutomate,
-                            kParamFeedbackId_Tap4,
-                            0);
-
-    parameters.addParameter(STR16("Dry Mix"),
-                            STR16("%"),
-                            0,
-                            0.5,
-                            Vst::ParameterInfo::kCanAutomate,
-                            AudioParams::kParamDryMixId,
-                            0);
-
-    parameters.addParameter(STR16("Wet Mix"),
-                            STR16("%"),
-                            0,
-                            0.5,
-                            Vst::ParameterInfo::kCanAutomate,
-                            AudioParams::kParamWetMixId,
-                            0);
+    // One entry of the shared table per parameter, the processor reads the same defaults
+    for (const ParamDescriptor& descriptor : kParamDescriptors)
+    {
+        // The note value, the LFO shape and the interpolation are lists, so the host shows their names
+        if (auto* list = createListParameter (descriptor))
+        {
+            list->getInfo ().defaultNormalizedValue = descriptor.defaultValue;
+            list->setNormalized (descriptor.defaultValue);
+            parameters.addParameter (list);
+            continue;
+        }
+
+        // The tap count shows as a number of taps rather than a fraction
+        if (descriptor.id == kParamNumTapsId)
+        {
+            parameters.addParameter (new Vst::RangeParameter (descriptor.title, descriptor.id, descriptor.units,
+                                                              1, DelayEngine::kMaxTaps, DelayEngine::kNumParamTaps,
+                                                              DelayEngine::kMaxTaps - 1,
+                                                              Vst::ParameterInfo::kCanAutomate));
+            continue;
+        }
+
+        parameters.addParameter(descriptor.title,
+                                descriptor.units,
+                                descriptor.stepCount,
+                                descriptor.defaultValue,
+                                Vst::ParameterInfo::kCanAutomate,
+                                descriptor.id,
+                                0);
+    }
+
+    // The max delay range in seconds. It sizes the delay memory, so it is not automatable,
+    // and setParamNormalized passes a change on to the processor as a message.
+    parameters.addParameter (new Vst::RangeParameter (u"Max Delay", kParamMaxDelayId, u"sec",
+                                                      DelayEngine::kMinMaxDelay, DelayEngine::kMaxMaxDelay,
+                                                      DelayEngine::kDefaultMaxDelay, 0, Vst::ParameterInfo::kNoFlags));
+
+    // The convolution mode allocates on activation, so it is a switch the host cannot automate
+    parameters.addParameter (u"Convolution", nullptr, 1, 0.0, Vst::ParameterInfo::kNoFlags, kParamConvolutionId, 0);
 	return result;
 }
 
@@ -164,32 +124,20 @@ tresult PLUGIN_API delay2Controller::setComponentState (IBStream* state)
     if (!state)
         return kResultFalse;
 
-//    IBStreamer streamer (state, kLittleEndian);
-//    float   savedParam1 = 0.0f,
-//            savedParam2 = 0.0f,
-//            savedParam3 = 0.0f,
-//            savedParam4 = 0.0f,
-//            savedParam5 = 0.0f;
-//
-//    if (   streamer.readFloat (savedParam1) == false
-//        || streamer.readFloat (savedParam2) == false
-//        || streamer.readFloat (savedParam3) == false
-//        || streamer.readFloat (savedParam4) == false
-//        || streamer.readFloat (savedParam5) == false
-//        )
-//        return kResultFalse;
-//
-//    // sync with our parameter
-//    if (auto param = parameters.getParameter (AudioParams::kParamGainId))
-//        param->setNormalized (savedParam1);
-//    if (auto param = parameters.getParameter (AudioParams::kParamDelayLengthId))
-//        param->setNormalized (savedParam2);
-//    if (auto param = parameters.getParameter (AudioParams::kParamDryMixId))
-//        param->setNormalized (savedParam3);
-//    if (auto param = parameters.getParameter (AudioParams::kParamWetMixId))
-//        param->setNormalized (savedParam4);
-//    if (auto param = parameters.getParameter (AudioParams::kParamFeedbackId))
-//        param->setNormalized (savedParam5);
+    // The processor's PluginState, of which the controller only shows the parameters
+    IBStreamer streamer (state, kLittleEndian);
+    PluginState saved;
+    if (saved.read (streamer) == false)
+        return kResultFalse;
+
+    // sync with our parameter
+    for (int i = 0; i < kNumParams; i++)
+        setParamNormalized (kParamDescriptors[i].id, saved.values[i]);
+
+    // The processor already has this range, so it is not sent back
+    if (Vst::Parameter* maxDelay = getParameterObject (kParamMaxDelayId))
+        EditControllerEx1::setParamNormalized (kParamMaxDelayId, maxDelay->toNormalized (saved.maxDelaySeconds));
+    EditControllerEx1::setParamNormalized (kParamConvolutionId, saved.convolutionEnabled ? 1.0 : 0.0);
 
     return kResultOk;
 }
@@ -228,6 +176,30 @@ tresult PLUGIN_API delay2Controller::setParamNormalized (Vst::ParamID tag, Vst::
 {
 	// called by host to update your parameters
 	tresult result = EditControllerEx1::setParamNormalized (tag, value);
+
+    // A larger range allocates, so the processor takes it on the message thread rather than in process
+    if (result == kResultOk && tag == kParamMaxDelayId)
+    {
+        if (IPtr<Vst::IMessage> message = owned (allocateMessage ()))
+        {
+            message->setMessageID (kMaxDelayMessageId);
+            message->getAttributes ()->setFloat (kMaxDelaySecondsAttr, getParameterObject (tag)->toPlain (value));
+            sendMessage (message);
+        }
+    }
+
+    // The processor sizes the convolution memory on activation, so the host is asked to restart it
+    if (result == kResultOk && tag == kParamConvolutionId)
+    {
+        if (IPtr<Vst::IMessage> message = owned (allocateMessage ()))
+        {
+            message->setMessageID (kConvolutionMessageId);
+            message->getAttributes ()->setInt (kConvolutionEnabledAttr, value > 0.5 ? 1 : 0);
+            sendMessage (message);
+        }
+        if (componentHandler)
+            componentHandler->restartComponent (Vst::kLatencyChanged);
+    }
 	return result;
 }
 
@@ -0,0 +1,1317 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Block based multi-tap engine used by delay2Processor::process.
+//------------------------------------------------------------------------
+
+#include "delayEngine.hpp"
+#include <algorithm>
+
+namespace {
+
+// Calculate the coefficient 'g' for the allpass filter from the normalised Allpass parameter.
+// The parameter is the coefficient itself, kept below 1 so the filter stays stable and rings out.
+double getAllpassCoefficient(double value)
+{
+    return std::min(std::max(value, 0.0), DelayEngine::kMaxAllpassCoefficient);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+DelayEngine::DelayEngine()
+{
+    // Start from the default of every parameter, cooked on the first block
+    for (int i = 0; i < kNumParams; i++)
+    {
+        m_Params[i] = kParamDescriptors[i].defaultValue;
+        m_Smoothers[i].reset(m_Params[i]);
+    }
+    m_DirtyMask = kDirtyAllTaps | kDirtyMix | kDirtyModulation | kDirtyAllpass;
+    m_HostSampleRate = 44100.0;
+    m_SampleRate = m_HostSampleRate;
+    m_MaxDelay = kDefaultMaxDelay;
+    m_Tempo = kDefaultTempo;
+    m_TimeSigNumerator = 4;
+    m_TimeSigDenominator = 4;
+    m_CookedCapacity = 0;
+
+    m_SmoothingTime = kDefaultSmoothingTime;
+    m_ControlInterval = kDefaultControlInterval;
+    updateSmoothingSteps();
+    m_ControlCountdown = 0;
+    m_Ramping = false;
+
+    // Cooked with the first tap table
+    m_NumTaps = getNumTaps();
+    for (int t = 0; t < kMaxTaps; t++)
+        m_CookedTaps[t] = { 1.0, 0.0, 0.0 };
+    m_NumTapGroups = 0;
+    m_Taps.modDepth = 0.0;
+    m_Taps.mode = InterpolationMode::kCubic;
+    m_Taps.numPoints = getInterpolationPoints(m_Taps.mode);
+    m_FadeTaps.modDepth = 0.0;
+    m_FadeTaps.mode = m_Taps.mode;
+    m_FadeTaps.numPoints = m_Taps.numPoints;
+    m_FadeTapGroups = 0;
+    m_FadeSafeRunLength = kMaxSubBlock;
+    m_PresetFade = 0.0;
+    m_PresetFadeStep = 0.0;
+    m_LfoCountdown = 0;
+    m_DryMix = 1.0;
+    m_WetMix = 0.0;
+    m_GainLimiter = 1.0;
+    m_GainMaster = 1.0;
+    m_WetMixStep = 0.0;
+    m_GainMasterStep = 0.0;
+    m_SafeRunLength = 1;
+    m_LongestReach = 0;
+
+    // Fresh delay memory is all zeros, but count it as quiet only once it has been played out
+    for (int c = 0; c < MultiChannelBuffer::kMaxChannels; c++)
+        m_QuietSamples[c] = 0;
+    m_SkippedSamples = 0;
+
+    m_ConvolutionEnabled = false;
+    m_ConvolutionReady = false;
+    m_ImpulseState = kImpulseNone;
+    m_ImpulseLength = 0;
+    m_ImpulseRendered = 0;
+    m_StaticSamples = 0;
+    m_ConvolutionMix = 0.0;
+    m_ConvolutionMixStep = 0.0;
+
+    // Set an initial value for the allpass filter coefficient, the first tap table replaces it
+    m_AllpassCoefficient = 0.5;
+    std::fill(m_AllpassInput, m_AllpassInput + MultiChannelBuffer::kMaxChannels, 0.0);
+    std::fill(m_AllpassOutput, m_AllpassOutput + MultiChannelBuffer::kMaxChannels, 0.0);
+
+    // Full rate, the filters pass straight through
+    m_RateReduction = 1;
+    m_ResamplerLatency = 0;
+    resetResampler();
+
+    setSimdLevel(detectSimdLevel());
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setSampleRate(double sampleRate)
+{
+    m_HostSampleRate = sampleRate;
+    m_SampleRate = sampleRate / m_RateReduction;
+    m_DirtyMask |= kDirtyAllTaps | kDirtyModulation;
+    updateSmoothingSteps();
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setRateReduction(int factor)
+{
+    m_Decimator.setFactor(factor);
+    m_Interpolator.setFactor(factor);
+    m_RateReduction = m_Decimator.getFactor();
+    m_ResamplerLatency = (m_Decimator.getLatency() + m_RateReduction - 1) / m_RateReduction;
+    setSampleRate(m_HostSampleRate);
+    resetResampler();
+
+    // The reduced path has no convolution, whatever was loaded is dropped
+    m_ImpulseState = kImpulseNone;
+    m_StaticSamples = 0;
+    m_ConvolutionMix = 0.0;
+    m_ConvolutionMixStep = 0.0;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::resetResampler()
+{
+    m_Decimator.reset();
+    m_Interpolator.reset();
+
+    // The mix stage reads the wet sums factor - 1 frames behind the decimator, which makes every
+    // chunk come out even however its length divides by the factor, plus whatever rounds the
+    // filters' latency up to whole reduced samples
+    m_ReducedWetFrames = m_RateReduction - 1 + m_ResamplerLatency * m_RateReduction - m_Decimator.getLatency();
+    std::fill(m_ReducedWet, m_ReducedWet + m_ReducedWetFrames * MultiChannelBuffer::kMaxChannels, 0.0);
+    std::fill(m_DelayedFeedback, m_DelayedFeedback + m_ResamplerLatency * MultiChannelBuffer::kMaxChannels, 0.0);
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setMaxDelay(double seconds)
+{
+    if (!std::isfinite(seconds))
+        return;
+    seconds = std::min(std::max(seconds, kMinMaxDelay), kMaxMaxDelay);
+    if (seconds == m_MaxDelay)
+        return;
+    m_MaxDelay = seconds;
+    m_DirtyMask |= kDirtyAllTaps;
+
+    // A synced time is a fixed number of seconds, so it is a different fraction of the new range
+    updateSyncedTime();
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setTempo(double beatsPerMinute, int timeSigNumerator, int timeSigDenominator)
+{
+    if (beatsPerMinute <= 0.0 || timeSigNumerator <= 0 || timeSigDenominator <= 0)
+        return;
+    if (beatsPerMinute == m_Tempo && timeSigNumerator == m_TimeSigNumerator && timeSigDenominator == m_TimeSigDenominator)
+        return;
+    m_Tempo = beatsPerMinute;
+    m_TimeSigNumerator = timeSigNumerator;
+    m_TimeSigDenominator = timeSigDenominator;
+    updateSyncedTime();
+}
+
+//------------------------------------------------------------------------
+double DelayEngine::getTargetValue(int index) const
+{
+    // Only the tap 1 time is ever replaced, and only while synced
+    const int firstTapIndex = getParamIndex(kParamDelayLengthId_Tap1);
+    if (index != firstTapIndex || m_Params[getParamIndex(kParamTempoSyncId)] < 0.5)
+        return m_Params[index];
+
+    // The tempo counts quarter notes, a bar is as long as the time signature says
+    const NoteValue& note = kNoteValues[getNoteValueIndex(m_Params[getParamIndex(kParamNoteValueId)])];
+    const double wholeNotes = note.wholeNotes > 0.0 ? note.wholeNotes
+                                                    : static_cast<double>(m_TimeSigNumerator) / m_TimeSigDenominator;
+    const double seconds = wholeNotes * 4.0 * 60.0 / m_Tempo;
+    return std::min(seconds / m_MaxDelay, 1.0);
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::updateSyncedTime()
+{
+    // Glides like a change of the tap 1 time, so a tempo ramp moves the taps smoothly
+    const int firstTapIndex = getParamIndex(kParamDelayLengthId_Tap1);
+    const double target = getTargetValue(firstTapIndex);
+    if (target != m_Smoothers[firstTapIndex].getTarget())
+        glideTo(firstTapIndex, target);
+}
+
+//------------------------------------------------------------------------
+int DelayEngine::getRequiredCapacity(double maxDelaySeconds, double sampleRate)
+{
+    // Within the range setMaxDelay accepts, which also keeps a NaN out of the conversion below
+    if (!(maxDelaySeconds >= kMinMaxDelay))
+        maxDelaySeconds = kMinMaxDelay;
+    maxDelaySeconds = std::min(maxDelaySeconds, kMaxMaxDelay);
+
+    // The tap table keeps every delay half the widest interpolation window short of the capacity
+    return static_cast<int>(std::ceil(maxDelaySeconds * sampleRate)) + kMaxInterpolationPoints / 2 + 2;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setNumTaps(int numTaps)
+{
+    numTaps = std::min(std::max(numTaps, 1), kMaxTaps);
+    setParameter(getParamIndex(kParamNumTapsId), static_cast<double>(numTaps - 1) / (kMaxTaps - 1));
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setTap(int tap, double delay, double gain, double feedback)
+{
+    if (tap < 0 || tap >= kMaxTaps)
+        return;
+
+    // Tap 1's delay is its own time rather than a fraction of it
+    const int firstIndex = getTapParamIndex(tap);
+    if (tap > 0)
+        setParameter(firstIndex, delay);
+    setParameter(firstIndex + 1, gain);
+    setParameter(firstIndex + 2, feedback);
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setConvolution(bool enabled, int numChannels)
+{
+    m_ConvolutionEnabled = enabled && numChannels > 0;
+    if (m_ConvolutionEnabled)
+    {
+        m_Convolver.setSize(kMaxImpulseLength, numChannels);
+        m_ImpulseBuffer.setSize(kMaxImpulseLength + kMaxSubBlock, 1);
+        m_ImpulseWet.assign(kMaxImpulseLength, 0.0);
+        m_ImpulseFeedback.assign(kMaxImpulseLength, 0.0);
+    }
+    else
+    {
+        m_Convolver.setSize(0, 0);
+        m_ImpulseBuffer.setSize(0, 0);
+        std::vector<double>().swap(m_ImpulseWet);
+        std::vector<double>().swap(m_ImpulseFeedback);
+    }
+
+    m_ImpulseState = kImpulseNone;
+    m_StaticSamples = 0;
+    m_ConvolutionMix = 0.0;
+    m_ConvolutionMixStep = 0.0;
+}
+
+//------------------------------------------------------------------------
+std::size_t DelayEngine::getFootprint() const
+{
+    return m_Convolver.getFootprint() + m_ImpulseBuffer.getFootprint()
+         + (m_ImpulseWet.capacity() + m_ImpulseFeedback.capacity()) * sizeof(double);
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setSmoothing(double timeSeconds, int controlInterval)
+{
+    m_SmoothingTime = std::max(timeSeconds, 0.0);
+    m_ControlInterval = std::max(controlInterval, 1);
+    updateSmoothingSteps();
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::updateSmoothingSteps()
+{
+    // Rounded to whole control steps, but any glide time above zero takes at least one
+    const double steps = m_SmoothingTime * m_SampleRate / m_ControlInterval;
+    m_SmoothingSteps = m_SmoothingTime > 0.0 ? std::max(1, static_cast<int>(steps + 0.5)) : 0;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::snapParameters()
+{
+    for (int i = 0; i < kNumParams; i++)
+        m_Smoothers[i].reset(getTargetValue(i));
+    m_DirtyMask |= kDirtyAllTaps | kDirtyMix | kDirtyModulation | kDirtyAllpass;
+    m_Ramping = false;
+    m_WetMixStep = 0.0;
+    m_GainMasterStep = 0.0;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::reset()
+{
+    std::fill(m_AllpassInput, m_AllpassInput + MultiChannelBuffer::kMaxChannels, 0.0);
+    std::fill(m_AllpassOutput, m_AllpassOutput + MultiChannelBuffer::kMaxChannels, 0.0);
+
+    // The convolution starts over with an empty input history
+    m_Convolver.reset();
+    invalidateConvolution();
+    m_ConvolutionMix = 0.0;
+    m_ConvolutionMixStep = 0.0;
+
+    // With the delay memory cleared there is nothing left to fade out
+    m_PresetFade = 0.0;
+
+    // The LFOs restart too, so a render comes out the same every time
+    m_Lfo.reset();
+    m_LfoCountdown = 0;
+    resetResampler();
+
+    for (int c = 0; c < MultiChannelBuffer::kMaxChannels; c++)
+        m_QuietSamples[c] = kMaxQuietSamples;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::setParameter(int index, double value)
+{
+    m_Params[index] = value;
+    glideTo(index, getTargetValue(index));
+
+    // The sync switch and note value move the tap 1 time
+    if (index == getParamIndex(kParamTempoSyncId) || index == getParamIndex(kParamNoteValueId))
+        updateSyncedTime();
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::glideTo(int index, double target)
+{
+    // Lists and switches have nothing in between their entries, so they change at once
+    const int numSteps = kParamDescriptors[index].stepCount > 0 ? 0 : m_SmoothingSteps;
+    m_Smoothers[index].setTarget(target, numSteps);
+
+    if (m_Smoothers[index].isSettled())
+    {
+        // Smoothing is off, the new value is cooked straight away
+        m_DirtyMask |= kParamDescriptors[index].dirtyMask;
+    }
+    else
+    {
+        // Start a new control step on the next sample, so the glide begins right here
+        m_Ramping = true;
+        m_ControlCountdown = 0;
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::crossfadeTo(const double* values)
+{
+    // The table playing now fades out, unless an earlier preset is still fading out,
+    // in which case that one keeps going and only the incoming taps change.
+    // Before the first block there is nothing playing to fade from.
+    if (m_PresetFade == 0.0 && m_CookedCapacity != 0)
+    {
+        m_FadeTaps = m_Taps;
+        m_FadeTapGroups = m_NumTapGroups;
+        m_FadeSafeRunLength = m_SafeRunLength;
+        m_PresetFade = 1.0;
+    }
+    m_PresetFadeStep = 1.0 / std::max(1.0, kPresetFadeTime * m_SampleRate);
+
+    // Everything but the taps glides. The sync settings go first, so the tap 1 time they lead to
+    // is known when the taps land on their values straight away.
+    for (int i = 0; i < kNumParams; i++)
+    {
+        if (!(kParamDescriptors[i].dirtyMask & kDirtyAllTaps) && values[i] != m_Params[i])
+            setParameter(i, values[i]);
+    }
+    for (int i = 0; i < kNumParams; i++)
+    {
+        if (kParamDescriptors[i].dirtyMask & kDirtyAllTaps)
+        {
+            m_Params[i] = values[i];
+            m_Smoothers[i].reset(getTargetValue(i));
+            m_DirtyMask |= kParamDescriptors[i].dirtyMask;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::advanceSmoothers()
+{
+    // A mix change still waiting to be cooked is where the ramp starts from
+    if (m_DirtyMask & kDirtyMix)
+    {
+        m_WetMix = m_Smoothers[getParamIndex(kParamWetMixId)].getCurrent();
+        m_GainMaster = m_Smoothers[getParamIndex(kParamGainId_Master)].getCurrent();
+        m_DirtyMask &= ~kDirtyMix;
+    }
+
+    bool moved = false;
+    for (int i = 0; i < kNumParams; i++)
+    {
+        if (m_Smoothers[i].isSettled())
+            continue;
+
+        // Taps, the LFO and the allpass are re-cooked once per control step, the mix is ramped below instead
+        m_Smoothers[i].next();
+        m_DirtyMask |= kParamDescriptors[i].dirtyMask & (kDirtyAllTaps | kDirtyModulation | kDirtyAllpass);
+        moved = true;
+    }
+
+    if (moved)
+    {
+        // Ramp the mix and master gain per sample to where the smoothers are now
+        const double wetMix = m_Smoothers[getParamIndex(kParamWetMixId)].getCurrent();
+        const double gainMaster = m_Smoothers[getParamIndex(kParamGainId_Master)].getCurrent();
+        m_WetMixStep = (wetMix - m_WetMix) / m_ControlInterval;
+        m_GainMasterStep = (gainMaster - m_GainMaster) / m_ControlInterval;
+        m_ControlCountdown = m_ControlInterval;
+    }
+    else
+    {
+        // Every glide has finished: land exactly on the targets and go back to constant coefficients
+        m_WetMixStep = 0.0;
+        m_GainMasterStep = 0.0;
+        m_DirtyMask |= kDirtyMix;
+    }
+    m_Ramping = moved;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::updateTapTable(int bufferCapacity)
+{
+    // A different buffer changes the clamp on every tap
+    if (bufferCapacity != m_CookedCapacity)
+    {
+        m_CookedCapacity = bufferCapacity;
+        m_DirtyMask |= kDirtyAllTaps;
+
+        // A preset fading out may not fit the new buffer, and the echoes it played are gone anyway
+        m_PresetFade = 0.0;
+    }
+
+    // The gain limiter scales the feedback, so it is part of a frozen tap setup too
+    const double previousLimiter = m_GainLimiter;
+
+    if (m_DirtyMask & kDirtyMix)
+    {
+        // Determine the mix of original (dry) and effect (wet)
+        m_WetMix = m_Smoothers[getParamIndex(kParamWetMixId)].getCurrent();
+        m_DryMix = 1.0 - m_WetMix;
+        m_GainLimiter = 1.0 - m_WetMix * 0.5;
+        m_GainMaster = m_Smoothers[getParamIndex(kParamGainId_Master)].getCurrent();
+    }
+
+    if (m_DirtyMask & kDirtyModulation)
+    {
+        // The LFO picks these up at its next interval. The shape is a list, so it is never glided.
+        const double rate = m_Smoothers[getParamIndex(kParamModRateId)].getCurrent();
+        m_Lfo.setRate(kMinModRate * std::pow(kMaxModRate / kMinModRate, rate) / m_SampleRate);
+        const int shape = getListIndex(m_Params[getParamIndex(kParamModShapeId)], kNumModShapes);
+        m_Lfo.setShape(static_cast<WavetableLfo::Shape>(shape));
+    }
+
+    if (m_DirtyMask & kDirtyAllpass)
+        calculateAllpassCoefficient(m_Smoothers[getParamIndex(kParamAllpassId)].getCurrent());
+
+    if (m_DirtyMask & kDirtyAllTaps)
+    {
+        // Determine the minimum delay based on the buffer sample rate
+        const double bufferDelay = 1.0 / m_SampleRate;
+
+        // We limit the total feedback gain to avoid overflows
+        const double maxFeedbackGain = 0.8;
+
+        // Later taps are set as multiples of the tap 1 time
+        const int firstTapIndex = getParamIndex(kParamDelayLengthId_Tap1);
+        const double firstDelay = m_Smoothers[firstTapIndex].getCurrent() * m_MaxDelay;
+
+        // How far the taps swing either way, at most a quarter of the buffer
+        const double depth = m_Smoothers[getParamIndex(kParamModDepthId)].getCurrent() * kMaxModDepth * m_SampleRate;
+        m_Taps.modDepth = std::min(depth, (bufferCapacity - 4) * 0.25);
+
+        // The mode is a list, so it is never glided. Its window reaches (numPoints - 1) / 2 samples
+        // closer than the delay and numPoints / 2 further back.
+        m_Taps.mode = static_cast<InterpolationMode>(getListIndex(m_Params[getParamIndex(kParamInterpolationId)],
+                                                                  kNumInterpolationModes));
+        m_Taps.numPoints = getInterpolationPoints(m_Taps.mode);
+        const double minDelay = std::max(1, (m_Taps.numPoints - 1) / 2) + m_Taps.modDepth;
+        const double maxDelay = bufferCapacity - m_Taps.numPoints / 2 - 1 - m_Taps.modDepth;
+
+        // The count is a list, so it is never glided
+        m_NumTaps = getNumTaps();
+        for (int t = 0; t < m_NumTaps; t++)
+        {
+            if (t < kNumParamTaps ? !(m_DirtyMask & (kDirtyTap1 << t)) : !(m_DirtyMask & kDirtyExtraTaps))
+                continue;
+
+            const ParameterSmoother* tapParams = &m_Smoothers[getTapParamIndex(t)];
+            const double delay = tapParams[0].getCurrent();
+            const double gain = tapParams[1].getCurrent();
+            const double feedback = tapParams[2].getCurrent();
+            double delayTime = t == 0 ? firstDelay : delay * firstDelay;
+
+            // Delay in samples, less what the resampling filters add to the wet output at a reduced
+            // rate, kept far enough from both ends that the interpolation window stays inside the
+            // buffer wherever the modulation takes it
+            double delaySamples = m_SampleRate * std::max(delayTime, bufferDelay) - m_ResamplerLatency;
+            delaySamples = std::min(std::max(delaySamples, minDelay), maxDelay);
+
+            m_CookedTaps[t] = { delaySamples, gain, std::min(feedback, maxFeedbackGain) };
+        }
+
+        sortTapTable();
+    }
+
+    if ((m_DirtyMask & kDirtyAllTaps) || m_GainLimiter != previousLimiter)
+        invalidateConvolution();
+
+    m_DirtyMask = 0;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::sortTapTable()
+{
+    // Insertion sort of the active taps by delay, there are at most a few dozen
+    int numActive = 0;
+    int order[kMaxTaps];
+    for (int t = 0; t < m_NumTaps; t++)
+    {
+        // A tap that reaches neither the output nor the feedback is left out
+        const CookedTap& tap = m_CookedTaps[t];
+        if (tap.gain == 0.0 && tap.feedback == 0.0)
+            continue;
+
+        int i = numActive++;
+        for (; i > 0 && m_CookedTaps[order[i - 1]].delaySamples > tap.delaySamples; i--)
+            order[i] = order[i - 1];
+        order[i] = t;
+    }
+
+    // Without interpolation the delays are rounded to the nearest sample, which the truncation
+    // to sampleIndex, here and in the modulated kernels, does with half a sample added
+    const double rounding = m_Taps.mode == InterpolationMode::kNone ? 0.5 : 0.0;
+    for (int i = 0; i < numActive; i++)
+    {
+        const CookedTap& tap = m_CookedTaps[order[i]];
+        const double delaySamples = tap.delaySamples + rounding;
+        int sampleIndex = static_cast<int>(delaySamples);
+        m_Taps.sampleIndex[i] = sampleIndex;
+        m_Taps.fraction[i] = delaySamples - sampleIndex;
+        m_Taps.gain[i] = tap.gain;
+        m_Taps.feedback[i] = tap.feedback;
+        m_Taps.phase[i] = static_cast<double>(order[i]) / m_NumTaps;
+    }
+
+    // Fill the last group with silent copies of the longest tap, which read memory
+    // the group touches anyway and change neither sum
+    m_NumTapGroups = (numActive + kTapsPerKernel - 1) / kTapsPerKernel;
+    for (int i = numActive; i < m_NumTapGroups * kTapsPerKernel; i++)
+    {
+        m_Taps.sampleIndex[i] = m_Taps.sampleIndex[numActive - 1];
+        m_Taps.fraction[i] = m_Taps.fraction[numActive - 1];
+        m_Taps.gain[i] = 0.0;
+        m_Taps.feedback[i] = 0.0;
+        m_Taps.phase[i] = m_Taps.phase[numActive - 1];
+    }
+
+    // The FIR kernels weigh the windows with the coefficients of each tap's fraction
+    if (m_Taps.mode != InterpolationMode::kCubic)
+    {
+        const CoefficientFunction coefficientsAt = getCoefficientFunction(m_Taps.mode);
+        for (int i = 0; i < m_NumTapGroups * kTapsPerKernel; i++)
+            coefficientsAt(m_Taps.fraction[i], m_Taps.coefficients + i * kMaxInterpolationPoints);
+    }
+
+    // The newest sample a tap reads is (sampleIndex - (numPoints - 1) / 2) behind the write
+    // position, so a run of that length never depends on its own output. The window of the
+    // longest tap reaches back to sampleIndex + numPoints / 2. Modulated taps come and go
+    // by the depth, plus a sample for the rounding of the ramps.
+    const int swing = m_Taps.modDepth > 0.0 ? static_cast<int>(std::ceil(m_Taps.modDepth)) + 1 : 0;
+    m_SafeRunLength = kMaxSubBlock;
+    m_LongestReach = 0;
+    if (numActive > 0)
+    {
+        const int newest = m_Taps.sampleIndex[0] - (m_Taps.numPoints - 1) / 2 - swing;
+        m_SafeRunLength = std::min(m_SafeRunLength, std::max(1, newest));
+        m_LongestReach = m_Taps.sampleIndex[numActive - 1] + m_Taps.numPoints / 2 + 1 + swing;
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::computeTapSums(const MultiChannelBuffer& buffer, const TapTable& taps, int numTapGroups, int runLength,
+                                 double* feedbackSum, double* wetSum)
+{
+    if (taps.modDepth > 0.0 && numTapGroups > 0)
+    {
+        computeModulatedTapSums(buffer, taps, numTapGroups, runLength, feedbackSum, wetSum);
+        return;
+    }
+
+    // All taps of all channels, split wherever one of the taps wraps around the end of the buffer
+    const int numChannels = buffer.getNumChannels();
+    const int numTaps = numTapGroups * kTapsPerKernel;
+    MultiChannelBuffer::ReadSpan spans[kMaxTaps][2];
+    int splits[kMaxTaps + 1];
+    int numSplits = 0;
+    for (int t = 0; t < numTaps; t++)
+    {
+        if (buffer.getReadSpans(taps.sampleIndex[t] + taps.numPoints / 2, runLength, spans[t]) > 1)
+        {
+            // Keep the split points sorted as they come in
+            int i = numSplits++;
+            for (; i > 0 && splits[i - 1] > spans[t][0].length; i--)
+                splits[i] = splits[i - 1];
+            splits[i] = spans[t][0].length;
+        }
+    }
+    splits[numSplits++] = runLength;
+
+    // Without active taps nothing comes back from the delay memory
+    if (numTaps == 0)
+    {
+        std::fill(feedbackSum, feedbackSum + runLength * numChannels, 0.0);
+        std::fill(wetSum, wetSum + runLength * numChannels, 0.0);
+        numSplits = 0;
+    }
+
+    int start = 0;
+    for (int s = 0; s < numSplits; s++)
+    {
+        if (splits[s] == start)
+            continue;
+
+        const int offset = start * numChannels;
+        for (int g = 0; g < numTapGroups; g++)
+        {
+            const int first = g * kTapsPerKernel;
+            const double* windows[kTapsPerKernel];
+            for (int t = 0; t < kTapsPerKernel; t++)
+            {
+                const MultiChannelBuffer::ReadSpan* tapSpans = spans[first + t];
+                const int firstLength = tapSpans[0].length;
+                windows[t] = start < firstLength ? tapSpans[0].data + start * numChannels
+                                                 : tapSpans[1].data + (start - firstLength) * numChannels;
+            }
+
+            // A mono buffer is a plain ring, which the tap kernel vectorises better.
+            // Every group after the first adds to the sums.
+            if (taps.mode != InterpolationMode::kCubic)
+                m_FirKernel(windows, numChannels, taps.numPoints, taps.coefficients + first * kMaxInterpolationPoints,
+                            taps.feedback + first, taps.gain + first, splits[s] - start, feedbackSum + offset,
+                            wetSum + offset, g > 0);
+            else if (numChannels == 1)
+                m_TapKernel(windows, taps.fraction + first, taps.feedback + first, taps.gain + first,
+                            splits[s] - start, feedbackSum + offset, wetSum + offset, g > 0);
+            else
+                m_FrameKernel(windows, numChannels, taps.fraction + first, taps.feedback + first,
+                              taps.gain + first, splits[s] - start, feedbackSum + offset, wetSum + offset, g > 0);
+        }
+        start = splits[s];
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::computeModulatedTapSums(const MultiChannelBuffer& buffer, const TapTable& taps, int numTapGroups,
+                                          int runLength, double* feedbackSum, double* wetSum)
+{
+    // Every tap ramps from its LFO value at the start of the interval to the one at the end,
+    // the run starting however far into the interval the previous runs got
+    const int interval = m_Lfo.getIntervalLength();
+    const double position = interval - m_LfoCountdown;
+    for (int g = 0; g < numTapGroups; g++)
+    {
+        const int first = g * kTapsPerKernel;
+        alignas(32) double delay[kTapsPerKernel];
+        alignas(32) double delayStep[kTapsPerKernel];
+        for (int t = 0; t < kTapsPerKernel; t++)
+        {
+            const double phase = taps.phase[first + t];
+            const double start = m_Lfo.getStartValue(phase);
+            const double slope = (m_Lfo.getEndValue(phase) - start) / interval;
+            delay[t] = taps.sampleIndex[first + t] + taps.fraction[first + t] + taps.modDepth * (start + position * slope);
+            delayStep[t] = taps.modDepth * slope;
+        }
+
+        // The kernel works out the windows itself, so wrapping around the end needs no splitting
+        if (taps.mode != InterpolationMode::kCubic)
+            m_ModulatedFirKernel(buffer.getFrames(), buffer.getNumChannels(), buffer.getCapacity() - 1,
+                                 buffer.getWritePosition(), taps.numPoints, getCoefficientFunction(taps.mode), delay,
+                                 delayStep, taps.feedback + first, taps.gain + first, runLength, feedbackSum, wetSum, g > 0);
+        else
+            m_ModulatedKernel(buffer.getFrames(), buffer.getNumChannels(), buffer.getCapacity() - 1, buffer.getWritePosition(),
+                              delay, delayStep, taps.feedback + first, taps.gain + first, runLength, feedbackSum, wetSum, g > 0);
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::mixPresetFade(const MultiChannelBuffer& buffer, int runLength)
+{
+    // Both sums move from the old taps to the new ones, so the delay memory is crossfaded too
+    const int numChannels = buffer.getNumChannels();
+    computeTapSums(buffer, m_FadeTaps, m_FadeTapGroups, runLength, m_FadeFeedbackSum, m_FadeWetSum);
+    for (int n = 0; n < runLength; n++)
+    {
+        const double fade = std::max(m_PresetFade - (n + 1) * m_PresetFadeStep, 0.0);
+        for (int c = 0; c < numChannels; c++)
+        {
+            const int i = n * numChannels + c;
+            m_FeedbackSum[i] += fade * (m_FadeFeedbackSum[i] - m_FeedbackSum[i]);
+            m_WetSum[i] += fade * (m_FadeWetSum[i] - m_WetSum[i]);
+        }
+    }
+    m_PresetFade = std::max(m_PresetFade - runLength * m_PresetFadeStep, 0.0);
+}
+
+//------------------------------------------------------------------------
+int DelayEngine::getImpulseLength() const
+{
+    // The convolver skips the first block of a response, so no tap may read closer than that.
+    // Modulated taps have no fixed response at all.
+    if (m_NumTapGroups == 0 || m_Taps.modDepth > 0.0 || m_SafeRunLength < PartitionedConvolver::kBlockSize)
+        return 0;
+
+    double loopGain = 0.0;
+    for (int t = 0; t < m_NumTapGroups * kTapsPerKernel; t++)
+        loopGain += m_Taps.feedback[t];
+    loopGain *= m_GainLimiter;
+    if (loopGain >= 1.0)
+        return 0;
+
+    // Same estimate as getTailSamples, on the cooked taps
+    int64_t repeats = 0;
+    if (loopGain > 0.0)
+        repeats = static_cast<int64_t>(std::ceil(std::log(kSilenceThreshold) / std::log(loopGain)));
+    const int64_t length = static_cast<int64_t>(m_LongestReach) * (repeats + 1);
+    if (length > std::min<int64_t>(kMaxImpulseLength, m_Convolver.getMaxLength()))
+        return 0;
+
+    // Only worth it when the partitions cost less than the taps they replace
+    const int numPartitions = static_cast<int>(length - 1) / PartitionedConvolver::kBlockSize;
+    const int tapCost = m_NumTapGroups * kTapsPerKernel * (m_Taps.numPoints + kPointCostPerTap);
+    if (numPartitions * kPointCostPerPartition + kPointCostOfTransforms >= tapCost)
+        return 0;
+    return static_cast<int>(length);
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::renderImpulseResponse(int maxSamples)
+{
+    // A unit impulse through the cooked taps, in runs just like process
+    const int end = std::min(m_ImpulseRendered + maxSamples, m_ImpulseLength);
+    while (m_ImpulseRendered < end)
+    {
+        const int runLength = std::min(end - m_ImpulseRendered, m_SafeRunLength);
+        computeTapSums(m_ImpulseBuffer, m_Taps, m_NumTapGroups, runLength, m_FeedbackSum, m_WetSum);
+        for (int n = 0; n < runLength; n++)
+        {
+            const int i = m_ImpulseRendered + n;
+            m_WriteBlock[n] = (i == 0 ? 1.0 : 0.0) + m_GainLimiter * m_FeedbackSum[n];
+            m_ImpulseWet[i] = m_WetSum[n];
+            m_ImpulseFeedback[i] = m_FeedbackSum[n];
+        }
+        m_ImpulseBuffer.writeSpan(m_WriteBlock, runLength);
+        m_ImpulseRendered += runLength;
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::invalidateConvolution()
+{
+    m_StaticSamples = 0;
+    m_ImpulseState = kImpulseNone;
+
+    // Fade back to the taps on the responses still loaded
+    m_ConvolutionMixStep = m_ConvolutionMix > 0.0 ? -1.0 / kConvolutionFade : 0.0;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::updateConvolution(int numChannels)
+{
+    m_ConvolutionReady = m_ConvolutionEnabled && m_Convolver.getNumChannels() == numChannels;
+    if (!m_ConvolutionReady)
+    {
+        m_ConvolutionMix = 0.0;
+        m_ConvolutionMixStep = 0.0;
+        return;
+    }
+
+    // A glide changes the taps every control step
+    if (m_Ramping)
+        invalidateConvolution();
+
+    // Rendering and loading are spread over several blocks to keep each one short
+    const int renderSamplesPerBlock = 2048;
+    const int partitionsPerBlock = 16;
+
+    switch (m_ImpulseState)
+    {
+        case kImpulseNone:
+            // Wait for the taps to be cooked, and for a fade back to them to finish
+            // before the loaded responses are overwritten
+            if (m_DirtyMask || m_CookedCapacity == 0 || m_ConvolutionMix > 0.0)
+                break;
+            m_Convolver.setOutputEnabled(false);
+            m_ImpulseLength = getImpulseLength();
+            if (m_ImpulseLength == 0)
+                break;
+            // The input history starts over with the new responses
+            m_Convolver.reset();
+            m_StaticSamples = 0;
+            m_ImpulseBuffer.clear();
+            m_ImpulseRendered = 0;
+            m_ImpulseState = kImpulseRendering;
+            break;
+
+        case kImpulseRendering:
+            renderImpulseResponse(renderSamplesPerBlock);
+            if (m_ImpulseRendered == m_ImpulseLength)
+            {
+                m_Convolver.beginImpulseResponse(m_ImpulseLength);
+                m_ImpulseState = kImpulseLoading;
+            }
+            break;
+
+        case kImpulseLoading:
+            if (m_Convolver.loadPartitions(m_ImpulseWet.data(), m_ImpulseFeedback.data(), partitionsPerBlock))
+            {
+                m_Convolver.setOutputEnabled(true);
+                m_ImpulseState = kImpulseReady;
+            }
+            break;
+
+        case kImpulseReady:
+            // Only once the input history covers the whole response does the convolution sound like the taps
+            if (m_ConvolutionMix == 0.0 && m_ConvolutionMixStep == 0.0 && m_Convolver.hasOutput()
+                && m_StaticSamples >= m_ImpulseLength)
+                m_ConvolutionMixStep = 1.0 / kConvolutionFade;
+            break;
+    }
+}
+
+//------------------------------------------------------------------------
+template <typename SampleType>
+void DelayEngine::mixConvolution(const SampleType* const* inputs, int offset, int numChannels, int runLength, bool timeDomain)
+{
+    // Nothing to feed until the taps are being frozen, or while the last responses fade out
+    if (m_ImpulseState == kImpulseNone && m_ConvolutionMix == 0.0)
+        return;
+
+    // From then on the convolver sees every input sample, so its history is complete by the time it plays
+    for (int c = 0; c < numChannels; c++)
+    {
+        const SampleType* in = inputs[c] + offset;
+        for (int n = 0; n < runLength; n++)
+            m_ConvolutionInput[n * numChannels + c] = static_cast<double>(in[n]);
+    }
+    m_Convolver.process(m_ConvolutionInput, runLength, m_ConvolutionWet, m_ConvolutionFeedback);
+
+    if (m_ConvolutionMix == 0.0 && m_ConvolutionMixStep <= 0.0)
+        return;
+
+    const int count = runLength * numChannels;
+    if (!timeDomain)
+    {
+        // Frozen: the convolution stands in for the taps, delay memory included
+        std::copy(m_ConvolutionWet, m_ConvolutionWet + count, m_WetSum);
+        std::copy(m_ConvolutionFeedback, m_ConvolutionFeedback + count, m_FeedbackSum);
+        return;
+    }
+
+    // Crossfade the wet sums, the delay memory keeps being fed by the taps
+    for (int n = 0; n < runLength; n++)
+    {
+        const double fade = std::min(std::max(m_ConvolutionMix + (n + 1) * m_ConvolutionMixStep, 0.0), 1.0);
+        for (int c = 0; c < numChannels; c++)
+        {
+            const int i = n * numChannels + c;
+            m_WetSum[i] += fade * (m_ConvolutionWet[i] - m_WetSum[i]);
+        }
+    }
+
+    m_ConvolutionMix = std::min(std::max(m_ConvolutionMix + runLength * m_ConvolutionMixStep, 0.0), 1.0);
+    if (m_ConvolutionMix == 0.0 || m_ConvolutionMix == 1.0)
+        m_ConvolutionMixStep = 0.0;
+}
+
+//------------------------------------------------------------------------
+int DelayEngine::beginRun(const MultiChannelBuffer& buffer, int maxLength, bool& modulated)
+{
+    // Glides move one control step at a time
+    if (m_Ramping && m_ControlCountdown == 0)
+        advanceSmoothers();
+
+    // Only taps touched by a parameter change since the last run are re-cooked
+    if (m_DirtyMask || buffer.getCapacity() != m_CookedCapacity)
+        updateTapTable(buffer.getCapacity());
+
+    // Modulated taps ramp through one LFO interval at a time
+    modulated = isModulated();
+    if (modulated && m_LfoCountdown == 0)
+    {
+        m_Lfo.nextInterval(m_ControlInterval);
+        m_LfoCountdown = m_ControlInterval;
+    }
+
+    // While ramping a run never crosses a control point, nor the end of an LFO interval
+    int runLength = std::min(maxLength, m_SafeRunLength);
+    if (m_Ramping)
+        runLength = std::min(runLength, m_ControlCountdown);
+    if (modulated)
+        runLength = std::min(runLength, m_LfoCountdown);
+    if (m_PresetFade > 0.0)
+        runLength = std::min(runLength, m_FadeSafeRunLength);
+    return runLength;
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::endRun(int runLength, int numChannels, bool modulated)
+{
+    if (m_Ramping)
+    {
+        m_WetMix += runLength * m_WetMixStep;
+        m_GainMaster += runLength * m_GainMasterStep;
+        m_DryMix = 1.0 - m_WetMix;
+        m_GainLimiter = 1.0 - m_WetMix * 0.5;
+        m_ControlCountdown -= runLength;
+    }
+
+    if (modulated)
+        m_LfoCountdown -= runLength;
+
+    trackSilence(runLength, numChannels);
+    m_StaticSamples += runLength;
+}
+
+//------------------------------------------------------------------------
+template <typename SampleType>
+void DelayEngine::process(MultiChannelBuffer& buffer, const SampleType* const* inputs, SampleType* const* outputs, int numSamples)
+{
+    if (m_RateReduction > 1)
+    {
+        processReduced(buffer, inputs, outputs, numSamples);
+        return;
+    }
+
+    const int numChannels = buffer.getNumChannels();
+
+    updateConvolution(numChannels);
+
+    int processed = 0;
+    while (processed < numSamples)
+    {
+        bool modulated;
+        const int runLength = beginRun(buffer, numSamples - processed, modulated);
+
+        // Interpolation stage, or the convolution once the taps are frozen, or both while crossfading.
+        // A preset change always brings the taps back, so its crossfade is in the time domain.
+        const bool timeDomain = m_ConvolutionMix < 1.0 || m_ConvolutionMixStep < 0.0;
+        if (timeDomain)
+            computeTapSums(buffer, m_Taps, m_NumTapGroups, runLength, m_FeedbackSum, m_WetSum);
+        if (timeDomain && m_PresetFade > 0.0)
+            mixPresetFade(buffer, runLength);
+        if (m_ConvolutionReady)
+            mixConvolution(inputs, processed, numChannels, runLength, timeDomain);
+
+        if (!m_Ramping)
+        {
+            // Feedback stage: mix the input with the limited feedback and write it back into the buffer
+            for (int c = 0; c < numChannels; c++)
+            {
+                const SampleType* in = inputs[c] + processed;
+                for (int n = 0; n < runLength; n++)
+                {
+                    const int i = n * numChannels + c;
+                    m_WriteBlock[i] = static_cast<double>(in[n]) + m_GainLimiter * m_FeedbackSum[i];
+                }
+            }
+            buffer.writeSpan(m_WriteBlock, runLength);
+
+            // Mix stage: dry input plus the weighted taps through the gain limiter, in place of the wet sums,
+            // then the allpass filter of every channel and the master gain
+            for (int c = 0; c < numChannels; c++)
+            {
+                const SampleType* in = inputs[c] + processed;
+                for (int n = 0; n < runLength; n++)
+                {
+                    const int i = n * numChannels + c;
+                    double mixedAudio = (m_DryMix * in[n]) + (m_WetMix * m_WetSum[i]);
+                    m_WetSum[i] = static_cast<SampleType>(m_GainLimiter * mixedAudio);
+                }
+            }
+            m_AllpassKernel(m_WetSum, numChannels, runLength, m_AllpassCoefficient, m_AllpassInput, m_AllpassOutput);
+            for (int c = 0; c < numChannels; c++)
+            {
+                SampleType* out = outputs[c] + processed;
+                for (int n = 0; n < runLength; n++)
+                    out[n] = static_cast<SampleType>(m_WetSum[n * numChannels + c] * m_GainMaster);
+            }
+        }
+        else
+        {
+            // The same stages with the wet mix and master gain stepping every sample
+            for (int c = 0; c < numChannels; c++)
+            {
+                const SampleType* in = inputs[c] + processed;
+                for (int n = 0; n < runLength; n++)
+                {
+                    const int i = n * numChannels + c;
+                    const double gainLimiter = 1.0 - (m_WetMix + (n + 1) * m_WetMixStep) * 0.5;
+                    m_WriteBlock[i] = static_cast<double>(in[n]) + gainLimiter * m_FeedbackSum[i];
+                }
+            }
+            buffer.writeSpan(m_WriteBlock, runLength);
+
+            for (int c = 0; c < numChannels; c++)
+            {
+                const SampleType* in = inputs[c] + processed;
+                for (int n = 0; n < runLength; n++)
+                {
+                    const int i = n * numChannels + c;
+                    const double wetMix = m_WetMix + (n + 1) * m_WetMixStep;
+                    double mixedAudio = ((1.0 - wetMix) * in[n]) + (wetMix * m_WetSum[i]);
+                    m_WetSum[i] = static_cast<SampleType>((1.0 - wetMix * 0.5) * mixedAudio);
+                }
+            }
+            m_AllpassKernel(m_WetSum, numChannels, runLength, m_AllpassCoefficient, m_AllpassInput, m_AllpassOutput);
+            for (int c = 0; c < numChannels; c++)
+            {
+                SampleType* out = outputs[c] + processed;
+                for (int n = 0; n < runLength; n++)
+                {
+                    const double gainMaster = m_GainMaster + (n + 1) * m_GainMasterStep;
+                    out[n] = static_cast<SampleType>(m_WetSum[n * numChannels + c] * gainMaster);
+                }
+            }
+        }
+
+        endRun(runLength, numChannels, modulated);
+        processed += runLength;
+    }
+}
+
+//------------------------------------------------------------------------
+template <typename SampleType>
+void DelayEngine::processReduced(MultiChannelBuffer& buffer, const SampleType* const* inputs, SampleType* const* outputs,
+                                 int numSamples)
+{
+    const int numChannels = buffer.getNumChannels();
+
+    int processed = 0;
+    while (processed < numSamples)
+    {
+        const int chunkLength = std::min(numSamples - processed, kMaxSubBlock);
+
+        // A mix change still waiting to be cooked lands at the start of the chunk. The mix stage
+        // ramps from here to wherever the reduced runs leave the mix at the end of the chunk.
+        if (m_DirtyMask || buffer.getCapacity() != m_CookedCapacity)
+            updateTapTable(buffer.getCapacity());
+        const double wetMixStart = m_WetMix;
+        const double gainMasterStart = m_GainMaster;
+
+        for (int c = 0; c < numChannels; c++)
+        {
+            const SampleType* in = inputs[c] + processed;
+            for (int n = 0; n < chunkLength; n++)
+                m_HostBlock[n * numChannels + c] = static_cast<double>(in[n]);
+        }
+        const int numReduced = m_Decimator.process(m_HostBlock, numChannels, chunkLength, m_ReducedInput);
+
+        // Interpolation and feedback stages at the reduced rate, the wet sums interpolated
+        // back up behind the frames the last chunk left over
+        int done = 0;
+        while (done < numReduced)
+        {
+            bool modulated;
+            const int runLength = beginRun(buffer, numReduced - done, modulated);
+
+            computeTapSums(buffer, m_Taps, m_NumTapGroups, runLength, m_FeedbackSum, m_WetSum);
+            if (m_PresetFade > 0.0)
+                mixPresetFade(buffer, runLength);
+
+            // The taps were read early for the wet output, so the feedback waits out the filters'
+            // latency behind the ones before it and every repeat keeps the full tap time
+            double* feedback = m_DelayedFeedback + m_ResamplerLatency * numChannels;
+            if (!m_Ramping)
+            {
+                for (int i = 0; i < runLength * numChannels; i++)
+                    feedback[i] = m_GainLimiter * m_FeedbackSum[i];
+            }
+            else
+            {
+                for (int n = 0; n < runLength; n++)
+                {
+                    const double gainLimiter = 1.0 - (m_WetMix + (n + 1) * m_WetMixStep) * 0.5;
+                    for (int c = 0; c < numChannels; c++)
+                    {
+                        const int i = n * numChannels + c;
+                        feedback[i] = gainLimiter * m_FeedbackSum[i];
+                    }
+                }
+            }
+            const double* in = m_ReducedInput + done * numChannels;
+            for (int i = 0; i < runLength * numChannels; i++)
+                m_WriteBlock[i] = in[i] + m_DelayedFeedback[i];
+            buffer.writeSpan(m_WriteBlock, runLength);
+            std::copy(m_DelayedFeedback + runLength * numChannels,
+                      m_DelayedFeedback + (runLength + m_ResamplerLatency) * numChannels, m_DelayedFeedback);
+
+            m_Interpolator.process(m_WetSum, numChannels, runLength, m_ReducedWet + m_ReducedWetFrames * numChannels);
+            m_ReducedWetFrames += runLength * m_RateReduction;
+
+            endRun(runLength, numChannels, modulated);
+            done += runLength;
+        }
+
+        // Mix stage at the host rate, the same as in process with the wet mix and master gain
+        // ramped over the chunk. A steady mix runs over the interleaved samples in one go.
+        const double wetMixStep = (m_WetMix - wetMixStart) / chunkLength;
+        const double gainMasterStep = (m_GainMaster - gainMasterStart) / chunkLength;
+        if (wetMixStep == 0.0)
+        {
+            const double dryMix = 1.0 - wetMixStart;
+            const double gainLimiter = 1.0 - wetMixStart * 0.5;
+            for (int i = 0; i < chunkLength * numChannels; i++)
+            {
+                double mixedAudio = (dryMix * m_HostBlock[i]) + (wetMixStart * m_ReducedWet[i]);
+                m_HostBlock[i] = static_cast<SampleType>(gainLimiter * mixedAudio);
+            }
+        }
+        else
+        {
+            for (int n = 0; n < chunkLength; n++)
+            {
+                const double wetMix = wetMixStart + (n + 1) * wetMixStep;
+                for (int c = 0; c < numChannels; c++)
+                {
+                    const int i = n * numChannels + c;
+                    double mixedAudio = ((1.0 - wetMix) * m_HostBlock[i]) + (wetMix * m_ReducedWet[i]);
+                    m_HostBlock[i] = static_cast<SampleType>((1.0 - wetMix * 0.5) * mixedAudio);
+                }
+            }
+        }
+        m_AllpassKernel(m_HostBlock, numChannels, chunkLength, m_AllpassCoefficient, m_AllpassInput, m_AllpassOutput);
+        for (int c = 0; c < numChannels; c++)
+        {
+            SampleType* out = outputs[c] + processed;
+            if (gainMasterStep == 0.0)
+            {
+                for (int n = 0; n < chunkLength; n++)
+                    out[n] = static_cast<SampleType>(m_HostBlock[n * numChannels + c] * gainMasterStart);
+            }
+            else
+            {
+                for (int n = 0; n < chunkLength; n++)
+                {
+                    const double gainMaster = gainMasterStart + (n + 1) * gainMasterStep;
+                    out[n] = static_cast<SampleType>(m_HostBlock[n * numChannels + c] * gainMaster);
+                }
+            }
+        }
+
+        // Keep the wet frames the next chunk starts with
+        m_ReducedWetFrames -= chunkLength;
+        std::copy(m_ReducedWet + chunkLength * numChannels,
+                  m_ReducedWet + (chunkLength + m_ReducedWetFrames) * numChannels, m_ReducedWet);
+        processed += chunkLength;
+    }
+}
+
+//------------------------------------------------------------------------
+template <typename SampleType>
+void DelayEngine::processDry(MultiChannelBuffer& buffer, const SampleType* const* inputs, SampleType* const* outputs,
+                             int numSamples)
+{
+    const int numChannels = buffer.getNumChannels();
+    skipSilence(buffer, numSamples);
+
+    // The delay lines are silent, so nothing is left to glide but the mix. It ramps from where it
+    // is now to its target, or to a change that is still waiting to be cooked, over the block.
+    const double wetMixStart = m_WetMix;
+    const double gainMasterStart = m_GainMaster;
+    if (m_Ramping)
+        snapParameters();
+    if (m_DirtyMask || buffer.getCapacity() != m_CookedCapacity)
+        updateTapTable(buffer.getCapacity());
+    const double wetMixStep = (m_WetMix - wetMixStart) / std::max(numSamples, 1);
+    const double gainMasterStep = (m_GainMaster - gainMasterStart) / std::max(numSamples, 1);
+
+    // The mix stage of process with the wet sums at zero
+    int processed = 0;
+    while (processed < numSamples)
+    {
+        const int runLength = std::min(numSamples - processed, kMaxSubBlock);
+        for (int c = 0; c < numChannels; c++)
+        {
+            const SampleType* in = inputs[c] + processed;
+            for (int n = 0; n < runLength; n++)
+            {
+                const double wetMix = wetMixStart + (processed + n + 1) * wetMixStep;
+                double mixedAudio = (1.0 - wetMix) * in[n];
+                m_HostBlock[n * numChannels + c] = static_cast<SampleType>((1.0 - wetMix * 0.5) * mixedAudio);
+            }
+        }
+        m_AllpassKernel(m_HostBlock, numChannels, runLength, m_AllpassCoefficient, m_AllpassInput, m_AllpassOutput);
+        for (int c = 0; c < numChannels; c++)
+        {
+            SampleType* out = outputs[c] + processed;
+            for (int n = 0; n < runLength; n++)
+            {
+                const double gainMaster = gainMasterStart + (processed + n + 1) * gainMasterStep;
+                out[n] = static_cast<SampleType>(m_HostBlock[n * numChannels + c] * gainMaster);
+            }
+        }
+        processed += runLength;
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::skipSilence(MultiChannelBuffer& buffer, int numSamples)
+{
+    // At a reduced rate the memory moves on by whole frames, the rest is carried to the next block
+    m_SkippedSamples += numSamples;
+    int numFrames = m_SkippedSamples / m_RateReduction;
+    m_SkippedSamples -= numFrames * m_RateReduction;
+
+    // Once every channel has been quiet for the length of the memory there is nothing left to overwrite
+    const int numChannels = buffer.getNumChannels();
+    int quiet = kMaxQuietSamples;
+    for (int c = 0; c < numChannels; c++)
+        quiet = std::min(quiet, m_QuietSamples[c]);
+    if (quiet >= buffer.getCapacity())
+        return;
+
+    std::fill(m_WriteBlock, m_WriteBlock + kMaxSubBlock * numChannels, 0.0);
+    while (numFrames > 0)
+    {
+        const int runLength = std::min(numFrames, kMaxSubBlock);
+        buffer.writeSpan(m_WriteBlock, runLength);
+        trackSilence(runLength, numChannels);
+        numFrames -= runLength;
+    }
+}
+
+//------------------------------------------------------------------------
+void DelayEngine::trackSilence(int runLength, int numChannels)
+{
+    for (int c = 0; c < numChannels; c++)
+    {
+        // Find the newest sample of the run that is still audible
+        int n = runLength - 1;
+        while (n >= 0 && std::abs(m_WriteBlock[n * numChannels + c]) < kSilenceThreshold)
+            n--;
+
+        // Capped so the count can run on through any length of silence
+        const int quiet = n >= 0 ? runLength - 1 - n : m_QuietSamples[c] + runLength;
+        m_QuietSamples[c] = std::min(quiet, kMaxQuietSamples);
+    }
+}
+
+//------------------------------------------------------------------------
+bool DelayEngine::isTailSilent(int numChannels) const
+{
+    // Before the first block the tap table has not been cooked and nothing is known,
+    // and while a preset fades out its taps may reach further back
+    if (m_CookedCapacity == 0 || m_PresetFade > 0.0)
+        return false;
+
+    // The allpass history has to have died away as well, and at a reduced rate the interpolator's
+    // and the feedback still on its way to the memory
+    const int resamplerReach = m_RateReduction > 1 ? m_ResamplerLatency + 1 : 0;
+    for (int c = 0; c < numChannels; c++)
+    {
+        if (m_QuietSamples[c] < m_LongestReach + resamplerReach || std::abs(m_AllpassOutput[c]) >= kSilenceThreshold)
+            return false;
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+int64_t DelayEngine::getTailSamples() const
+{
+    // Same tap times as the tap table, but from the targets so it holds before the next block
+    const int firstTapIndex = getParamIndex(kParamDelayLengthId_Tap1);
+    const double firstDelay = getTargetValue(firstTapIndex) * m_MaxDelay;
+    const double maxFeedbackGain = 0.8;
+
+    double longestDelay = 0.0;
+    double loopGain = 0.0;
+    const int numTaps = getNumTaps();
+    for (int t = 0; t < numTaps; t++)
+    {
+        const double* tapParams = &m_Params[getTapParamIndex(t)];
+        longestDelay = std::max(longestDelay, t == 0 ? firstDelay : tapParams[0] * firstDelay);
+        loopGain += std::min(tapParams[2], maxFeedbackGain);
+    }
+
+    // Every pass through the feedback path is scaled by the gain limiter
+    loopGain *= 1.0 - m_Params[getParamIndex(kParamWetMixId)] * 0.5;
+    if (loopGain >= 1.0)
+        return kInfiniteTail;
+
+    // Each repeat comes back no later than the longest tap and at least 'loopGain' quieter,
+    int64_t repeats = 0;
+    if (loopGain > 0.0)
+        repeats = static_cast<int64_t>(std::ceil(std::log(kSilenceThreshold) / std::log(loopGain)));
+    // plus a few samples for the interpolation window and however far the modulation stretches it,
+    // and at a reduced rate the window in reduced samples and the resampling filters
+    const double depth = m_Params[getParamIndex(kParamModDepthId)] * kMaxModDepth;
+    const int mode = getListIndex(m_Params[getParamIndex(kParamInterpolationId)], kNumInterpolationModes);
+    const int reach = (getInterpolationPoints(static_cast<InterpolationMode>(mode)) / 2 + 1) * m_RateReduction
+                    + m_ResamplerLatency * m_RateReduction;
+    const int64_t longestSamples = static_cast<int64_t>(std::ceil((longestDelay + depth) * m_HostSampleRate)) + reach;
+
+    // and the time the allpass filter rings on after the last repeat, longer the larger its coefficient
+    const double g = getAllpassCoefficient(m_Params[getParamIndex(kParamAllpassId)]);
+    int64_t settleSamples = 0;
+    if (g > 0.0)
+        settleSamples = static_cast<int64_t>(std::ceil(std::log(kSilenceThreshold) / std::log(g)));
+    return longestSamples * (repeats + 1) + settleSamples;
+}
+
+//------------------------------------------------------------------------
+// Function to calculate the coefficient for the allpass filter
+void DelayEngine::calculateAllpassCoefficient(double value)
+{
+    // Store the calculated coefficient in the member variable 'm_AllpassCoefficient' for later use.
+    m_AllpassCoefficient = getAllpassCoefficient(value);
+}
+
+template void DelayEngine::process<float>(MultiChannelBuffer&, const float* const*, float* const*, int);
+template void DelayEngine::process<double>(MultiChannelBuffer&, const double* const*, double* const*, int);
+template void DelayEngine::processDry<float>(MultiChannelBuffer&, const float* const*, float* const*, int);
+template void DelayEngine::processDry<double>(MultiChannelBuffer&, const double* const*, double* const*, int);
+
+static_assert(DelayEngine::kMaxSubBlock <= HalfbandResampler::kMaxBlock, "a chunk has to fit the resampling filters");
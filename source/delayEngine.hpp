@@ -0,0 +1,510 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Block based multi-tap engine used by delay2Processor::process.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "fftConvolver.hpp"
+#include "multiChannelBuffer.hpp"
+#include "parameterSmoother.hpp"
+#include "parameters.hpp"
+#include "polyphaseResampler.hpp"
+#include "tapKernels.hpp"
+#include "wavetableLfo.hpp"
+#include <cmath>
+
+//------------------------------------------------------------------------
+//  DelayEngine
+//------------------------------------------------------------------------
+// The parameters live in a dense array indexed by ID offset. Every derived
+// value (delay in samples, clamped feedback, gain limiter) is "cooked" into
+// a small table, and a parameter change only marks the taps that depend on
+// it for re-cooking before the next block.
+//
+// process() works through the block in sub-blocks that are short enough for
+// every tap to read only samples that were written before the sub-block
+// started, which lets each stage run as a tight loop instead of
+// interleaving them per sample. The interpolation stage evaluates the taps
+// four at a time for every channel of a frame in one of the SIMD kernels,
+// reading the interleaved delay memory.
+//
+// Every tap is a host parameter: taps 1 to 4 in the main range, taps 5 to
+// kMaxTaps in one of their own, with the Tap Count parameter saying how many
+// are in use. Taps that neither reach the output nor the feedback are left
+// out of the cooked table and the rest is sorted by delay, so the cost
+// follows the number of active taps and consecutive kernel groups read the
+// ring in order.
+//
+// With the convolution mode enabled, a tap setup that has stopped moving is
+// frozen into a pair of impulse responses (delay memory input to wet sum and
+// to feedback sum), rendered a little per block through the same kernels.
+// Once ready the engine crossfades to the PartitionedConvolver, which costs
+// the same for any number of taps and keeps the delay memory fed from its
+// feedback response. The first parameter change fades back to the taps.
+//
+// Parameter changes glide to their new value in control steps of a few
+// dozen samples. Tap times, gains and feedback move once per control step,
+// the wet mix and master gain are ramped per sample in between. Lists and
+// switches have no values in between and change at once. Once every
+// smoother has settled the engine is back on constant coefficients. A whole
+// preset is not glided: the taps jump, and for a few milliseconds both the
+// old and the new tap table are read and crossfaded, so there is neither a
+// pitch sweep nor a click.
+//
+// The Interpolation parameter picks how the taps read between samples.
+// Cubic runs the tap kernels above; every other mode runs FIR kernels on
+// window weights that are cooked with the tap table, so a static tap pays
+// for its mode once per change rather than per sample. Wider windows keep
+// the taps further from the write position and shorten the sub-blocks.
+//
+// With a modulation depth above zero every tap time swings around its
+// setting, each tap following its own LFO with the phases spread evenly
+// over the taps. The LFO is only looked up at control points and the tap
+// times ramp linearly in between, while the modulated kernels work out the
+// read position of every sample for four taps at once. A depth of zero
+// keeps the static path, so the modulation costs nothing while it is off.
+//
+// With tempo sync on, the tap 1 time is a note value at the host tempo. It
+// is worked out only when the tempo, the time signature or one of the sync
+// parameters changes, and reaches the taps as a glide of the tap 1 time, so
+// the cooked table stays as it is in between and a tempo ramp is followed
+// smoothly.
+//
+// At high sample rates the taps and the feedback can run at a half or a
+// quarter of the rate. The input is decimated before it is written to the
+// delay memory, the wet sums are interpolated back up, and only the mix
+// stage runs at the host rate, so the dry signal passes untouched. Tap
+// times, glides and the LFO are all cooked for the reduced rate, the delay
+// memory shrinks by the same factor, and the taps are pulled in by the
+// filters' latency so the echoes stay where they belong. The convolution
+// mode is not used while the rate is reduced.
+//
+// Every channel also counts how many samples ago something above the
+// silence threshold was last written to its delay memory. Once that is
+// further back than the longest tap reaches, the delay lines have nothing
+// left to play and the processor can skip the taps and the feedback until
+// the input comes back. The delay memory keeps moving on with silence, so a
+// tap lengthened in the meantime finds what it would have found anyway.
+class DelayEngine
+{
+public:
+    // Taps 1 to 4 are in the main parameter range, the rest in the extra tap range
+    static const int kNumParamTaps = 4;
+    static const int kMaxTaps = kNumParamTaps + kNumExtraTaps;
+
+    // The tap kernels work on groups of this many taps
+    static const int kTapsPerKernel = 4;
+
+    // Longest run handled in one go, sizes the scratch buffers below
+    static const int kMaxSubBlock = 256;
+
+    // Default smoothing: 20 ms glides, advanced every 32 samples
+    static constexpr double kDefaultSmoothingTime = 0.02;
+    static const int kDefaultControlInterval = 32;
+
+    // Range of the tap 1 time: a normalised value of 1 is this many seconds
+    static constexpr double kDefaultMaxDelay = 1.0;
+    static constexpr double kMinMaxDelay = 0.01;
+    static constexpr double kMaxMaxDelay = 10.0;
+
+    // Tempo the synced tap times follow until the host reports one
+    static constexpr double kDefaultTempo = 120.0;
+
+    // Range of the LFO rate in Hz, spread exponentially over the parameter,
+    // and the tap time swing at full depth in seconds, either way
+    static constexpr double kMinModRate = 0.05;
+    static constexpr double kMaxModRate = 10.0;
+    static constexpr double kMaxModDepth = 0.01;
+
+    // Longest impulse response the convolution mode takes on
+    static const int kMaxImpulseLength = 1 << 12;
+
+    // Rough cost per frame and channel, counted in interpolation points: a tap reads its window
+    // plus a little overhead, the convolution pays for each partition and for the forward and
+    // inverse transform of every block. Only dense setups in the wide modes come out ahead.
+    static const int kPointCostPerTap = 2;
+    static const int kPointCostPerPartition = 18;
+    static const int kPointCostOfTransforms = 720;
+
+    // Largest allpass coefficient, so the filter's ring-out stays finite
+    static constexpr double kMaxAllpassCoefficient = 0.99;
+
+    // Length of the crossfades between the taps and the convolution
+    static const int kConvolutionFade = 512;
+
+    // Length of the crossfade from one preset's taps to the next
+    static constexpr double kPresetFadeTime = 0.01;
+
+    // Level below which input and delay memory count as silent (-90 dB)
+    static constexpr double kSilenceThreshold = 3.1623e-5;
+
+    // getTailSamples() result when the feedback never decays
+    static const int64_t kInfiniteTail = -1;
+
+    DelayEngine();
+
+    /** Overrides the detected instruction set, e.g. to compare against the scalar kernel */
+    void setSimdLevel(SimdLevel level)
+    {
+        m_TapKernel = getTapKernel(level);
+        m_FrameKernel = getFrameKernel(level);
+        m_ModulatedKernel = getModulatedKernel(level);
+        m_FirKernel = getFirKernel(level);
+        m_ModulatedFirKernel = getModulatedFirKernel(level);
+        m_AllpassKernel = getAllpassKernel(level);
+    }
+
+    /** Sample rate the delay times are converted with, all taps are re-cooked before the next block */
+    void setSampleRate(double sampleRate);
+
+    /** Runs the taps and the feedback at 1/factor of the sample rate, with a factor of 1, 2 or 4.
+        Re-cooks the taps and clears the resampling filters, so set it up with the delay memory,
+        which has to be sized for getNetworkSampleRate(). */
+    void setRateReduction(int factor);
+    int getRateReduction() const { return m_RateReduction; }
+
+    /** Rate the taps, the feedback and the delay memory run at */
+    double getNetworkSampleRate() const { return m_SampleRate; }
+
+    /** Longest tap 1 time in seconds, which the normalised value is scaled to. Taps 2 to 4
+        are fractions of tap 1, so this is also the longest delay any tap can reach. */
+    void setMaxDelay(double seconds);
+    double getMaxDelay() const { return m_MaxDelay; }
+
+    /** Host tempo in quarter notes per minute and time signature, for the tempo synced tap 1 time.
+        Cheap to call every block: only a change re-cooks the taps, gliding to the new time. */
+    void setTempo(double beatsPerMinute, int timeSigNumerator, int timeSigDenominator);
+    double getTempo() const { return m_Tempo; }
+
+    /** Frames of delay memory needed to reach 'maxDelaySeconds' at 'sampleRate', the network rate
+        when the rate is reduced */
+    static int getRequiredCapacity(double maxDelaySeconds, double sampleRate);
+
+    /** Number of taps in use, 1 to kMaxTaps, through the Tap Count parameter */
+    void setNumTaps(int numTaps);
+    int getNumTaps() const { return getListIndex(m_Params[getParamIndex(kParamNumTapsId)], kMaxTaps) + 1; }
+
+    /** Settings of one tap in the units of the tap parameters: delay as a fraction of the
+        tap 1 time, gain and feedback. They go through setParameter and glide like any other
+        parameter change. Tap 1's delay is its own time and is left alone. */
+    void setTap(int tap, double delay, double gain, double feedback);
+
+    /** Lets the engine freeze a settled tap setup and run it through partitioned FFT convolution.
+        Allocates, so call it outside of process, with the channel count of the buffer. */
+    void setConvolution(bool enabled, int numChannels);
+    bool isConvolutionActive() const { return m_ConvolutionMix > 0.0; }
+
+    /** Bytes held by the convolution mode, on top of the engine itself */
+    std::size_t getFootprint() const;
+
+    /** Glide time of a parameter change and the number of samples between two control steps.
+        A time of 0 applies every change immediately. */
+    void setSmoothing(double timeSeconds, int controlInterval);
+
+    /** Ends every glide on its target, e.g. when processing (re)starts */
+    void snapParameters();
+
+    /** Clears the allpass history and treats the delay memory as silent, to go with a cleared buffer */
+    void reset();
+
+    /** Stores a normalised parameter value by dense index (see getParamIndex) and starts gliding towards it */
+    void setParameter(int index, double value);
+    double getParameter(int index) const { return m_Params[index]; }
+
+    /** Loads every parameter at once, e.g. from a preset. The taps jump to their new times instead of
+        gliding there, and the old and new tap table are crossfaded over kPresetFadeTime. The mix and
+        master gain glide as usual. A preset arriving mid-fade replaces the incoming taps. The new table is
+        cooked once on the next block, and nothing is re-cooked while the fade runs. Real-time safe. */
+    void crossfadeTo(const double* values);
+
+    /** Runs every channel of the buffer through the taps, the allpass filter and the master gain.
+        The outputs may be the same buffers as the inputs.
+        Instantiated for float and double, the two host sample sizes. */
+    template <typename SampleType>
+    void process(MultiChannelBuffer& buffer, const SampleType* const* inputs, SampleType* const* outputs, int numSamples);
+
+    /** process() for a block of input below kSilenceThreshold while isTailSilent holds: the taps
+        are skipped and only the dry signal goes through the mix stage, the allpass filter and
+        the master gain. A glide still running lands on its target, with the mix ramped there
+        over the block. The delay memory moves on as in skipSilence. */
+    template <typename SampleType>
+    void processDry(MultiChannelBuffer& buffer, const SampleType* const* inputs, SampleType* const* outputs, int numSamples);
+
+    /** Moves the delay memory on by 'numSamples' samples of silence without producing any output,
+        so it holds what process would have left there when a tap is moved before the input returns */
+    void skipSilence(MultiChannelBuffer& buffer, int numSamples);
+
+    /** Samples the output keeps ringing after the input stops, derived from the tap times
+        and feedback gains. kInfiniteTail if the feedback loop does not decay. */
+    int64_t getTailSamples() const;
+
+    /** True once the delay memory of the first numChannels channels has decayed below
+        kSilenceThreshold as far back as any tap reads */
+    bool isTailSilent(int numChannels) const;
+
+    /** True if no sample of the block reaches kSilenceThreshold */
+    template <typename SampleType>
+    static bool isSilent(const SampleType* const* inputs, int numChannels, int numSamples)
+    {
+        for (int c = 0; c < numChannels; c++)
+        {
+            for (int n = 0; n < numSamples; n++)
+            {
+                if (std::abs(static_cast<double>(inputs[c][n])) >= kSilenceThreshold)
+                    return false;
+            }
+        }
+        return true;
+    }
+
+private:
+    /** Re-cooks the dirty parts of the tap table */
+    void updateTapTable(int bufferCapacity);
+
+    /** Rebuilds the sorted kernel table from the cooked taps */
+    void sortTapTable();
+
+    // Kernel table: the active taps sorted by delay and padded with silent taps to whole
+    // kernel groups, one array per field so the kernels can load a group at once
+    struct TapTable
+    {
+        int sampleIndex[kMaxTaps];  // integer part of the delay in samples
+        double fraction[kMaxTaps];  // fractional part of the delay
+        double gain[kMaxTaps];      // tap output gain
+        double feedback[kMaxTaps];  // feedback gain after the safety clamp
+        double phase[kMaxTaps];     // LFO phase offset in cycles
+        double modDepth;            // LFO swing in samples, 0 while the taps stand still
+        InterpolationMode mode;     // how all taps read between samples
+        int numPoints;              // window width of the mode
+
+        // Window weights of every tap for the modes other than cubic, kMaxInterpolationPoints apart
+        double coefficients[kMaxTaps * kMaxInterpolationPoints];
+    };
+
+    /** Feedback and wet sums of the first 'numTapGroups' groups of 'taps' for one run */
+    void computeTapSums(const MultiChannelBuffer& buffer, const TapTable& taps, int numTapGroups, int runLength,
+                        double* feedbackSum, double* wetSum);
+
+    /** computeTapSums for a modulated table, at the current point of the LFO interval */
+    void computeModulatedTapSums(const MultiChannelBuffer& buffer, const TapTable& taps, int numTapGroups, int runLength,
+                                 double* feedbackSum, double* wetSum);
+
+    /** True while the tap table, or the one of a preset fading out, follows the LFO */
+    bool isModulated() const { return m_Taps.modDepth > 0.0 || (m_PresetFade > 0.0 && m_FadeTaps.modDepth > 0.0); }
+
+    /** Blends the sums of the outgoing preset's taps into m_FeedbackSum and m_WetSum for one run */
+    void mixPresetFade(const MultiChannelBuffer& buffer, int runLength);
+
+    /** Moves the convolution mode along at the start of a block: freezing the taps,
+        loading the partitions and starting the crossfade once everything is in place */
+    void updateConvolution(int numChannels);
+
+    /** Impulse response length needed for the cooked taps, 0 if they cannot be frozen */
+    int getImpulseLength() const;
+
+    /** Renders up to 'maxSamples' more samples of the frozen impulse responses */
+    void renderImpulseResponse(int maxSamples);
+
+    /** Drops the frozen responses after a change and fades back to the taps */
+    void invalidateConvolution();
+
+    /** Feeds the convolver and blends its output into the tap sums of one run */
+    template <typename SampleType>
+    void mixConvolution(const SampleType* const* inputs, int offset, int numChannels, int runLength, bool timeDomain);
+
+    /** Starts a glide of one parameter's smoother towards 'target', or marks it for cooking when
+        smoothing is off or the parameter is a list or switch */
+    void glideTo(int index, double target);
+
+    /** Value the smoother of a parameter heads for: the parameter itself, except for the
+        tap 1 time while tempo sync replaces it with the note value at the current tempo */
+    double getTargetValue(int index) const;
+
+    /** Retargets the tap 1 time after the tempo, the sync settings or the range changed */
+    void updateSyncedTime();
+
+    /** Moves every gliding parameter one control step and sets up the per sample ramps */
+    void advanceSmoothers();
+
+    /** Control steps per glide for the current sample rate */
+    void updateSmoothingSteps();
+
+    /** Starts a run of at most 'maxLength' samples: moves the glides and the LFO on, re-cooks what
+        changed and returns how long the run may be. 'modulated' tells endRun whether the LFO runs. */
+    int beginRun(const MultiChannelBuffer& buffer, int maxLength, bool& modulated);
+
+    /** Moves the ramps and counters past a run whose samples are in m_WriteBlock */
+    void endRun(int runLength, int numChannels, bool modulated);
+
+    /** process() with the taps and the feedback at the reduced rate and the mix stage at the host rate */
+    template <typename SampleType>
+    void processReduced(MultiChannelBuffer& buffer, const SampleType* const* inputs, SampleType* const* outputs,
+                        int numSamples);
+
+    /** Clears the resampling filters and primes the interpolated wet signal */
+    void resetResampler();
+
+    /** Updates the quiet counters from the sub-block just written to the delay memory */
+    void trackSilence(int runLength, int numChannels);
+
+    // Function to calculate allpass filter coefficients from the normalised Allpass parameter
+    void calculateAllpassCoefficient(double value);
+
+    // Parameter targets, one cache line apart from the rest of the engine
+    alignas(64) double m_Params[kNumParams];
+
+    // Smoothed values the tap table and the mix are cooked from
+    ParameterSmoother m_Smoothers[kNumParams];
+
+    // ParamDescriptor::dirtyMask bits of everything waiting to be re-cooked
+    uint32_t m_DirtyMask;
+
+    // Host rate, and the rate the taps run at, lower by the rate reduction
+    double m_HostSampleRate;
+    double m_SampleRate;
+    double m_MaxDelay;
+
+    // Host tempo and time signature the synced tap 1 time is worked out from
+    double m_Tempo;
+    int m_TimeSigNumerator;
+    int m_TimeSigDenominator;
+
+    // Buffer capacity the tap table was clamped to
+    int m_CookedCapacity;
+
+    // Glide time and control rate
+    double m_SmoothingTime;
+    int m_ControlInterval;
+    int m_SmoothingSteps;
+
+    // Samples left in the current control step, which only matters while a glide is running
+    int m_ControlCountdown;
+    bool m_Ramping;
+
+    // Taps in use as of the last time the tap table was cooked
+    int m_NumTaps;
+
+    // Every tap cooked in tap order, only the dirty ones are redone
+    struct CookedTap
+    {
+        double delaySamples;
+        double gain;
+        double feedback;
+    };
+
+    CookedTap m_CookedTaps[kMaxTaps];
+
+    TapTable m_Taps;
+    int m_NumTapGroups;
+
+    // Table of the preset being faded out, and its share of the sums: 1 right after
+    // crossfadeTo, stepping down to 0 per sample
+    TapTable m_FadeTaps;
+    int m_FadeTapGroups;
+    int m_FadeSafeRunLength;
+    double m_PresetFade;
+    double m_PresetFadeStep;
+
+    // Interpolation kernels picked for this CPU
+    TapKernel m_TapKernel;
+    FrameKernel m_FrameKernel;
+    ModulatedKernel m_ModulatedKernel;
+    FirKernel m_FirKernel;
+    ModulatedFirKernel m_ModulatedFirKernel;
+    AllpassKernel m_AllpassKernel;
+
+    // Tap time modulation, and the samples left in the LFO interval the taps are ramping through
+    WavetableLfo m_Lfo;
+    int m_LfoCountdown;
+
+    // Mix stage coefficients, plus their per sample increments while ramping.
+    // The dry mix and the limiter follow from the wet mix.
+    double m_DryMix;
+    double m_WetMix;
+    double m_GainLimiter;
+    double m_GainMaster;
+    double m_WetMixStep;
+    double m_GainMasterStep;
+
+    // Longest sub-block that never reads samples written inside itself
+    int m_SafeRunLength;
+
+    // Oldest sample any tap reads, in samples behind the write position
+    int m_LongestReach;
+
+    // Per channel: samples written since the last one above the silence threshold,
+    // counting stops at kMaxQuietSamples
+    static const int kMaxQuietSamples = 1 << 30;
+    int m_QuietSamples[MultiChannelBuffer::kMaxChannels];
+
+    // Host samples skipped at a reduced rate that did not make up a whole frame of delay memory
+    int m_SkippedSamples;
+
+    // Allpass filter coefficient, follows the Allpass parameter, and the filter history of every channel
+    double m_AllpassCoefficient;
+    alignas(32) double m_AllpassInput[MultiChannelBuffer::kMaxChannels];
+    alignas(32) double m_AllpassOutput[MultiChannelBuffer::kMaxChannels];
+
+    // Convolution mode: enabled, and sized for the buffer of the current block
+    PartitionedConvolver m_Convolver;
+    bool m_ConvolutionEnabled;
+    bool m_ConvolutionReady;
+
+    // Progress of freezing the taps into impulse responses
+    enum ImpulseState
+    {
+        kImpulseNone,
+        kImpulseRendering,
+        kImpulseLoading,
+        kImpulseReady
+    };
+
+    ImpulseState m_ImpulseState;
+    int m_ImpulseLength;
+    int m_ImpulseRendered;
+
+    // Mono delay memory the impulse is run through, and the two responses
+    MultiChannelBuffer m_ImpulseBuffer;
+    std::vector<double> m_ImpulseWet;
+    std::vector<double> m_ImpulseFeedback;
+
+    // Samples processed since the tap setup last changed
+    int64_t m_StaticSamples;
+
+    // 0 plays the taps only, 1 the convolution only, stepping per sample while crossfading
+    double m_ConvolutionMix;
+    double m_ConvolutionMixStep;
+
+    // Reduced rate: the factor, the filters on either side of the delay memory and their
+    // latency rounded up to whole reduced samples. The taps are read that much earlier for the
+    // wet output, and the feedback sums are held back by the same amount before they are written,
+    // so the repeats keep the full tap time.
+    int m_RateReduction;
+    PolyphaseDecimator m_Decimator;
+    PolyphaseInterpolator m_Interpolator;
+    int m_ResamplerLatency;
+    static const int kMaxResamplerLatency =
+        (2 * (HalfbandResampler::kMaxFactor - 1) * HalfbandResampler::kDelay + HalfbandResampler::kMaxFactor - 1)
+        / HalfbandResampler::kMaxFactor;
+
+    // Host rate input of a chunk, the decimated input, and the interpolated wet sums. The wet
+    // sums run up to a few frames ahead of the chunk, which are kept for the next one.
+    double m_HostBlock[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_ReducedInput[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_ReducedWet[(kMaxSubBlock + 3 * HalfbandResampler::kMaxFactor) * MultiChannelBuffer::kMaxChannels];
+    int m_ReducedWetFrames;
+
+    // Feedback sums on their way to the delay memory, m_ResamplerLatency frames behind the tap reads
+    double m_DelayedFeedback[(kMaxResamplerLatency + kMaxSubBlock) * MultiChannelBuffer::kMaxChannels];
+
+    // Interleaved scratch buffers for one sub-block
+    double m_FeedbackSum[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_WetSum[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_FadeFeedbackSum[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_FadeWetSum[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_WriteBlock[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_ConvolutionInput[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_ConvolutionWet[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+    double m_ConvolutionFeedback[kMaxSubBlock * MultiChannelBuffer::kMaxChannels];
+};
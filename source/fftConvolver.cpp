@@ -0,0 +1,273 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Uniformly partitioned FFT convolution used for frozen tap patterns.
+//------------------------------------------------------------------------
+
+#include "fftConvolver.hpp"
+#include <algorithm>
+#include <cmath>
+
+//------------------------------------------------------------------------
+void Fft::setSize(int size)
+{
+    m_Size = size;
+    int bits = 0;
+    while ((1 << bits) < size)
+        bits++;
+
+    m_BitReverse.resize(size);
+    for (int i = 0; i < size; i++)
+    {
+        int reversed = 0;
+        for (int b = 0; b < bits; b++)
+            reversed |= ((i >> b) & 1) << (bits - 1 - b);
+        m_BitReverse[i] = reversed;
+    }
+
+    const double pi = 3.14159265358979323846;
+    m_Twiddles.resize(size / 2);
+    for (int i = 0; i < size / 2; i++)
+        m_Twiddles[i] = std::polar(1.0, -2.0 * pi * i / size);
+}
+
+//------------------------------------------------------------------------
+void Fft::inverse(std::complex<double>* data) const
+{
+    transform(data, true);
+    const double scale = 1.0 / m_Size;
+    for (int i = 0; i < m_Size; i++)
+        data[i] *= scale;
+}
+
+//------------------------------------------------------------------------
+void Fft::transform(std::complex<double>* data, bool inverse) const
+{
+    for (int i = 0; i < m_Size; i++)
+    {
+        if (i < m_BitReverse[i])
+            std::swap(data[i], data[m_BitReverse[i]]);
+    }
+
+    for (int length = 2; length <= m_Size; length <<= 1)
+    {
+        const int half = length / 2;
+        const int stride = m_Size / length;
+        for (int start = 0; start < m_Size; start += length)
+        {
+            for (int k = 0; k < half; k++)
+            {
+                const std::complex<double> twiddle = m_Twiddles[k * stride];
+                const double twiddleImag = inverse ? -twiddle.imag() : twiddle.imag();
+                const std::complex<double> value = data[start + k + half];
+                const std::complex<double> odd(twiddle.real() * value.real() - twiddleImag * value.imag(),
+                                               twiddle.real() * value.imag() + twiddleImag * value.real());
+                data[start + k + half] = data[start + k] - odd;
+                data[start + k] += odd;
+            }
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+PartitionedConvolver::PartitionedConvolver()
+{
+    m_NumChannels = 0;
+    m_MaxPartitions = 0;
+    m_NumPartitions = 0;
+    m_LoadedPartitions = 0;
+    m_OutputEnabled = false;
+    m_OutputValid = false;
+    m_HistoryPos = 0;
+    m_BlockPos = 0;
+}
+
+//------------------------------------------------------------------------
+void PartitionedConvolver::setSize(int maxLength, int numChannels)
+{
+    if (maxLength <= kBlockSize || numChannels <= 0)
+    {
+        // Give the memory back rather than keeping the vectors' capacity around
+        std::vector<std::complex<double>>().swap(m_Spectra);
+        std::vector<std::complex<double>>().swap(m_History);
+        std::vector<double>().swap(m_Input);
+        std::vector<double>().swap(m_OutputA);
+        std::vector<double>().swap(m_OutputB);
+        std::vector<std::complex<double>>().swap(m_Scratch);
+        std::vector<double>().swap(m_AccumulateReal);
+        std::vector<double>().swap(m_AccumulateImag);
+        m_NumChannels = 0;
+        m_MaxPartitions = 0;
+        m_NumPartitions = 0;
+        m_LoadedPartitions = 0;
+        m_OutputEnabled = false;
+        m_OutputValid = false;
+        return;
+    }
+
+    // The first block of a response is never used, see the class comment
+    const int fftSize = 2 * kBlockSize;
+    m_NumChannels = numChannels;
+    m_MaxPartitions = (maxLength - 1) / kBlockSize;
+    m_Fft.setSize(fftSize);
+
+    m_Spectra.assign(static_cast<size_t>(m_MaxPartitions) * fftSize, 0.0);
+    m_History.assign(static_cast<size_t>(m_MaxPartitions) * fftSize * numChannels, 0.0);
+    m_Input.assign(static_cast<size_t>(fftSize) * numChannels, 0.0);
+    m_OutputA.assign(static_cast<size_t>(kBlockSize) * numChannels, 0.0);
+    m_OutputB.assign(static_cast<size_t>(kBlockSize) * numChannels, 0.0);
+    m_Scratch.assign(fftSize, 0.0);
+    m_AccumulateReal.assign(fftSize, 0.0);
+    m_AccumulateImag.assign(fftSize, 0.0);
+
+    m_NumPartitions = 0;
+    m_LoadedPartitions = 0;
+    m_OutputEnabled = false;
+    m_OutputValid = false;
+    m_HistoryPos = 0;
+    m_BlockPos = 0;
+}
+
+//------------------------------------------------------------------------
+std::size_t PartitionedConvolver::getFootprint() const
+{
+    return (m_Spectra.capacity() + m_History.capacity() + m_Scratch.capacity()) * sizeof(std::complex<double>)
+         + (m_Input.capacity() + m_OutputA.capacity() + m_OutputB.capacity() + m_AccumulateReal.capacity()
+            + m_AccumulateImag.capacity()) * sizeof(double);
+}
+
+//------------------------------------------------------------------------
+void PartitionedConvolver::reset()
+{
+    std::fill(m_History.begin(), m_History.end(), 0.0);
+    std::fill(m_Input.begin(), m_Input.end(), 0.0);
+    std::fill(m_OutputA.begin(), m_OutputA.end(), 0.0);
+    std::fill(m_OutputB.begin(), m_OutputB.end(), 0.0);
+    m_HistoryPos = 0;
+    m_BlockPos = 0;
+    m_OutputValid = false;
+}
+
+//------------------------------------------------------------------------
+void PartitionedConvolver::beginImpulseResponse(int length)
+{
+    m_NumPartitions = std::min((std::max(length, kBlockSize + 1) - 1) / kBlockSize, m_MaxPartitions);
+    m_LoadedPartitions = 0;
+    m_OutputEnabled = false;
+    m_OutputValid = false;
+}
+
+//------------------------------------------------------------------------
+bool PartitionedConvolver::loadPartitions(const double* responseA, const double* responseB, int maxPartitions)
+{
+    const int fftSize = 2 * kBlockSize;
+    const int end = std::min(m_LoadedPartitions + maxPartitions, m_NumPartitions);
+    for (int p = m_LoadedPartitions; p < end; p++)
+    {
+        // Partition p holds samples (p + 1) * kBlockSize onwards, zero padded to the FFT size
+        std::complex<double>* spectrum = &m_Spectra[static_cast<size_t>(p) * fftSize];
+        const int offset = (p + 1) * kBlockSize;
+        for (int n = 0; n < kBlockSize; n++)
+            spectrum[n] = std::complex<double>(responseA[offset + n], responseB[offset + n]);
+        std::fill(spectrum + kBlockSize, spectrum + fftSize, 0.0);
+        m_Fft.forward(spectrum);
+    }
+    m_LoadedPartitions = end;
+    return m_LoadedPartitions == m_NumPartitions;
+}
+
+//------------------------------------------------------------------------
+void PartitionedConvolver::setOutputEnabled(bool enabled)
+{
+    m_OutputEnabled = enabled && m_LoadedPartitions == m_NumPartitions && m_NumPartitions > 0;
+    if (!m_OutputEnabled)
+        m_OutputValid = false;
+}
+
+//------------------------------------------------------------------------
+void PartitionedConvolver::process(const double* input, int numFrames, double* outputA, double* outputB)
+{
+    int done = 0;
+    while (done < numFrames)
+    {
+        const int length = std::min(numFrames - done, kBlockSize - m_BlockPos);
+        for (int n = 0; n < length; n++)
+        {
+            const int frame = (done + n) * m_NumChannels;
+            for (int c = 0; c < m_NumChannels; c++)
+            {
+                // The current block sits in the second half of the channel's input window
+                m_Input[c * 2 * kBlockSize + kBlockSize + m_BlockPos + n] = input[frame + c];
+                outputA[frame + c] = m_OutputA[c * kBlockSize + m_BlockPos + n];
+                outputB[frame + c] = m_OutputB[c * kBlockSize + m_BlockPos + n];
+            }
+        }
+
+        done += length;
+        m_BlockPos += length;
+        if (m_BlockPos == kBlockSize)
+        {
+            processBlock();
+            m_BlockPos = 0;
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+void PartitionedConvolver::processBlock()
+{
+    const int fftSize = 2 * kBlockSize;
+    const size_t historySize = static_cast<size_t>(m_MaxPartitions) * fftSize;
+    m_HistoryPos = m_HistoryPos + 1 < m_MaxPartitions ? m_HistoryPos + 1 : 0;
+
+    for (int c = 0; c < m_NumChannels; c++)
+    {
+        double* window = &m_Input[static_cast<size_t>(c) * fftSize];
+        std::complex<double>* history = &m_History[c * historySize];
+
+        // Spectrum of the last two input blocks goes into the history
+        std::complex<double>* newest = history + static_cast<size_t>(m_HistoryPos) * fftSize;
+        for (int n = 0; n < fftSize; n++)
+            newest[n] = window[n];
+        m_Fft.forward(newest);
+
+        // The current block becomes the previous one
+        std::copy(window + kBlockSize, window + fftSize, window);
+
+        if (!m_OutputEnabled)
+            continue;
+
+        // Partition p meets the input from p blocks ago. Accumulated into split real and imaginary
+        // parts so the compiler can vectorise it; std::complex multiplication would also check for
+        // infinities on every product.
+        std::fill(m_AccumulateReal.begin(), m_AccumulateReal.end(), 0.0);
+        std::fill(m_AccumulateImag.begin(), m_AccumulateImag.end(), 0.0);
+        double* accumulateReal = m_AccumulateReal.data();
+        double* accumulateImag = m_AccumulateImag.data();
+        int slot = m_HistoryPos;
+        for (int p = 0; p < m_NumPartitions; p++)
+        {
+            // std::complex<double> is laid out as two doubles
+            const double* x = reinterpret_cast<const double*>(history + static_cast<size_t>(slot) * fftSize);
+            const double* h = reinterpret_cast<const double*>(&m_Spectra[static_cast<size_t>(p) * fftSize]);
+            for (int k = 0; k < fftSize; k++)
+            {
+                accumulateReal[k] += x[2 * k] * h[2 * k] - x[2 * k + 1] * h[2 * k + 1];
+                accumulateImag[k] += x[2 * k] * h[2 * k + 1] + x[2 * k + 1] * h[2 * k];
+            }
+            slot = slot > 0 ? slot - 1 : m_MaxPartitions - 1;
+        }
+        for (int k = 0; k < fftSize; k++)
+            m_Scratch[k] = std::complex<double>(accumulateReal[k], accumulateImag[k]);
+        m_Fft.inverse(m_Scratch.data());
+
+        // Overlap-save: the second half is valid. The real part is response A, the imaginary part B.
+        for (int n = 0; n < kBlockSize; n++)
+        {
+            m_OutputA[c * kBlockSize + n] = m_Scratch[kBlockSize + n].real();
+            m_OutputB[c * kBlockSize + n] = m_Scratch[kBlockSize + n].imag();
+        }
+    }
+
+    if (m_OutputEnabled)
+        m_OutputValid = true;
+}
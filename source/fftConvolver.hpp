@@ -0,0 +1,123 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Uniformly partitioned FFT convolution used for frozen tap patterns.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <complex>
+#include <cstddef>
+#include <vector>
+
+//------------------------------------------------------------------------
+//  Fft
+//------------------------------------------------------------------------
+// In-place iterative radix-2 complex FFT with precomputed twiddles.
+class Fft
+{
+public:
+    Fft() : m_Size(0) {}
+
+    /** Prepares for transforms of 'size' points, a power of two */
+    void setSize(int size);
+    int getSize() const { return m_Size; }
+
+    void forward(std::complex<double>* data) const { transform(data, false); }
+
+    /** Inverse transform, scaled by 1 / size */
+    void inverse(std::complex<double>* data) const;
+
+private:
+    void transform(std::complex<double>* data, bool inverse) const;
+
+    int m_Size;
+    std::vector<std::complex<double>> m_Twiddles;
+    std::vector<int> m_BitReverse;
+};
+
+//------------------------------------------------------------------------
+//  PartitionedConvolver
+//------------------------------------------------------------------------
+// Convolves every channel of an interleaved stream with a pair of impulse
+// responses by uniformly partitioned overlap-save convolution. The pair is
+// packed into one complex response (A + iB), so a single spectrum per
+// partition and a single inverse transform per block serve both.
+//
+// The responses have to be silent for their first kBlockSize samples. The
+// convolver skips that part, which lets it compute every output block one
+// block ahead from input that has already arrived: there is no latency and
+// samples can be fed in runs of any length.
+//
+// Cost per sample is a fixed number of complex multiply-adds per partition,
+// whatever the responses contain, plus one forward and one inverse FFT of
+// 2 * kBlockSize points per block.
+class PartitionedConvolver
+{
+public:
+    static const int kBlockSize = 128;
+
+    PartitionedConvolver();
+
+    /** Allocates for responses of up to 'maxLength' samples and 'numChannels' channels.
+        A length of 0 releases the memory. */
+    void setSize(int maxLength, int numChannels);
+    int getMaxLength() const { return (m_MaxPartitions + 1) * kBlockSize; }
+    int getNumChannels() const { return m_NumChannels; }
+
+    /** Bytes held for the spectra, the history and the blocks */
+    std::size_t getFootprint() const;
+
+    /** Clears the input history and the pending output */
+    void reset();
+
+    /** Starts replacing the responses with a pair of 'length' samples; the output stays off until
+        every partition is loaded and setOutputEnabled is called */
+    void beginImpulseResponse(int length);
+
+    /** Transforms up to 'maxPartitions' more partitions of the pair, returns true once all are loaded */
+    bool loadPartitions(const double* responseA, const double* responseB, int maxPartitions);
+
+    /** Output blocks are only computed while enabled, the input history is kept either way */
+    void setOutputEnabled(bool enabled);
+
+    /** True once a full output block has been computed since the output was enabled */
+    bool hasOutput() const { return m_OutputValid; }
+
+    /** Feeds 'numFrames' interleaved input frames and writes the matching output frames of both
+        responses. The outputs are only meaningful while hasOutput() is true. */
+    void process(const double* input, int numFrames, double* outputA, double* outputB);
+
+private:
+    /** Transforms the block just completed, stores it in the history and computes the next output block */
+    void processBlock();
+
+    Fft m_Fft;
+    int m_NumChannels;
+    int m_MaxPartitions;
+
+    // Partitions of the current responses, and how many of them are loaded
+    int m_NumPartitions;
+    int m_LoadedPartitions;
+    bool m_OutputEnabled;
+    bool m_OutputValid;
+
+    // Spectra of the responses, one per partition of 2 * kBlockSize bins
+    std::vector<std::complex<double>> m_Spectra;
+
+    // Per channel: input spectra of the last m_MaxPartitions blocks, newest at m_HistoryPos
+    std::vector<std::complex<double>> m_History;
+    int m_HistoryPos;
+
+    // Per channel: the previous and the current input block, and the output block being played
+    std::vector<double> m_Input;
+    std::vector<double> m_OutputA;
+    std::vector<double> m_OutputB;
+
+    // Position inside the current block
+    int m_BlockPos;
+
+    // Sum over the partitions, and the block being transformed
+    std::vector<double> m_AccumulateReal;
+    std::vector<double> m_AccumulateImag;
+    std::vector<std::complex<double>> m_Scratch;
+};
@@ -0,0 +1,176 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Fractional delay interpolation modes and their coefficients.
+//------------------------------------------------------------------------
+
+#include "interpolation.hpp"
+#include <cmath>
+
+namespace {
+
+const int kLagrangePoints = 6;
+const int kSincPoints = 16;
+
+// Kaiser window shape of the sinc, about 90 dB of sidelobe rejection
+const double kSincBeta = 8.6;
+
+// Table rows, one per stored fraction, filled at static initialisation
+double sLagrangeTable[kTablePhases + 1][kLagrangePoints];
+double sSincTable[kTablePhases + 1][kSincPoints];
+
+//------------------------------------------------------------------------
+// Zeroth order modified Bessel function, for the Kaiser window
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > 1e-12 * sum; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+//------------------------------------------------------------------------
+// Window sample k of an N point window lies (N / 2 - k) samples behind 'whole'
+bool buildTables()
+{
+    const double pi = 3.14159265358979323846;
+    for (int p = 0; p <= kTablePhases; p++)
+    {
+        const double fraction = static_cast<double>(p) / kTablePhases;
+
+        for (int k = 0; k < kLagrangePoints; k++)
+        {
+            const double position = kLagrangePoints / 2 - k;
+            double weight = 1.0;
+            for (int j = 0; j < kLagrangePoints; j++)
+            {
+                if (j != k)
+                    weight *= (fraction - (kLagrangePoints / 2 - j)) / (position - (kLagrangePoints / 2 - j));
+            }
+            sLagrangeTable[p][k] = weight;
+        }
+
+        // Normalised to a sum of 1, so a constant signal passes unchanged at every fraction
+        double sum = 0.0;
+        for (int k = 0; k < kSincPoints; k++)
+        {
+            const double distance = (kSincPoints / 2 - k) - fraction;
+            const double sinc = distance == 0.0 ? 1.0 : std::sin(pi * distance) / (pi * distance);
+            const double edge = distance / (kSincPoints / 2);
+            const double window = std::fabs(edge) < 1.0
+                                ? besselI0(kSincBeta * std::sqrt(1.0 - edge * edge)) / besselI0(kSincBeta) : 0.0;
+            sSincTable[p][k] = sinc * window;
+            sum += sSincTable[p][k];
+        }
+        for (int k = 0; k < kSincPoints; k++)
+            sSincTable[p][k] /= sum;
+    }
+    return true;
+}
+
+const bool sTablesBuilt = buildTables();
+
+//------------------------------------------------------------------------
+// Blends the two table rows around 'fraction'
+template <int numPoints>
+inline void lookupCoefficients(const double (*table)[numPoints], double fraction, double* coefficients)
+{
+    const double position = fraction * kTablePhases;
+    const int index = static_cast<int>(position);
+    const double blend = position - index;
+    const double* low = table[index];
+    const double* high = table[index < kTablePhases ? index + 1 : index];
+    for (int k = 0; k < numPoints; k++)
+        coefficients[k] = low[k] + blend * (high[k] - low[k]);
+}
+
+//------------------------------------------------------------------------
+void getNoneCoefficients(double, double* coefficients)
+{
+    coefficients[0] = 1.0;
+}
+
+//------------------------------------------------------------------------
+void getLinearCoefficients(double fraction, double* coefficients)
+{
+    coefficients[0] = fraction;
+    coefficients[1] = 1.0 - fraction;
+}
+
+//------------------------------------------------------------------------
+// interpolateCubic in tapKernels.cpp written out per window sample
+void getCubicCoefficients(double fraction, double* coefficients)
+{
+    const double f2 = fraction * fraction;
+    const double f3 = f2 * fraction;
+    coefficients[0] = f3 - f2;
+    coefficients[1] = -f3 + f2 + fraction;
+    coefficients[2] = f3 - 2.0 * f2 + 1.0;
+    coefficients[3] = -f3 + 2.0 * f2 - fraction;
+}
+
+//------------------------------------------------------------------------
+void getHermiteCoefficients(double fraction, double* coefficients)
+{
+    const double f2 = fraction * fraction;
+    const double f3 = f2 * fraction;
+    coefficients[0] = 0.5 * (f3 - f2);
+    coefficients[1] = 0.5 * fraction + 2.0 * f2 - 1.5 * f3;
+    coefficients[2] = 1.0 - 2.5 * f2 + 1.5 * f3;
+    coefficients[3] = -0.5 * fraction + f2 - 0.5 * f3;
+}
+
+//------------------------------------------------------------------------
+void getLagrangeCoefficients(double fraction, double* coefficients)
+{
+    lookupCoefficients<kLagrangePoints>(sLagrangeTable, fraction, coefficients);
+}
+
+//------------------------------------------------------------------------
+void getSincCoefficients(double fraction, double* coefficients)
+{
+    lookupCoefficients<kSincPoints>(sSincTable, fraction, coefficients);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int getInterpolationPoints(InterpolationMode mode)
+{
+    switch (mode)
+    {
+        case InterpolationMode::kNone:
+            return 1;
+        case InterpolationMode::kLinear:
+            return 2;
+        case InterpolationMode::kLagrange6:
+            return kLagrangePoints;
+        case InterpolationMode::kSinc:
+            return kSincPoints;
+        default:
+            return 4;
+    }
+}
+
+//------------------------------------------------------------------------
+CoefficientFunction getCoefficientFunction(InterpolationMode mode)
+{
+    switch (mode)
+    {
+        case InterpolationMode::kNone:
+            return getNoneCoefficients;
+        case InterpolationMode::kLinear:
+            return getLinearCoefficients;
+        case InterpolationMode::kHermite:
+            return getHermiteCoefficients;
+        case InterpolationMode::kLagrange6:
+            return getLagrangeCoefficients;
+        case InterpolationMode::kSinc:
+            return getSincCoefficients;
+        default:
+            return getCubicCoefficients;
+    }
+}
@@ -0,0 +1,47 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Fractional delay interpolation modes and their coefficients.
+//------------------------------------------------------------------------
+
+#pragma once
+
+//------------------------------------------------------------------------
+//  Interpolation modes
+//------------------------------------------------------------------------
+// Every mode reads a window of N neighbouring samples and weighs them
+// with coefficients that depend only on the fractional part of the delay.
+// The window of a delay of (whole + fraction) samples starts N / 2 samples
+// further back than 'whole' and coefficient k weighs its k-th sample,
+// oldest first. For the cubic mode that is the window the tap kernels read.
+//
+// Cheap modes work their coefficients out directly. The 6 point Lagrange
+// and the windowed sinc read them from tables of kTablePhases + 1
+// fractions, interpolating linearly between the two nearest, so a change
+// of fraction costs the same for every mode of the same width.
+
+// In the order of the Interpolation parameter's list
+enum class InterpolationMode
+{
+    kNone,       // 1 point, the delay rounded to whole samples
+    kLinear,     // 2 points
+    kCubic,      // 4 points, CircularBuffer::performInterpolation's polynomial
+    kHermite,    // 4 points, Catmull-Rom spline
+    kLagrange6,  // 6 points, 5th order Lagrange polynomial
+    kSinc,       // 16 points, Kaiser windowed sinc
+    kNumModes
+};
+
+// Widest window of any mode
+static const int kMaxInterpolationPoints = 16;
+
+// Fractions the table modes are stored for, between 0 and 1
+static const int kTablePhases = 512;
+
+// Writes the coefficients of every window sample for a fraction from 0 to 1
+typedef void (*CoefficientFunction)(double fraction, double* coefficients);
+
+/** Samples in the window of a mode */
+int getInterpolationPoints(InterpolationMode mode);
+
+/** Coefficient function of a mode */
+CoefficientFunction getCoefficientFunction(InterpolationMode mode);
@@ -0,0 +1,114 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Interleaved (frame-major) delay memory for all channels of a bus.
+//------------------------------------------------------------------------
+
+#include "multiChannelBuffer.hpp"
+#include <algorithm>
+#include <cstring>
+
+//------------------------------------------------------------------------
+MultiChannelBuffer::MultiChannelBuffer()
+{
+    m_NumChannels = 0;
+    m_Size = 0;
+    m_Mask = 0;
+    m_WritePos = 0;
+    m_HighWater = 0;
+}
+
+//------------------------------------------------------------------------
+void MultiChannelBuffer::setSize(int capacity, int numChannels)
+{
+    if (capacity <= 0 || numChannels <= 0)
+    {
+        // Give the memory back rather than keeping an empty vector's capacity around
+        std::vector<double>().swap(m_Buffer);
+        m_NumChannels = 0;
+        m_Size = 0;
+        m_Mask = 0;
+        m_WritePos = 0;
+        m_HighWater = 0;
+        return;
+    }
+
+    // Round up to the next power of two so the position can wrap with a mask,
+    // and to at least the frames the guard mirrors
+    numChannels = std::min(numChannels, kMaxChannels);
+    int size = 1;
+    while (size < capacity || size <= kGuardFrames)
+        size <<= 1;
+
+    // Same layout as before: keep the memory and only wipe what was used
+    if (size == m_Size && numChannels == m_NumChannels)
+    {
+        clear();
+        return;
+    }
+
+    m_NumChannels = numChannels;
+    m_Size = size;
+    m_Mask = m_Size - 1;
+    m_Buffer.assign(static_cast<size_t>(m_Size + kGuardFrames) * m_NumChannels, 0.0);
+    m_WritePos = 0;
+    m_HighWater = 0;
+}
+
+//------------------------------------------------------------------------
+void MultiChannelBuffer::clear()
+{
+    // Frames past the high-water mark have never been written, and the guard
+    // only holds copies of the first frames
+    if (m_HighWater > 0)
+    {
+        std::memset(&m_Buffer[0], 0, static_cast<size_t>(m_HighWater) * m_NumChannels * sizeof(double));
+        std::memset(&m_Buffer[static_cast<size_t>(m_Size) * m_NumChannels], 0,
+                    kGuardFrames * m_NumChannels * sizeof(double));
+    }
+    m_WritePos = 0;
+    m_HighWater = 0;
+}
+
+//------------------------------------------------------------------------
+void MultiChannelBuffer::swap(MultiChannelBuffer& other)
+{
+    m_Buffer.swap(other.m_Buffer);
+    std::swap(m_NumChannels, other.m_NumChannels);
+    std::swap(m_Size, other.m_Size);
+    std::swap(m_Mask, other.m_Mask);
+    std::swap(m_WritePos, other.m_WritePos);
+    std::swap(m_HighWater, other.m_HighWater);
+}
+
+//------------------------------------------------------------------------
+int MultiChannelBuffer::getReadSpans(int delay, int length, ReadSpan spans[2]) const
+{
+    int start = (m_WritePos - delay) & m_Mask;
+    int firstLength = std::min(length, m_Size - start);
+    spans[0] = { &m_Buffer[static_cast<size_t>(start) * m_NumChannels], firstLength };
+    if (firstLength == length)
+        return 1;
+
+    spans[1] = { &m_Buffer[0], length - firstLength };
+    return 2;
+}
+
+//------------------------------------------------------------------------
+void MultiChannelBuffer::writeSpan(const double* frames, int length)
+{
+    // First span runs up to the end of the buffer, the second one restarts at 0
+    int firstLength = std::min(length, m_Size - m_WritePos);
+    std::memcpy(&m_Buffer[static_cast<size_t>(m_WritePos) * m_NumChannels], frames,
+                static_cast<size_t>(firstLength) * m_NumChannels * sizeof(double));
+    if (firstLength < length)
+        std::memcpy(&m_Buffer[0], frames + static_cast<size_t>(firstLength) * m_NumChannels,
+                    static_cast<size_t>(length - firstLength) * m_NumChannels * sizeof(double));
+
+    // Refresh the guard if the start of the buffer was touched
+    if (m_WritePos < kGuardFrames || firstLength < length)
+        std::memcpy(&m_Buffer[static_cast<size_t>(m_Size) * m_NumChannels], &m_Buffer[0],
+                    kGuardFrames * m_NumChannels * sizeof(double));
+
+    m_WritePos = (m_WritePos + length) & m_Mask;
+    m_HighWater = std::min(m_HighWater + length, m_Size);
+}
@@ -0,0 +1,87 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Interleaved (frame-major) delay memory for all channels of a bus.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+//------------------------------------------------------------------------
+//  MultiChannelBuffer
+//------------------------------------------------------------------------
+// Same idea as CircularBuffer in kPowerOfTwo mode, but every slot is a
+// frame holding one sample per channel side by side. A tap read for all
+// channels of a frame therefore touches one cache line instead of one per
+// channel, and the channels can be processed together in SIMD lanes.
+//
+// All channels share one allocation, made by setSize and kept until the
+// size changes. clear() only zeroes the frames written since the last
+// clear, so resetting a buffer that barely ran is cheap.
+class MultiChannelBuffer
+{
+public:
+    static const int kMaxChannels = 8;
+
+    // Frames mirrored after the end, so the widest interpolation window (16 frames) is contiguous
+    static const int kGuardFrames = 15;
+
+    // A run of consecutive interpolation windows inside the buffer, length in frames
+    struct ReadSpan
+    {
+        const double* data;
+        int length;
+    };
+
+    MultiChannelBuffer();
+
+    /** Allocates room for at least 'capacity' frames of 'numChannels' samples, zeroed.
+        The existing memory is only cleared if the size does not change.
+        A capacity of 0 releases the memory. */
+    void setSize(int capacity, int numChannels);
+
+    /** Zeroes the contents and restarts writing at frame 0, without allocating */
+    void clear();
+
+    /** Exchanges contents with another buffer without allocating, so memory prepared on
+        another thread can be handed to the audio thread */
+    void swap(MultiChannelBuffer& other);
+
+    /** Returns 'length' window start frames, beginning 'delay' frames behind the write
+        position, as at most two spans. Each frame can be read up to kGuardFrames past its span. */
+    int getReadSpans(int delay, int length, ReadSpan spans[2]) const;
+
+    /** Appends 'length' interleaved frames in at most two contiguous spans */
+    void writeSpan(const double* frames, int length);
+
+    /** Ring memory for reads that move every frame: frame f starts at getFrames() + f * numChannels,
+        and frames 0 to kGuardFrames - 1 are repeated after the last one */
+    const double* getFrames() const { return m_Buffer.data(); }
+
+    /** Frame the next writeSpan starts at */
+    int getWritePosition() const { return m_WritePos; }
+
+    int getCapacity() const { return m_Size; }
+    int getNumChannels() const { return m_NumChannels; }
+
+    /** Bytes of delay memory held, including the guard */
+    std::size_t getFootprint() const { return m_Buffer.capacity() * sizeof(double); }
+
+private:
+    // Frames of m_NumChannels samples, followed by the guard frames
+    std::vector<double> m_Buffer;
+
+    int m_NumChannels;
+
+    // Number of frames before the guard, always a power of two
+    int m_Size;
+    int m_Mask;
+
+    // Next frame to be written
+    int m_WritePos;
+
+    // Frames written since the last clear, capped at m_Size. Writing starts at
+    // frame 0, so everything from here on is still zero.
+    int m_HighWater;
+};
@@ -0,0 +1,60 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Linear parameter smoother advanced at control rate.
+//------------------------------------------------------------------------
+
+#pragma once
+
+//------------------------------------------------------------------------
+//  ParameterSmoother
+//------------------------------------------------------------------------
+// Moves from the current value to a new target in a fixed number of
+// equal control steps. The engine calls next() once per control point
+// (every few dozen samples) and interpolates in between where needed.
+class ParameterSmoother
+{
+public:
+    ParameterSmoother() : m_Current(0.0), m_Target(0.0), m_Step(0.0), m_StepsLeft(0) {}
+
+    /** Jumps straight to 'value' */
+    void reset(double value)
+    {
+        m_Current = m_Target = value;
+        m_Step = 0.0;
+        m_StepsLeft = 0;
+    }
+
+    /** Starts a ramp from the current value that reaches 'target' after 'numSteps' calls to next() */
+    void setTarget(double target, int numSteps)
+    {
+        if (numSteps <= 0)
+        {
+            reset(target);
+            return;
+        }
+        m_Target = target;
+        m_Step = (target - m_Current) / numSteps;
+        m_StepsLeft = numSteps;
+    }
+
+    /** Advances one control step and returns the new value */
+    double next()
+    {
+        if (m_StepsLeft > 0)
+        {
+            // Land exactly on the target with the last step
+            m_Current = --m_StepsLeft > 0 ? m_Current + m_Step : m_Target;
+        }
+        return m_Current;
+    }
+
+    double getCurrent() const { return m_Current; }
+    double getTarget() const { return m_Target; }
+    bool isSettled() const { return m_StepsLeft == 0; }
+
+private:
+    double m_Current;
+    double m_Target;
+    double m_Step;
+    int m_StepsLeft;
+};
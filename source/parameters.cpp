@@ -0,0 +1,122 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Parameter IDs and the descriptor table shared by processor and controller.
+//------------------------------------------------------------------------
+
+#include "parameters.hpp"
+
+namespace {
+
+constexpr ParamDescriptor kMainDescriptors[kNumMainParams] =
+{
+    // id                        title                   units   default steps dirtyMask
+    { kParamGainId_Master,       u"Master Gain",         u"dB",  0.5,    0,    kDirtyMix },
+    { kParamDryMixId,            u"Dry Mix",             u"%",   0.5,    0,    0 },
+    { kParamWetMixId,            u"Wet Mix",             u"%",   0.5,    0,    kDirtyMix },
+
+    // The tap 1 time scales the other taps, so it dirties all of them
+    { kParamDelayLengthId_Tap1,  u"Delay Time Tap 1",    u"sec", 0.5,    0,    kDirtyAllTaps },
+    { kParamDelayGainId_Tap1,    u"Delay Gain Tap 1",    u"dB",  0.5,    0,    kDirtyTap1 },
+    { kParamFeedbackId_Tap1,     u"Feedback Gain Tap 1", u"dB",  0.0,    0,    kDirtyTap1 },
+
+    { kParamDelayLengthId_Tap2,  u"Delay Time Tap 2",    u"sec", 0.0,    0,    kDirtyTap2 },
+    { kParamDelayGainId_Tap2,    u"Delay Gain Tap 2",    u"dB",  0.0,    0,    kDirtyTap2 },
+    { kParamFeedbackId_Tap2,     u"Feedback Gain Tap 2", u"dB",  0.0,    0,    kDirtyTap2 },
+
+    { kParamDelayLengthId_Tap3,  u"Delay Time Tap 3",    u"sec", 0.0,    0,    kDirtyTap3 },
+    { kParamDelayGainId_Tap3,    u"Delay Gain Tap 3",    u"dB",  0.0,    0,    kDirtyTap3 },
+    { kParamFeedbackId_Tap3,     u"Feedback Gain Tap 3", u"dB",  0.0,    0,    kDirtyTap3 },
+
+    { kParamDelayLengthId_Tap4,  u"Delay Time Tap 4",    u"sec", 0.0,    0,    kDirtyTap4 },
+    { kParamDelayGainId_Tap4,    u"Delay Gain Tap 4",    u"dB",  0.0,    0,    kDirtyTap4 },
+    { kParamFeedbackId_Tap4,     u"Feedback Gain Tap 4", u"dB",  0.0,    0,    kDirtyTap4 },
+
+    // Both act through the tap 1 time, which the engine retargets when they change
+    { kParamTempoSyncId,         u"Tempo Sync",          u"",    0.0,    1,    0 },
+    { kParamNoteValueId,         u"Note Value",          u"",    10.0 / (kNumNoteValues - 1), kNumNoteValues - 1, 0 },
+
+    // The depth changes how far the taps are kept from the ends of the buffer
+    { kParamModRateId,           u"Mod Rate",            u"Hz",  0.4,    0,    kDirtyModulation },
+    { kParamModDepthId,          u"Mod Depth",           u"ms",  0.0,    0,    kDirtyAllTaps },
+    { kParamModShapeId,          u"Mod Shape",           u"",    0.0,    kNumModShapes - 1, kDirtyModulation },
+
+    // The window width sets how close to the write position the taps may read
+    { kParamInterpolationId,     u"Interpolation",       u"",    2.0 / (kNumInterpolationModes - 1), kNumInterpolationModes - 1, kDirtyAllTaps },
+
+    // Four taps, as before there was a choice
+    { kParamNumTapsId,           u"Tap Count",           u"",    3.0 / (kNumExtraTaps + 3), kNumExtraTaps + 3, kDirtyAllTaps },
+
+    // The coefficient itself, 0.5 being the original fixed value
+    { kParamAllpassId,           u"Allpass",             u"",    0.5,    0,    kDirtyAllpass },
+};
+
+// Titles of the extra taps' parameters, "Delay Time Tap 5" to "Feedback Gain Tap 64"
+struct ExtraTapTitles
+{
+    static const int kMaxLength = 24;
+    char16_t text[kNumExtraTaps * kParamsPerTap][kMaxLength];
+};
+
+constexpr ExtraTapTitles makeExtraTapTitles()
+{
+    const char* const prefixes[kParamsPerTap] = { "Delay Time Tap ", "Delay Gain Tap ", "Feedback Gain Tap " };
+    ExtraTapTitles titles {};
+    for (int i = 0; i < kNumExtraTaps * kParamsPerTap; i++)
+    {
+        char16_t* title = titles.text[i];
+        int length = 0;
+        for (const char* c = prefixes[i % kParamsPerTap]; *c != 0; c++)
+            title[length++] = static_cast<char16_t>(*c);
+        const int tapNumber = 5 + i / kParamsPerTap;
+        if (tapNumber >= 10)
+            title[length++] = static_cast<char16_t>(u'0' + tapNumber / 10);
+        title[length++] = static_cast<char16_t>(u'0' + tapNumber % 10);
+    }
+    return titles;
+}
+
+constexpr ExtraTapTitles kExtraTapTitles = makeExtraTapTitles();
+
+// The main table followed by the extra taps, silent like taps 2 to 4 until they are set.
+// Their times are fractions of tap 1 as well, so a tap 1 change reaches them through kDirtyAllTaps.
+struct DescriptorTable
+{
+    ParamDescriptor entries[kNumParams];
+};
+
+constexpr DescriptorTable makeDescriptorTable()
+{
+    const char16_t* const units[kParamsPerTap] = { u"sec", u"dB", u"dB" };
+    DescriptorTable table {};
+    for (int i = 0; i < kNumMainParams; i++)
+        table.entries[i] = kMainDescriptors[i];
+    for (int i = 0; i < kNumExtraTaps * kParamsPerTap; i++)
+    {
+        table.entries[kNumMainParams + i] = { kParamExtraTapFirstId + i, kExtraTapTitles.text[i],
+                                              units[i % kParamsPerTap], 0.0, 0, kDirtyExtraTaps };
+    }
+    return table;
+}
+
+} // namespace
+
+constexpr DescriptorTable kDescriptorTable = makeDescriptorTable();
+const ParamDescriptor (&kParamDescriptors)[kNumParams] = kDescriptorTable.entries;
+
+const char16_t* const kModShapeNames[kNumModShapes] = { u"Sine", u"Triangle" };
+
+const char16_t* const kInterpolationNames[kNumInterpolationModes] =
+{
+    u"None", u"Linear", u"Cubic", u"Hermite", u"Lagrange 6", u"Sinc 16",
+};
+
+const NoteValue kNoteValues[kNumNoteValues] =
+{
+    { u"1/32 T", 1.0 / 48.0 }, { u"1/32", 1.0 / 32.0 }, { u"1/32 D", 3.0 / 64.0 },
+    { u"1/16 T", 1.0 / 24.0 }, { u"1/16", 1.0 / 16.0 }, { u"1/16 D", 3.0 / 32.0 },
+    { u"1/8 T",  1.0 / 12.0 }, { u"1/8",  1.0 / 8.0 },  { u"1/8 D",  3.0 / 16.0 },
+    { u"1/4 T",  1.0 / 6.0 },  { u"1/4",  1.0 / 4.0 },  { u"1/4 D",  3.0 / 8.0 },
+    { u"1/2 T",  1.0 / 3.0 },  { u"1/2",  1.0 / 2.0 },  { u"1/2 D",  3.0 / 4.0 },
+    { u"1/1 T",  2.0 / 3.0 },  { u"1/1",  1.0 },        { u"1/1 D",  3.0 / 2.0 },
+    { u"1 Bar",  0.0 },
+};
@@ -0,0 +1,148 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Parameter IDs and the descriptor table shared by processor and controller.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+
+// Kept free of SDK types (ParamID is a uint32) so the DSP core can use it on its own
+enum AudioParams : uint32_t
+{
+    kParamGainId_Master = 102, // should be a unique id
+    kParamDryMixId = 103,
+    kParamWetMixId = 104,
+    
+    // The three parameters of a tap always follow each other: delay, gain, feedback
+    kParamDelayLengthId_Tap1 = 105,
+    kParamDelayGainId_Tap1 = 106,
+    kParamFeedbackId_Tap1 = 107,
+    
+    kParamDelayLengthId_Tap2 = 108,
+    kParamDelayGainId_Tap2 = 109,
+    kParamFeedbackId_Tap2 = 110,
+    
+    kParamDelayLengthId_Tap3 = 111,
+    kParamDelayGainId_Tap3 = 112,
+    kParamFeedbackId_Tap3 = 113,
+    
+    kParamDelayLengthId_Tap4 = 114,
+    kParamDelayGainId_Tap4 = 115,
+    kParamFeedbackId_Tap4 = 116,
+
+    // Tempo sync replaces the tap 1 time with a note value at the host tempo
+    kParamTempoSyncId = 117,
+    kParamNoteValueId = 118,
+
+    // Tap time modulation, one LFO per tap with the phases spread over the taps
+    kParamModRateId = 119,
+    kParamModDepthId = 120,
+    kParamModShapeId = 121,
+
+    // Fractional delay interpolation, traded against CPU per instance
+    kParamInterpolationId = 122,
+
+    // Number of taps in use, 1 to 4 + kNumExtraTaps
+    kParamNumTapsId = 123,
+
+    // Coefficient of the allpass filter on the wet output
+    kParamAllpassId = 124,
+
+    // The max delay range is a processor option rather than an engine parameter, so it stays
+    // out of the dense table below. The controller shows it, the processor applies it.
+    kParamMaxDelayId = 200,
+
+    // Switch for the FFT convolution mode, a processor option like the max delay range
+    kParamConvolutionId = 201,
+
+    // Taps 5 and up, three IDs per tap in the same order as taps 1 to 4: delay, gain, feedback
+    kParamExtraTapFirstId = 300,
+    
+};
+
+static const int kParamsPerTap = 3;
+
+// Taps past the four above, which have a range of IDs of their own
+static const int kNumExtraTaps = 60;
+
+// The IDs run in two contiguous ranges, the main parameters and the extra taps, so the
+// parameter state is a dense array indexed by ID offset, the extra taps following the others
+static const uint32_t kParamFirstId = kParamGainId_Master;
+static const int kNumMainParams = kParamAllpassId - kParamFirstId + 1;
+static const int kNumParams = kNumMainParams + kNumExtraTaps * kParamsPerTap;
+
+// Bits of ParamDescriptor::dirtyMask: one per parameter tap, one for the engine's taps
+// past those (their times follow tap 1), one for the mix and master gain, one for
+// the LFO rate and shape and one for the allpass coefficient
+static const uint32_t kDirtyTap1 = 1u << 0;
+static const uint32_t kDirtyTap2 = 1u << 1;
+static const uint32_t kDirtyTap3 = 1u << 2;
+static const uint32_t kDirtyTap4 = 1u << 3;
+static const uint32_t kDirtyExtraTaps = 1u << 4;
+static const uint32_t kDirtyAllTaps = kDirtyTap1 | kDirtyTap2 | kDirtyTap3 | kDirtyTap4 | kDirtyExtraTaps;
+static const uint32_t kDirtyMix = 1u << 5;
+static const uint32_t kDirtyModulation = 1u << 6;
+static const uint32_t kDirtyAllpass = 1u << 7;
+
+struct ParamDescriptor
+{
+    uint32_t id;
+    const char16_t* title;
+    const char16_t* units;
+    double defaultValue;
+    int32_t stepCount;   // 0 for a continuous parameter, otherwise the number of steps between the values
+    uint32_t dirtyMask;  // cooked values that have to be rebuilt when the parameter changes
+};
+
+// One entry per parameter, in ID order. The extra taps' entries are generated at compile time.
+extern const ParamDescriptor (&kParamDescriptors)[kNumParams];
+
+// Entry a normalised list parameter selects, rounded the way hosts step through lists
+inline int getListIndex(double normalized, int numEntries)
+{
+    const int index = static_cast<int>(normalized * numEntries);
+    return index < 0 ? 0 : (index >= numEntries ? numEntries - 1 : index);
+}
+
+// Tempo synced tap 1 times, shortest first, in whole notes. A length of 0 stands for one bar
+// of the host's time signature.
+struct NoteValue
+{
+    const char16_t* name;
+    double wholeNotes;
+};
+
+static const int kNumNoteValues = 19;
+extern const NoteValue kNoteValues[kNumNoteValues];
+
+// List entry a normalised note value parameter selects
+inline int getNoteValueIndex(double normalized)
+{
+    return getListIndex(normalized, kNumNoteValues);
+}
+
+// LFO shapes of the modulation, in WavetableLfo::Shape order
+static const int kNumModShapes = 2;
+extern const char16_t* const kModShapeNames[kNumModShapes];
+
+// Interpolation modes, in InterpolationMode order
+static const int kNumInterpolationModes = 6;
+extern const char16_t* const kInterpolationNames[kNumInterpolationModes];
+
+// Dense index of a parameter ID, or -1 if the ID is not one of ours
+inline int getParamIndex(uint32_t id)
+{
+    if (id >= kParamFirstId && id < kParamFirstId + kNumMainParams)
+        return static_cast<int>(id - kParamFirstId);
+    if (id >= kParamExtraTapFirstId && id < kParamExtraTapFirstId + kNumExtraTaps * kParamsPerTap)
+        return kNumMainParams + static_cast<int>(id - kParamExtraTapFirstId);
+    return -1;
+}
+
+// Dense index of the delay parameter of tap 'tap' (0 based), followed by its gain and feedback
+inline int getTapParamIndex(int tap)
+{
+    return tap < 4 ? getParamIndex(kParamDelayLengthId_Tap1) + tap * kParamsPerTap
+                   : kNumMainParams + (tap - 4) * kParamsPerTap;
+}
@@ -0,0 +1,84 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Binary state format shared by processor and controller.
+//------------------------------------------------------------------------
+
+#include "pluginState.h"
+#include "delayEngine.hpp"
+#include <algorithm>
+#include <cmath>
+
+using namespace Steinberg;
+
+namespace delayEffectProcessor {
+
+//------------------------------------------------------------------------
+PluginState::PluginState ()
+{
+    for (int i = 0; i < kNumParams; i++)
+        values[i] = kParamDescriptors[i].defaultValue;
+    maxDelaySeconds = DelayEngine::kDefaultMaxDelay;
+    convolutionEnabled = false;
+    rateReduction = 1;
+}
+
+//------------------------------------------------------------------------
+bool PluginState::read (IBStreamer& streamer)
+{
+    // Nothing saved yet
+    int32 magic;
+    if (streamer.readInt32 (magic) == false)
+        return true;
+    if (magic != kMagic)
+        return false;
+
+    int32 version, numValues;
+    if (streamer.readInt32 (version) == false || version != kVersion)
+        return false;
+    if (streamer.readInt32 (numValues) == false || numValues < 0)
+        return false;
+    for (int32 i = 0; i < numValues; i++)
+    {
+        uint32 id;
+        double value;
+        if (streamer.readInt32u (id) == false || streamer.readDouble (value) == false)
+            return false;
+        // A value that is not a number cannot come from write, so the blob is corrupt
+        if (!std::isfinite (value))
+            return false;
+        int index = getParamIndex (id);
+        if (index >= 0)
+            values[index] = std::min (std::max (value, 0.0), 1.0);
+    }
+
+    int8 convolution;
+    if (streamer.readDouble (maxDelaySeconds) == false
+        || streamer.readInt8 (convolution) == false
+        || streamer.readInt32 (rateReduction) == false)
+        return false;
+    if (!std::isfinite (maxDelaySeconds) || (rateReduction != 1 && rateReduction != 2 && rateReduction != 4))
+        return false;
+    maxDelaySeconds = std::min (std::max (maxDelaySeconds, DelayEngine::kMinMaxDelay), DelayEngine::kMaxMaxDelay);
+    convolutionEnabled = convolution != 0;
+    return true;
+}
+
+//------------------------------------------------------------------------
+bool PluginState::write (IBStreamer& streamer) const
+{
+    if (streamer.writeInt32 (kMagic) == false
+        || streamer.writeInt32 (kVersion) == false
+        || streamer.writeInt32 (kNumParams) == false)
+        return false;
+    for (int i = 0; i < kNumParams; i++)
+    {
+        if (streamer.writeInt32u (kParamDescriptors[i].id) == false || streamer.writeDouble (values[i]) == false)
+            return false;
+    }
+    return streamer.writeDouble (maxDelaySeconds)
+        && streamer.writeInt8 (convolutionEnabled ? 1 : 0)
+        && streamer.writeInt32 (rateReduction);
+}
+
+//------------------------------------------------------------------------
+} // namespace delayEffectProcessor
@@ -0,0 +1,52 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Binary state format shared by processor and controller.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "base/source/fstreamer.h"
+#include "parameters.hpp"
+
+namespace delayEffectProcessor {
+
+//------------------------------------------------------------------------
+// Everything saved with a preset or project. Version 1, little endian:
+//
+//   int32   magic 'D2st'
+//   int32   version
+//   int32   parameter count, then per parameter: uint32 ID, double normalised value
+//   double  max delay range in seconds
+//   int8    convolution mode
+//   int32   rate reduction factor
+//
+// Parameters are stored with their IDs, so a state keeps loading when the
+// table grows: IDs the build does not know are skipped, and parameters the
+// state does not mention keep their defaults. Machine settings such as the
+// parallel threshold are not part of it.
+//------------------------------------------------------------------------
+struct PluginState
+{
+    static const Steinberg::int32 kMagic = 0x74733244;  // "D2st"
+    static const Steinberg::int32 kVersion = 1;
+
+    // Normalised values by dense index (see getParamIndex)
+    double values[kNumParams];
+    double maxDelaySeconds;
+    bool convolutionEnabled;
+    Steinberg::int32 rateReduction;
+
+    /** Every field at its default */
+    PluginState ();
+
+    /** Reads a kVersion state. An empty stream leaves the defaults and succeeds. A truncated
+        state, a value that is not finite or a rate reduction other than 1, 2 or 4 fails,
+        and the caller should then drop what was read. The max delay is clamped to its range. */
+    bool read (Steinberg::IBStreamer& streamer);
+
+    /** Writes the current version */
+    bool write (Steinberg::IBStreamer& streamer) const;
+};
+
+//------------------------------------------------------------------------
+} // namespace delayEffectProcessor
@@ -0,0 +1,199 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Polyphase decimation and interpolation around the reduced rate wet path.
+//------------------------------------------------------------------------
+
+#include "polyphaseResampler.hpp"
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+// Kaiser window shape, the balance between a flat passband and a deep stopband for this length
+const double kKaiserBeta = 6.0;
+
+const int kHalfTaps = HalfbandResampler::kHalfTaps;
+const int kDelay = HalfbandResampler::kDelay;
+
+
+//------------------------------------------------------------------------
+// Zeroth order modified Bessel function, for the Kaiser window
+double besselI0(double x)
+{
+    double sum = 1.0;
+    double term = 1.0;
+    for (int k = 1; k < 50 && term > 1e-12 * sum; k++)
+    {
+        term *= (x / (2.0 * k)) * (x / (2.0 * k));
+        sum += term;
+    }
+    return sum;
+}
+
+//------------------------------------------------------------------------
+// One decimating stage over 'numSamples' interleaved samples. 'centre' points at the frame the
+// first output is centred on, 'between' at the first of the frames around it, kHalfTaps before
+// and after. Every tap reads a contiguous run, so the loop vectorises across frames and channels.
+void decimate(const double* centre, const double* between, int numSamples, int numChannels, const double* taps,
+              double* y)
+{
+    for (int k = 0; k < numSamples; k++)
+    {
+        double sum = 0.5 * centre[k];
+        for (int i = 0; i < kHalfTaps; i++)
+            sum += taps[i] * (between[k + (kHalfTaps - 1 - i) * numChannels] + between[k + (kHalfTaps + i) * numChannels]);
+        y[k] = sum;
+    }
+}
+
+//------------------------------------------------------------------------
+// The filtered half of one interpolating stage over 'numSamples' interleaved samples. 'x' points
+// at the first new frame, with 2 * kHalfTaps - 1 frames of history before it. The gain of 2
+// makes up for the zeros in between.
+void interpolate(const double* x, int numSamples, int numChannels, const double* taps, double* y)
+{
+    for (int k = 0; k < numSamples; k++)
+    {
+        double sum = 0.0;
+        for (int i = 0; i < kHalfTaps; i++)
+            sum += taps[i] * (x[k - (kHalfTaps + i) * numChannels] + x[k - (kHalfTaps - 1 - i) * numChannels]);
+        y[k] = 2.0 * sum;
+    }
+}
+
+} // namespace
+
+double HalfbandResampler::sTaps[kHalfTaps];
+const bool HalfbandResampler::sTapsBuilt = HalfbandResampler::buildTaps();
+
+//------------------------------------------------------------------------
+bool HalfbandResampler::buildTaps()
+{
+    // sinc(d / 2) / 2 at the odd distances d, normalised so the whole filter has unity gain at DC
+    const double pi = 3.14159265358979323846;
+    double sum = 0.0;
+    for (int i = 0; i < kHalfTaps; i++)
+    {
+        const double distance = 2 * i + 1;
+        const double edge = distance / (kDelay + 1);
+        const double window = besselI0(kKaiserBeta * std::sqrt(1.0 - edge * edge)) / besselI0(kKaiserBeta);
+        sTaps[i] = std::sin(0.5 * pi * distance) / (pi * distance) * window;
+        sum += sTaps[i];
+    }
+    for (int i = 0; i < kHalfTaps; i++)
+        sTaps[i] *= 0.25 / sum;
+    return true;
+}
+
+//------------------------------------------------------------------------
+void HalfbandResampler::setFactor(int factor)
+{
+    m_NumStages = factor >= kMaxFactor ? 2 : (factor >= 2 ? 1 : 0);
+}
+
+//------------------------------------------------------------------------
+void PolyphaseDecimator::reset()
+{
+    for (int s = 0; s < kMaxStages; s++)
+    {
+        m_NextBranch[s] = 0;
+        for (int b = 0; b < 2; b++)
+        {
+            m_BranchLength[s][b] = kBranchHistory;
+            std::fill(m_Branches[s][b], m_Branches[s][b] + kBranchHistory * MultiChannelBuffer::kMaxChannels, 0.0);
+        }
+    }
+}
+
+//------------------------------------------------------------------------
+int PolyphaseDecimator::process(const double* input, int numChannels, int numFrames, double* output)
+{
+    if (m_NumStages == 0)
+    {
+        std::copy(input, input + numFrames * numChannels, output);
+        return numFrames;
+    }
+
+    const double* x = input;
+    int count = numFrames;
+    for (int s = 0; s < m_NumStages; s++)
+    {
+        // Deal the frames out to the two branches in turn, a channel at a time, which keeps the
+        // copies free of per frame bookkeeping
+        const int next = m_NextBranch[s];
+        for (int b = 0; b < 2; b++)
+        {
+            const int first = b ^ next;
+            const int numDealt = (count - first + 1) / 2;
+            double* branch = m_Branches[s][b] + m_BranchLength[s][b] * numChannels;
+            for (int c = 0; c < numChannels; c++)
+            {
+                const double* in = x + first * numChannels + c;
+                for (int n = 0; n < numDealt; n++)
+                    branch[n * numChannels + c] = in[2 * n * numChannels];
+            }
+            m_BranchLength[s][b] += numDealt;
+        }
+        m_NextBranch[s] = next ^ (count & 1);
+
+        // Output j is centred on frame kHalfTaps + j of the first branch and needs the frames
+        // up to 2 * kHalfTaps - 1 + j of the second, the last of which has just arrived
+        const int numOutputs = m_BranchLength[s][1] - kBranchHistory;
+        double* y = s == m_NumStages - 1 ? output : m_StageOutput;
+        decimate(m_Branches[s][0] + kHalfTaps * numChannels, m_Branches[s][1], numOutputs * numChannels, numChannels,
+                 sTaps, y);
+
+        // Move the frames later outputs still need to the front
+        for (int b = 0; b < 2; b++)
+        {
+            double* branch = m_Branches[s][b];
+            std::copy(branch + numOutputs * numChannels, branch + m_BranchLength[s][b] * numChannels, branch);
+            m_BranchLength[s][b] -= numOutputs;
+        }
+
+        x = y;
+        count = numOutputs;
+    }
+    return count;
+}
+
+//------------------------------------------------------------------------
+void PolyphaseInterpolator::reset()
+{
+    for (int s = 0; s < kMaxStages; s++)
+        std::fill(m_History[s], m_History[s] + kHistory * MultiChannelBuffer::kMaxChannels, 0.0);
+}
+
+//------------------------------------------------------------------------
+void PolyphaseInterpolator::process(const double* input, int numChannels, int numFrames, double* output)
+{
+    if (m_NumStages == 0)
+    {
+        std::copy(input, input + numFrames * numChannels, output);
+        return;
+    }
+
+    // Stage 0 takes the reduced rate, the last stage writes the host rate frames
+    std::copy(input, input + numFrames * numChannels, m_History[0] + kHistory * numChannels);
+    int count = numFrames;
+    for (int s = 0; s < m_NumStages; s++)
+    {
+        const double* x = m_History[s] + kHistory * numChannels;
+        double* y = s == m_NumStages - 1 ? output : m_History[s + 1] + kHistory * numChannels;
+        interpolate(x, count * numChannels, numChannels, sTaps, m_Filtered);
+
+        // The even outputs are the filtered branch, the odd ones the centre tap's plain delay,
+        // interleaved a channel at a time
+        const double* delayed = x - (kHalfTaps - 1) * numChannels;
+        for (int c = 0; c < numChannels; c++)
+        {
+            for (int m = 0; m < count; m++)
+            {
+                y[2 * m * numChannels + c] = m_Filtered[m * numChannels + c];
+                y[(2 * m + 1) * numChannels + c] = delayed[m * numChannels + c];
+            }
+        }
+        std::copy(m_History[s] + count * numChannels, m_History[s] + (count + kHistory) * numChannels, m_History[s]);
+        count *= 2;
+    }
+}
@@ -6,10 +6,13 @@
 
 #include "processor.h"
 #include "cids.h"
+#include "pluginState.h"
 
 #include "base/source/fstreamer.h"
+#include "pluginterfaces/vst/ivstmessage.h"
 #include "pluginterfaces/vst/ivstparameterchanges.h"
 #include "public.sdk/source/vst/vstaudioprocessoralgo.h"
+#include <cmath>
 
 using namespace Steinberg;
 
@@ -21,14 +24,31 @@ delay2Processor::delay2Processor ()
 {
     //--- set the wanted controller for our processor
     setControllerClass (kdelay2ControllerUID);
-    
-    // Set an initial value for the allpass filter coefficient
-    m_AllpassCoefficient = 0.5;
+
+    m_MaxDelaySeconds = DelayEngine::kDefaultMaxDelay;
+    m_Groups.emplace_back(new ChannelGroup);
+    m_NumGroups = 0;
+    m_ParallelThreshold = kDefaultParallelThreshold;
+    m_Active = false;
+    m_BufferChannels = 0;
+    m_BufferCapacity = 0;
+    m_PendingBuffer = nullptr;
+    m_RetiredBuffers = nullptr;
+    m_BufferFootprint = 0;
+    m_ConvolutionEnabled = false;
+    m_ConvolutionFootprint = 0;
+    m_RateReduction = 1;
+    m_PendingPreset = nullptr;
+    m_RetiredPresets = nullptr;
+    for (int i = 0; i < kNumParams; i++)
+        m_StateValues[i] = kParamDescriptors[i].defaultValue;
 }
 
 //------------------------------------------------------------------------
 delay2Processor::~delay2Processor ()
 {
+    releaseHandoffBuffers(true);
+    releasePresets(true);
 }
 
 //------------------------------------------------------------------------
@@ -45,8 +65,9 @@ tresult PLUGIN_API delay2Processor::initialize (FUnknown* context)
     }
     
     //--- create Audio IO ------
-    addAudioInput (STR16 ("Stereo In"), Steinberg::Vst::SpeakerArr::kStereo);
-    addAudioOutput (STR16 ("Stereo Out"), Steinberg::Vst::SpeakerArr::kStereo);
+    // Stereo until the host asks for another layout through setBusArrangements
+    addAudioInput (STR16 ("Audio In"), Steinberg::Vst::SpeakerArr::kStereo);
+    addAudioOutput (STR16 ("Audio Out"), Steinberg::Vst::SpeakerArr::kStereo);
     
     /* If you don't need an event bus, you can remove the next line */
     addEventInput (STR16 ("Event In"), 1);
@@ -59,6 +80,20 @@ tresult PLUGIN_API delay2Processor::terminate ()
 {
     // Here the Plug-in will be de-instantiated, last possibility to remove some memory!
     
+    // Release the helper threads and the delay memory of every group
+    m_Workers.stop();
+    releaseHandoffBuffers(true);
+    releasePresets(true);
+    m_Groups.resize(1);
+    m_Groups[0]->buffer.setSize(0, 0);
+    m_Groups[0]->engine.setConvolution(false, 0);
+    m_Groups[0]->numChannels = 0;
+    m_NumGroups = 0;
+    m_BufferChannels = 0;
+    m_BufferCapacity = 0;
+    m_BufferFootprint = 0;
+    m_ConvolutionFootprint = 0;
+
     //---do not forget to call parent ------
     return AudioEffect::terminate ();
 }
@@ -67,221 +102,261 @@ tresult PLUGIN_API delay2Processor::terminate ()
 tresult PLUGIN_API delay2Processor::setActive (TBool state)
 {
     //--- called when the Plug-in is enable/disable (On/Off) -----
-    Steinberg::Vst::SpeakerArrangement arr;
-    if (getBusArrangement(Steinberg::Vst::kOutput, 0, arr) != kResultTrue)
-        return kResultFalse;
-    
-    int numChannels = Steinberg::Vst::SpeakerArr::getChannelCount(arr);
-    double sampleRate = processSetup.sampleRate;
-    m_circularBufferSampleRate = sampleRate;
-    
-    // Function to initialize the CircularBuffer for each channel
-    auto initializeCircularBuffer = [sampleRate]()
-    {
-        return CircularBuffer(sampleRate * 2); // maximum delay time for each tap
-    };
-    
     if (state)
     {
-        // Create a new CircularBuffer for each channel and store it in m_dBuffer
-        m_dBuffer.clear();
-        for (int i = 0; i < numChannels; i++)
+        // A preset loaded since the last run is simply where this one starts
+        if (PresetSnapshot* preset = m_PendingPreset.exchange(nullptr))
         {
-            m_dBuffer.push_back(initializeCircularBuffer());
+            for (int i = 0; i < kNumParams; i++)
+                m_Groups[0]->engine.setParameter(i, preset->values[i]);
+            delete preset;
         }
+        releasePresets(false);
+
+        // Normally sized by setupProcessing already, in which case this only clears what was used
+        sizeDelayBuffer();
+        m_Active = true;
+
+        // Start from silence on the current values rather than gliding from wherever the last run stopped
+        for (int g = 0; g < m_NumGroups; g++)
+        {
+            m_Groups[g]->engine.snapParameters();
+            m_Groups[g]->engine.reset();
+        }
+
+        // One helper per group beyond the first, which runs on the audio thread itself
+        const bool parallel = m_BufferChannels > m_ParallelThreshold;
+        m_Workers.start(parallel ? m_NumGroups - 1 : 0);
     }
+
     else
     {
-        // Clear m_dBuffer when the plugin is disabled (Off)
-        m_dBuffer.clear();
+        m_Active = false;
+        m_Workers.stop();
     }
-    
+
+    // The delay memory is kept while the plugin is disabled (Off), hosts toggle this during transport
+    // changes and bounces. It is released in terminate.
     return AudioEffect::setActive(state);
 }
 
+//------------------------------------------------------------------------
+bool delay2Processor::sizeDelayBuffer ()
+{
+    Steinberg::Vst::SpeakerArrangement arr;
+    if (getBusArrangement(Steinberg::Vst::kOutput, 0, arr) != kResultTrue)
+        return false;
+
+    int numChannels = std::min(Steinberg::Vst::SpeakerArr::getChannelCount(arr), kMaxBusChannels);
+    double sampleRate = processSetup.sampleRate;
+    m_circularBufferSampleRate = sampleRate;
+
+    // Not processing, so anything still in the handoff can go
+    releaseHandoffBuffers(true);
+
+    // Groups as wide as the buffer allows while the audio thread runs them all, narrow ones
+    // once they are spread over threads. The channels are dealt out as evenly as possible.
+    const bool parallel = numChannels > m_ParallelThreshold;
+    const int groupWidth = parallel ? kParallelGroupChannels : MultiChannelBuffer::kMaxChannels;
+    m_NumGroups = (numChannels + groupWidth - 1) / groupWidth;
+    m_BufferChannels = numChannels;
+
+    // Engines for the groups this layout adds, and none for the ones it drops
+    m_Groups.resize(std::max(m_NumGroups, 1));
+    for (std::unique_ptr<ChannelGroup>& group : m_Groups)
+    {
+        if (!group)
+            group.reset(new ChannelGroup);
+    }
+
+    // Each group gets one interleaved buffer holding its channels side by side, just long enough for
+    // the longest tap at the rate the taps run at. Only allocates if the sample rate, rate reduction,
+    // channel count or range changed since the last call.
+    size_t convolutionFootprint = 0;
+    int firstChannel = 0;
+    for (int g = 0; g < static_cast<int>(m_Groups.size()); g++)
+    {
+        ChannelGroup& group = *m_Groups[g];
+        group.firstChannel = firstChannel;
+        group.numChannels = g < m_NumGroups ? numChannels / m_NumGroups + (g < numChannels % m_NumGroups ? 1 : 0) : 0;
+        firstChannel += group.numChannels;
+
+        group.engine.setRateReduction(m_RateReduction);
+        group.engine.setSampleRate(m_circularBufferSampleRate);
+        group.engine.setMaxDelay(m_MaxDelaySeconds);
+
+        // Only the groups in use get parameter changes, so a group joining a wider bus catches up here
+        for (int i = 0; g > 0 && i < kNumParams; i++)
+            group.engine.setParameter(i, m_Groups[0]->engine.getParameter(i));
+        m_BufferCapacity = DelayEngine::getRequiredCapacity(m_MaxDelaySeconds, group.engine.getNetworkSampleRate());
+        group.buffer.setSize(group.numChannels > 0 ? m_BufferCapacity : 0, group.numChannels);
+
+        // The convolver is sized for the same channels, or released when the option is off.
+        // The reduced rate path does not use it.
+        const bool convolution = m_ConvolutionEnabled && group.engine.getRateReduction() == 1;
+        group.engine.setConvolution(convolution && group.numChannels > 0, group.numChannels);
+        convolutionFootprint += group.engine.getFootprint();
+    }
+    m_BufferFootprint = getBufferFootprint();
+    m_ConvolutionFootprint = convolutionFootprint;
+    return true;
+}
+
+//------------------------------------------------------------------------
+size_t delay2Processor::getBufferFootprint () const
+{
+    size_t footprint = 0;
+    for (int g = 0; g < m_NumGroups; g++)
+        footprint += m_Groups[g]->buffer.getFootprint();
+    return footprint;
+}
+
+//------------------------------------------------------------------------
+tresult PLUGIN_API delay2Processor::setBusArrangements (Vst::SpeakerArrangement* inputs, int32 numIns,
+                                                        Vst::SpeakerArrangement* outputs, int32 numOuts)
+{
+    // Every channel is delayed on its own, so any layout works as long as the input matches it
+    if (numIns != 1 || numOuts != 1 || inputs[0] != outputs[0])
+        return kResultFalse;
+    int32 numChannels = Vst::SpeakerArr::getChannelCount(outputs[0]);
+    if (numChannels < 1 || numChannels > kMaxBusChannels)
+        return kResultFalse;
+    return AudioEffect::setBusArrangements(inputs, numIns, outputs, numOuts);
+}
+
+//------------------------------------------------------------------------
+void delay2Processor::releaseHandoffBuffers (bool all)
+{
+    if (all)
+        delete m_PendingBuffer.exchange(nullptr);
+
+    BufferHandoff* retired = m_RetiredBuffers.exchange(nullptr);
+    while (retired)
+    {
+        BufferHandoff* next = retired->next;
+        delete retired;
+        retired = next;
+    }
+}
+
+//------------------------------------------------------------------------
+void delay2Processor::releasePresets (bool all)
+{
+    if (all)
+        delete m_PendingPreset.exchange(nullptr);
+
+    PresetSnapshot* preset = m_RetiredPresets.exchange(nullptr);
+    while (preset)
+    {
+        PresetSnapshot* next = preset->next;
+        delete preset;
+        preset = next;
+    }
+}
+
+//------------------------------------------------------------------------
+void delay2Processor::setMaxDelay (double seconds)
+{
+    if (!std::isfinite(seconds))
+        return;
+    seconds = std::min(std::max(seconds, DelayEngine::kMinMaxDelay), DelayEngine::kMaxMaxDelay);
+    m_MaxDelaySeconds = seconds;
+
+    // While inactive the next activation sizes the buffer, and a smaller range
+    // keeps the current memory until then
+    if (!m_Active || m_BufferChannels == 0)
+        return;
+    int capacity = DelayEngine::getRequiredCapacity(seconds, m_Groups[0]->engine.getNetworkSampleRate());
+    if (capacity <= m_BufferCapacity)
+        return;
+
+    // Free what process handed back so far, then allocate the larger buffers here,
+    // outside of the audio thread. process swaps them in at the start of its next call.
+    releaseHandoffBuffers(false);
+    BufferHandoff* grown = new BufferHandoff;
+    for (int g = 0; g < m_NumGroups; g++)
+        grown->buffers[g].setSize(capacity, m_Groups[g]->numChannels);
+    grown->next = nullptr;
+    m_BufferCapacity = capacity;
+
+    // Buffers process has not picked up yet are replaced by these
+    delete m_PendingBuffer.exchange(grown);
+}
+
+//------------------------------------------------------------------------
+size_t delay2Processor::getMemoryFootprint () const
+{
+    return sizeof(*this) + m_Groups.size() * sizeof(ChannelGroup) + m_BufferFootprint.load()
+           + m_ConvolutionFootprint.load();
+}
+
 //------------------------------------------------------------------------
 tresult PLUGIN_API delay2Processor::process (Vst::ProcessData& data)
 {
-    // Check if there are any changes in the input parameters
-    if (data.inputParameterChanges)
+    // Take over delay memory grown by setMaxDelay. The old memory goes onto the retired list,
+    // pushed without locking like the presets, to be freed outside of process.
+    // The echoes held so far are dropped with it.
+    if (BufferHandoff* grown = m_PendingBuffer.exchange(nullptr))
     {
-        // Get the number of parameters that have changed
-        int32 numParamsChanged = data.inputParameterChanges->getParameterCount ();
+        for (int g = 0; g < m_NumGroups; g++)
+            m_Groups[g]->buffer.swap(grown->buffers[g]);
+        grown->next = m_RetiredBuffers.load(std::memory_order_relaxed);
+        while (!m_RetiredBuffers.compare_exchange_weak(grown->next, grown))
+        {
+        }
+        m_BufferFootprint = getBufferFootprint();
+    }
+    const double maxDelaySeconds = m_MaxDelaySeconds.load(std::memory_order_relaxed);
+    for (int g = 0; g < m_NumGroups; g++)
+        m_Groups[g]->engine.setMaxDelay(maxDelaySeconds);
 
-        // Iterate through each changed parameter
-        for (int32 index = 0; index < numParamsChanged; index++)
+    // Take over a preset loaded by setState. The engines crossfade to it, and the snapshot goes
+    // onto the retired list, pushed without locking, to be freed outside of process.
+    if (PresetSnapshot* preset = m_PendingPreset.exchange(nullptr))
+    {
+        for (int g = 0; g < m_NumGroups; g++)
+            m_Groups[g]->engine.crossfadeTo(preset->values);
+        preset->next = m_RetiredPresets.load(std::memory_order_relaxed);
+        while (!m_RetiredPresets.compare_exchange_weak(preset->next, preset))
         {
-            // Get the queue of parameter values for this parameter
-            Vst::IParamValueQueue* paramQueue = data.inputParameterChanges->getParameterData (index);
-
-            // If the queue is valid, we process the changes
-            if (paramQueue)
-            {
-                Vst::ParamValue value;
-                int32 sampleOffset;
-                int32 numPoints = paramQueue->getPointCount ();
-
-                // Check which parameter has changed
-                switch (paramQueue->getParameterId())
-                {
-                    // Master Gain parameter
-                    case AudioParams::kParamGainId_Master:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update our internal gain value with the new value
-                            m_gainMaster = value;
-                        }
-                        break;
-
-                    // Delay Time for Tap 1
-                    case AudioParams::kParamDelayLengthId_Tap1:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update internal delay length value for Tap 1 with the new value
-                            m_Delay1 = value;
-                        }
-                        break;
-
-                    // Delay Gain for Tap 1
-                    case kParamDelayGainId_Tap1:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the delay gain value for Tap 1 with the new value
-                            m_dGain1 = value;
-                        }
-                        break;
-
-                    // Feedback Gain for Tap 1
-                    case kParamFeedbackId_Tap1:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the feedback gain value for Tap 1 with the new value
-                            m_dFeedback1 = value;
-                        }
-                        break;
-
-                    // Delay Time for Tap 2
-                    case kParamDelayLengthId_Tap2:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update internal delay length value for Tap 2 with the new value
-                            m_Delay2 = value;
-                        }
-                        break;
-
-                    // Delay Gain for Tap 2
-                    case kParamDelayGainId_Tap2:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the delay gain value for Tap 2 with the new value
-                            m_dGain2 = value;
-                        }
-                        break;
-
-                    // Feedback Gain for Tap 2
-                    case kParamFeedbackId_Tap2:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the feedback gain value for Tap 2 with the new value
-                            m_dFeedback2 = value;
-                        }
-                        break;
-
-                    // Delay Time for Tap 3
-                    case kParamDelayLengthId_Tap3:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update internal delay length value for Tap 3 with the new value
-                            m_Delay3 = value;
-                        }
-                        break;
-
-                    // Delay Gain for Tap 3
-                    case kParamDelayGainId_Tap3:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the delay gain value for Tap 3 with the new value
-                            m_dGain3 = value;
-                        }
-                        break;
-
-                    // Feedback Gain for Tap 3
-                    case kParamFeedbackId_Tap3:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the feedback gain value for Tap 3 with the new value
-                            m_dFeedback3 = value;
-                        }
-                        break;
-
-                    // Delay Time for Tap 4
-                    case kParamDelayLengthId_Tap4:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update internal delay length value for Tap 4 with the new value
-                            m_Delay4 = value;
-                        }
-                        break;
-
-                    // Delay Gain for Tap 4
-                    case kParamDelayGainId_Tap4:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the delay gain value for Tap 4 with the new value
-                            m_dGain4 = value;
-                        }
-                        break;
-
-                    // Feedback Gain for Tap 4
-                    case kParamFeedbackId_Tap4:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update the feedback gain value for Tap 4 with the new value
-                            m_dFeedback4 = value;
-                        }
-                        break;
-
-                    // Dry Mix parameter
-                    case AudioParams::kParamDryMixId:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update our internal dry mix value with the new value
-                            m_DryMix = value;
-                        }
-                        break;
-
-                    // Wet Mix parameter
-                    case AudioParams::kParamWetMixId:
-                        // Get the most recent value of the parameter
-                        if (paramQueue->getPoint(numPoints - 1, sampleOffset, value) == kResultTrue)
-                        {
-                            // Update our internal wet mix value with the new value
-                            m_WetMix = value;
-                        }
-                        break;
-                }
-
-            }
         }
     }
-    
-    // If there's no input or samples, there's nothing to process
+
+    // The host tempo for the synced tap times, the engines only react when it changes
+    if (data.processContext && (data.processContext->state & Vst::ProcessContext::kTempoValid))
+    {
+        int32 numerator = 4;
+        int32 denominator = 4;
+        if (data.processContext->state & Vst::ProcessContext::kTimeSigValid)
+        {
+            numerator = data.processContext->timeSigNumerator;
+            denominator = data.processContext->timeSigDenominator;
+        }
+        for (int g = 0; g < m_NumGroups; g++)
+            m_Groups[g]->engine.setTempo(data.processContext->tempo, numerator, denominator);
+    }
+
+    // Collect every point of every parameter queue, so each change lands on its own sample
+    int32 numEvents = collectParameterChanges(data.inputParameterChanges);
+
+    // The last point of every queue is what getState saves
+    for (int32 i = 0; i < numEvents; i++)
+    {
+        int index = getParamIndex(m_ParamEvents[i].id);
+        if (index >= 0)
+            m_StateValues[index].store(m_ParamEvents[i].value, std::memory_order_relaxed);
+    }
+
+    // If there's no input or samples, there's nothing to process, but the latest values still count
     if (data.numInputs == 0 || data.numSamples == 0)
+    {
+        for (int g = 0; g < m_NumGroups; g++)
+        {
+            int32 eventIndex = 0;
+            applyParameterEvents(m_Groups[g]->engine, eventIndex, numEvents, kMaxInt32);
+        }
         return kResultOk;
+    }
 
     // Get basic information about the sound data
     int32 numChannels = data.inputs[0].numChannels;
@@ -294,97 +369,214 @@ tresult PLUGIN_API delay2Processor::process (Vst::ProcessData& data)
     // Make sure output isn't marked as silent
     data.outputs[0].silenceFlags = 0;
 
-    // Determine the mix of original (dry) and effect (wet)
-    double dryMix = (1.0 - m_WetMix);
-    double wetMix = m_WetMix;
-    double gainLimitter = 1.0 - wetMix * 0.5;
+    // Nothing to run through before the buffers exist for this bus, so the input passes
+    // through unchanged and any output channel without an input is cleared
+    if (m_BufferChannels != numChannels || m_NumGroups == 0)
+    {
+        for (int g = 0; g < m_NumGroups; g++)
+        {
+            int32 eventIndex = 0;
+            applyParameterEvents(m_Groups[g]->engine, eventIndex, numEvents, kMaxInt32);
+        }
+        for (int32 i = 0; i < data.outputs[0].numChannels; i++)
+        {
+            if (i >= numChannels)
+                memset(out[i], 0, sampleFramesSize);
+            else if (in[i] != out[i])
+                memcpy(out[i], in[i], sampleFramesSize);
+        }
+        return kResultOk;
+    }
 
-    // Process each channel of audio separately
-    for (int32 i = 0; i < numChannels; i++)
+    // Silent input into delay lines that have already played out: skip the taps and the feedback
+    // until something audible arrives again
+    const uint64 channelMask = numChannels >= 64 ? ~uint64(0) : (uint64(1) << numChannels) - 1;
+    const bool inputFlagged = (data.inputs[0].silenceFlags & channelMask) == channelMask;
+    bool inputSilent = inputFlagged;
+    if (!inputSilent)
+    {
+        if (data.symbolicSampleSize == Vst::kSample64)
+            inputSilent = DelayEngine::isSilent((Vst::Sample64**)in, numChannels, data.numSamples);
+        else
+            inputSilent = DelayEngine::isSilent((Vst::Sample32**)in, numChannels, data.numSamples);
+    }
+    bool tailSilent = inputSilent;
+    for (int g = 0; g < m_NumGroups && tailSilent; g++)
+        tailSilent = m_Groups[g]->engine.isTailSilent(m_Groups[g]->numChannels);
+    if (tailSilent)
     {
+        // Nothing is audible from the delay lines, so a change can land on its target without gliding.
+        // The delay memory still moves on, and a quiet dry signal still goes through the mix.
+        for (int g = 0; g < m_NumGroups; g++)
+        {
+            ChannelGroup& group = *m_Groups[g];
+            int32 eventIndex = 0;
+            applyParameterEvents(group.engine, eventIndex, numEvents, kMaxInt32);
+            if (numEvents > 0)
+                group.engine.snapParameters();
+
+            if (inputFlagged)
+                group.engine.skipSilence(group.buffer, data.numSamples);
+            else if (data.symbolicSampleSize == Vst::kSample64)
+                group.engine.processDry(group.buffer, (Vst::Sample64**)in + group.firstChannel,
+                                        (Vst::Sample64**)out + group.firstChannel, data.numSamples);
+            else
+                group.engine.processDry(group.buffer, (Vst::Sample32**)in + group.firstChannel,
+                                        (Vst::Sample32**)out + group.firstChannel, data.numSamples);
+        }
 
-        // Take samples from input audio
-        int32 samples = data.numSamples;
-        Vst::Sample32* ptrIn = (Vst::Sample32*)in[i];
-        Vst::Sample32* ptrOut = (Vst::Sample32*)out[i];
-        Vst::Sample32 outputAudio;
-
-        while (--samples >= 0) {
-
-            // Read from the input and write to the output
-            double inputAudio = (*ptrIn++);
-
-            // Determine the minimum delay based on the buffer sample rate
-            const double bufferDelay = 1.0 / m_circularBufferSampleRate;
-
-            // Calculate delay times for each of the taps
-            double delayedTime1 = std::max(static_cast<double>(m_Delay1), bufferDelay);
-            double delayedTime2 = std::max(static_cast<double>(m_Delay2 * m_Delay1), bufferDelay);
-            double delayedTime3 = std::max(static_cast<double>(m_Delay3 * m_Delay1), bufferDelay);
-            double delayedTime4 = std::max(static_cast<double>(m_Delay4 * m_Delay1), bufferDelay);
-
-            // Get a delayed signal for each tap
-            double delayedSig1 = m_dBuffer[i].performInterpolation(m_circularBufferSampleRate * delayedTime1);
-            double delayedSig2 = m_dBuffer[i].performInterpolation(m_circularBufferSampleRate * delayedTime2);
-            double delayedSig3 = m_dBuffer[i].performInterpolation(m_circularBufferSampleRate * delayedTime3);
-            double delayedSig4 = m_dBuffer[i].performInterpolation(m_circularBufferSampleRate * delayedTime4);
-
-            // Each delayed signal is fed back into itself to create an echo
-            double feedbackSig1 = m_dFeedback1 * delayedSig1;
-            double feedbackSig2 = m_dFeedback2 * delayedSig2;
-            double feedbackSig3 = m_dFeedback3 * delayedSig3;
-            double feedbackSig4 = m_dFeedback4 * delayedSig4;
-            
-          
-            // We limit the total feedback gain to avoid overflows
-            const double maxFeedbackGain = 0.8;
-            double feedbackGain1 = std::min(m_dFeedback1, maxFeedbackGain);
-            double feedbackGain2 = std::min(m_dFeedback2, maxFeedbackGain);
-            double feedbackGain3 = std::min(m_dFeedback3, maxFeedbackGain);
-            double feedbackGain4 = std::min(m_dFeedback4, maxFeedbackGain);
-
-            // Total feedback is the sum of each feedback gain times its delayed signal
-            double mixedFeedbackSignal = feedbackGain1 * delayedSig1 + feedbackGain2 * delayedSig2
-                               + feedbackGain3 * delayedSig3 + feedbackGain4 * delayedSig4;
-
-            // Gain limiter applied to the mixed feedback signal
-            double mixedFeedbackLimited = gainLimitter * mixedFeedbackSignal;
-            
-            // Mix the input audio with the feedback and write it back into the buffer
-            m_dBuffer[i].performWrite(inputAudio + mixedFeedbackLimited);
-
-            // Calculate the feedback gain for each tap
-            double fbGain1 = m_dGain1 * delayedSig1;
-            double fbGain2 = m_dGain2 * delayedSig2;
-            double fbGain3 = m_dGain3 * delayedSig3;
-            double fbGain4 = m_dGain4 * delayedSig4;
-
-            // Sum of all feedback gains is the total signal
-            double totalSignal = fbGain1 + fbGain2 + fbGain3 + fbGain4;
-
-            // Mix the dry (original) audio with the wet (effected) audio
-            double mixedAudio = (dryMix * inputAudio) + (wetMix * totalSignal);
-
-            // Gain limiter applied to the mixed audio
-            outputAudio = gainLimitter * mixedAudio;
-
-            // Allpass filter applied to the output
-            double allpassOutput = processAllpass(outputAudio);
-
-            // The result is written to the output
-            (*ptrOut++) = allpassOutput * m_gainMaster;
+        // Input the host marked silent stays silent
+        if (inputFlagged)
+        {
+            for (int32 i = 0; i < numChannels; i++)
+                memset(out[i], 0, sampleFramesSize);
+            data.outputs[0].silenceFlags = channelMask;
         }
+        return kResultOk;
     }
 
+    // Every group runs the whole block on its own channels, on the audio thread or a helper.
+    // The pool returns once all groups are done.
+    m_GroupBlock.in = in;
+    m_GroupBlock.out = out;
+    m_GroupBlock.numSamples = data.numSamples;
+    m_GroupBlock.numEvents = numEvents;
+    m_GroupBlock.is64 = data.symbolicSampleSize == Vst::kSample64;
+    m_Workers.run(&delay2Processor::processGroupTask, this, m_NumGroups);
+
     return kResultOk;
 }
 
+//------------------------------------------------------------------------
+void delay2Processor::processGroupTask (void* context, int index)
+{
+    delay2Processor* processor = static_cast<delay2Processor*>(context);
+    const GroupBlock& block = processor->m_GroupBlock;
+
+    // Both sample sizes run natively, without converting the bus
+    if (block.is64)
+        processor->processGroup<Vst::Sample64>(*processor->m_Groups[index], block);
+    else
+        processor->processGroup<Vst::Sample32>(*processor->m_Groups[index], block);
+}
+
+
+//------------------------------------------------------------------------
+uint32 PLUGIN_API delay2Processor::getTailSamples ()
+{
+    // The feedback can be set high enough to never decay
+    // All groups share the parameters, so the first one speaks for the bus
+    int64 tailSamples = m_Groups[0]->engine.getTailSamples();
+    if (tailSamples == DelayEngine::kInfiniteTail)
+        return Vst::kInfiniteTail;
+    return static_cast<uint32>(std::min<int64>(tailSamples, kMaxInt32));
+}
+
+//------------------------------------------------------------------------
+int32 delay2Processor::collectParameterChanges (Vst::IParameterChanges* changes)
+{
+    // Check if there are any changes in the input parameters
+    if (!changes)
+        return 0;
+
+    // Get the number of parameters that have changed
+    int32 numParamsChanged = changes->getParameterCount ();
+    int32 numEvents = 0;
+
+    // Iterate through each changed parameter
+    for (int32 index = 0; index < numParamsChanged; index++)
+    {
+        // Get the queue of parameter values for this parameter
+        Vst::IParamValueQueue* paramQueue = changes->getParameterData (index);
+        if (!paramQueue)
+            continue;
+
+        Vst::ParamID id = paramQueue->getParameterId ();
+        int32 numPoints = paramQueue->getPointCount ();
+        for (int32 point = 0; point < numPoints; point++)
+        {
+            // When the list runs short, keep room for the final point of every remaining queue
+            bool lastPoint = point == numPoints - 1;
+            if (!lastPoint && numEvents >= kMaxParamEvents - (numParamsChanged - index))
+                continue;
+            if (numEvents >= kMaxParamEvents)
+                break;
+
+            ParamEvent event;
+            event.id = id;
+            if (paramQueue->getPoint (point, event.sampleOffset, event.value) != kResultTrue)
+                continue;
+
+            // Insert in sample order, after any earlier point at the same offset
+            int32 i = numEvents++;
+            for (; i > 0 && m_ParamEvents[i - 1].sampleOffset > event.sampleOffset; i--)
+                m_ParamEvents[i] = m_ParamEvents[i - 1];
+            m_ParamEvents[i] = event;
+        }
+    }
+
+    return numEvents;
+}
+
+//------------------------------------------------------------------------
+void delay2Processor::applyParameterEvents (DelayEngine& engine, int32& eventIndex, int32 numEvents, int32 untilOffset)
+{
+    // Take over every collected point up to and including 'untilOffset'. The engine
+    // stores it in its dense parameter array and glides towards it from there.
+    for (; eventIndex < numEvents && m_ParamEvents[eventIndex].sampleOffset <= untilOffset; eventIndex++)
+    {
+        int index = getParamIndex(m_ParamEvents[eventIndex].id);
+        if (index >= 0)
+            engine.setParameter(index, m_ParamEvents[eventIndex].value);
+    }
+}
+
+//------------------------------------------------------------------------
+template <typename SampleType>
+void delay2Processor::processGroup (ChannelGroup& group, const GroupBlock& block)
+{
+    // Split the block at every change point and run each segment with the values valid there.
+    // Every group walks the same list, which is only read here.
+    int32 eventIndex = 0;
+    int32 position = 0;
+    while (position < block.numSamples)
+    {
+        applyParameterEvents(group.engine, eventIndex, block.numEvents, position);
+
+        int32 segmentEnd = block.numSamples;
+        if (eventIndex < block.numEvents)
+            segmentEnd = std::min(m_ParamEvents[eventIndex].sampleOffset, block.numSamples);
+
+        // Channel pointers of the group, moved to the start of the segment
+        SampleType* segmentIn[MultiChannelBuffer::kMaxChannels];
+        SampleType* segmentOut[MultiChannelBuffer::kMaxChannels];
+        for (int i = 0; i < group.numChannels; i++)
+        {
+            segmentIn[i] = (SampleType*)block.in[group.firstChannel + i] + position;
+            segmentOut[i] = (SampleType*)block.out[group.firstChannel + i] + position;
+        }
+
+        // Taps, feedback, dry/wet mix, allpass and master gain for the group's channels of the segment
+        group.engine.process(group.buffer, segmentIn, segmentOut, segmentEnd - position);
+
+        position = segmentEnd;
+    }
+
+    // Points at or past the end of the block still set the values for the next one
+    applyParameterEvents(group.engine, eventIndex, block.numEvents, kMaxInt32);
+}
 
 //------------------------------------------------------------------------
 tresult PLUGIN_API delay2Processor::setupProcessing (Vst::ProcessSetup& newSetup)
 {
     // Let the parent class also handle this call
-    return AudioEffect::setupProcessing(newSetup);
+    tresult result = AudioEffect::setupProcessing(newSetup);
+    if (result != kResultOk)
+        return result;
+
+    // Allocate the delay memory here, outside of activation, so setActive stays cheap
+    sizeDelayBuffer();
+    return result;
 }
 
 //------------------------------------------------------------------------
@@ -394,59 +586,92 @@ tresult PLUGIN_API delay2Processor::canProcessSampleSize (int32 symbolicSampleSi
 	if (symbolicSampleSize == Vst::kSample32)
 		return kResultTrue;
 
-	// disable the following comment if your processing support kSample64
-	/* if (symbolicSampleSize == Vst::kSample64)
-		return kResultTrue; */
+	// the engine is templated on the sample type, so kSample64 is processed natively too
+	if (symbolicSampleSize == Vst::kSample64)
+		return kResultTrue;
 
 	return kResultFalse;
 }
 
 //------------------------------------------------------------------------
-tresult PLUGIN_API delay2Processor::setState (IBStream* state)
+tresult PLUGIN_API delay2Processor::notify (Vst::IMessage* message)
 {
+    if (!message)
+        return kInvalidArgument;
 
-    // called when we load a preset or project, the model has to be reloaded
-    IBStreamer streamer (state, kLittleEndian);
+    // Sent from the message thread, so the delay memory can grow right here
+    if (FIDStringsEqual (message->getMessageID (), kMaxDelayMessageId))
+    {
+        double seconds;
+        if (message->getAttributes ()->getFloat (kMaxDelaySecondsAttr, seconds) != kResultOk)
+            return kResultFalse;
+        setMaxDelay (seconds);
+        return kResultOk;
+    }
 
-    return kResultOk;
+    // Applied by setupProcessing, which the controller has the host call again
+    if (FIDStringsEqual (message->getMessageID (), kConvolutionMessageId))
+    {
+        int64 enabled;
+        if (message->getAttributes ()->getInt (kConvolutionEnabledAttr, enabled) != kResultOk)
+            return kResultFalse;
+        setConvolutionEnabled (enabled != 0);
+        return kResultOk;
+    }
+    return AudioEffect::notify (message);
 }
 
 //------------------------------------------------------------------------
-tresult PLUGIN_API delay2Processor::getState (IBStream* state)
+tresult PLUGIN_API delay2Processor::setState (IBStream* state)
 {
-    // here we need to save the model (preset or project)
+    if (!state)
+        return kResultFalse;
+
+    // called when we load a preset or project, the model has to be reloaded.
+    // Nothing is applied unless the whole state could be read.
     IBStreamer streamer (state, kLittleEndian);
-    return kResultOk;
-}
+    PluginState loaded;
+    if (loaded.read (streamer) == false)
+        return kResultFalse;
 
-// Function to calculate the coefficient for the allpass filter
-void delay2Processor::calculateAllpassCoefficient(double delayTimeSeconds)
-{
-    // Calculate the coefficient 'g' for the allpass filter using the desired delay time in seconds.
-    // The formula is: g = (1 - delayTimeSeconds) / (1 + delayTimeSeconds)
-    double g = (1.0 - delayTimeSeconds) / (1.0 + delayTimeSeconds);
+    for (int i = 0; i < kNumParams; i++)
+        m_StateValues[i].store (loaded.values[i], std::memory_order_relaxed);
+
+    // The options apply on the next activation, the range as soon as it can be grown
+    setConvolutionEnabled (loaded.convolutionEnabled);
+    setRateReduction (loaded.rateReduction);
+    setMaxDelay (loaded.maxDelaySeconds);
 
-    // Store the calculated coefficient in the member variable 'm_AllpassCoefficient' for later use.
-    m_AllpassCoefficient = g;
+    // While processing, the values travel to the audio thread in a snapshot allocated here.
+    // A snapshot process has not picked up yet is replaced.
+    releasePresets (false);
+    PresetSnapshot* preset = new PresetSnapshot;
+    std::copy (loaded.values, loaded.values + kNumParams, preset->values);
+    preset->next = nullptr;
+    delete m_PendingPreset.exchange (preset);
+
+    return kResultOk;
 }
 
-// Function to process the input signal through the allpass filter and return the filtered output
-double delay2Processor::processAllpass(double input)
+//------------------------------------------------------------------------
+tresult PLUGIN_API delay2Processor::getState (IBStream* state)
 {
-    // Multiply the input by the negative of 'm_AllpassCoefficient' and add the previous input value.
-    double output = input * (-m_AllpassCoefficient) + m_PreviousInput;
-
-    // Add the previous output value multiplied by 'm_AllpassCoefficient'.
-    output += m_AllpassCoefficient * m_PreviousOutput;
+    if (!state)
+        return kResultFalse;
 
-    // Update the previous input and output values for the next sample processing.
-    m_PreviousInput = input;
-    m_PreviousOutput = output;
+    // here we need to save the model (preset or project)
+    PluginState saved;
+    for (int i = 0; i < kNumParams; i++)
+        saved.values[i] = m_StateValues[i].load (std::memory_order_relaxed);
+    saved.maxDelaySeconds = m_MaxDelaySeconds;
+    saved.convolutionEnabled = m_ConvolutionEnabled;
+    saved.rateReduction = m_RateReduction;
 
-    // Return the filtered output from the allpass filter.
-    return output;
+    IBStreamer streamer (state, kLittleEndian);
+    if (saved.write (streamer) == false)
+        return kResultFalse;
+    return kResultOk;
 }
 
-
 //------------------------------------------------------------------------
 } // namespace delayEffectProcessor
@@ -7,7 +7,11 @@
 #pragma once
 
 #include "public.sdk/source/vst/vstaudioeffect.h"
-#include "circularBuffer.hpp"
+#include "audioWorkerPool.hpp"
+#include "delayEngine.hpp"
+#include <atomic>
+#include <memory>
+#include <vector>
 
 namespace delayEffectProcessor {
 
@@ -20,7 +24,16 @@ public:
 	delay2Processor ();
 	~delay2Processor () SMTG_OVERRIDE;
 
-    static const int kNumTaps = 4;
+    static const int kNumTaps = DelayEngine::kNumParamTaps;
+
+    // Widest bus setBusArrangements accepts: 7.1.4, 9.1.6 and third order ambisonics fit
+    static const int kMaxBusChannels = 32;
+
+    // Channels per group once the groups run in parallel, one AVX register of doubles per frame.
+    // Below the threshold a group holds up to MultiChannelBuffer::kMaxChannels.
+    static const int kParallelGroupChannels = 4;
+    static const int kMaxChannelGroups = kMaxBusChannels / kParallelGroupChannels;
+    static const int kDefaultParallelThreshold = MultiChannelBuffer::kMaxChannels;
     
     // Create function
 	static Steinberg::FUnknown* createInstance (void* /*context*/) 
@@ -37,6 +50,10 @@ public:
 	/** Called at the end before destructor */
 	Steinberg::tresult PLUGIN_API terminate () SMTG_OVERRIDE;
 	
+	/** Accepts any layout up to kMaxBusChannels, as long as input and output match */
+	Steinberg::tresult PLUGIN_API setBusArrangements (Steinberg::Vst::SpeakerArrangement* inputs, Steinberg::int32 numIns,
+	                                                  Steinberg::Vst::SpeakerArrangement* outputs, Steinberg::int32 numOuts) SMTG_OVERRIDE;
+
 	/** Switch the Plug-in on/off */
 	Steinberg::tresult PLUGIN_API setActive (Steinberg::TBool state) SMTG_OVERRIDE;
 
@@ -46,52 +63,170 @@ public:
 	/** Asks if a given sample size is supported see SymbolicSampleSizes. */
 	Steinberg::tresult PLUGIN_API canProcessSampleSize (Steinberg::int32 symbolicSampleSize) SMTG_OVERRIDE;
 
+	/** Gets the current tail length, derived from the tap times and feedback gains */
+	Steinberg::uint32 PLUGIN_API getTailSamples () SMTG_OVERRIDE;
+
 	/** Here we go...the process call */
 	Steinberg::tresult PLUGIN_API process (Steinberg::Vst::ProcessData& data) SMTG_OVERRIDE;
 		
-	/** For persistence */
+	/** Takes the controller's max delay range, see setMaxDelay */
+	Steinberg::tresult PLUGIN_API notify (Steinberg::Vst::IMessage* message) SMTG_OVERRIDE;
+
+	/** For persistence, in the PluginState format. While processing, a loaded preset is handed to
+	    the audio thread without locking and crossfaded in by the engines. */
 	Steinberg::tresult PLUGIN_API setState (Steinberg::IBStream* state) SMTG_OVERRIDE;
 	Steinberg::tresult PLUGIN_API getState (Steinberg::IBStream* state) SMTG_OVERRIDE;
 
+	/** Longest tap 1 time in seconds, saved with the state and set by the controller's Max Delay
+	    parameter. While processing, a larger range grows the delay memory off the audio thread
+	    and hands it over in process. */
+	void setMaxDelay (double seconds);
+	double getMaxDelay () const { return m_MaxDelaySeconds.load (); }
+
+	/** Lets the engine move settled multi-tap setups to FFT convolution. Takes effect on the
+	    next activation, which allocates the convolution memory. The controller's Convolution
+	    switch sends it as a message and asks the host for that activation. */
+	void setConvolutionEnabled (bool enabled) { m_ConvolutionEnabled = enabled; }
+	bool isConvolutionEnabled () const { return m_ConvolutionEnabled.load (); }
+
+	/** Runs the taps and the feedback at 1/factor of the host rate (1, 2 or 4), with the delay
+	    memory shrinking to match, see DelayEngine::setRateReduction. Meant for 96 kHz and up.
+	    Takes effect on the next activation, which sizes the delay memory for it. */
+	void setRateReduction (int factor) { m_RateReduction = factor; }
+	int getRateReduction () const { return m_RateReduction.load (); }
+
+	/** Buses with more channels than this are split into groups of kParallelGroupChannels that
+	    run on helper threads alongside the audio thread. Takes effect on the next activation. It suits
+	    the machine rather than the project, so it is not saved with the state. */
+	void setParallelThreshold (int numChannels) { m_ParallelThreshold = numChannels; }
+	int getParallelThreshold () const { return m_ParallelThreshold.load (); }
+
+	/** Bytes used by the processor including its engines, delay and convolution memory */
+	size_t getMemoryFootprint () const;
+
 //------------------------------------------------------------------------
 protected:
-    // These values are used for the processing.
+    // The bus is split into groups of neighbouring channels, each with its own engine and
+    // delay memory, so the groups can run on different threads. All engines get the same
+    // parameter changes and stay in step.
+    struct ChannelGroup
+    {
+        // Holds the parameter values and their smoothers as well as the cooked tap table
+        DelayEngine engine;
+        MultiChannelBuffer buffer;
+        int firstChannel = 0;
+        int numChannels = 0;
+    };
+
+    // These values are used for the processing. An engine is a few hundred kilobytes, so only the
+    // groups of the current layout are allocated, by sizeDelayBuffer. The first one always exists
+    // and holds the parameter values between activations.
     int m_circularBufferSampleRate;
-    std::vector<CircularBuffer> m_dBuffer;
-    
-    Steinberg::Vst::ParamValue m_gainMaster = 0.f;
-    
-    Steinberg::Vst::ParamValue m_DryMix = 0.f;
-    Steinberg::Vst::ParamValue m_WetMix = 0.f;
-    
-    Steinberg::Vst::ParamValue m_Delay1 = 0.f;
-    Steinberg::Vst::ParamValue m_dGain1 = 0.f;
-    Steinberg::Vst::ParamValue m_dFeedback1 = 0.f;
-    
-    Steinberg::Vst::ParamValue m_Delay2 = 0.f;
-    Steinberg::Vst::ParamValue m_dGain2 = 0.f;
-    Steinberg::Vst::ParamValue m_dFeedback2 = 0.f;
-    
-    Steinberg::Vst::ParamValue m_Delay3 = 0.f;
-    Steinberg::Vst::ParamValue m_dGain3 = 0.f;
-    Steinberg::Vst::ParamValue m_dFeedback3 = 0.f;
-    
-    Steinberg::Vst::ParamValue m_Delay4 = 0.f;
-    Steinberg::Vst::ParamValue m_dGain4 = 0.f;
-    Steinberg::Vst::ParamValue m_dFeedback4 = 0.f;
-    
+    std::vector<std::unique_ptr<ChannelGroup>> m_Groups;
+    int m_NumGroups;
+
+    // Helpers for the groups above the parallel threshold, started on activation
+    AudioWorkerPool m_Workers;
+    std::atomic<int> m_ParallelThreshold;
+
+    // Max delay range, written by setState / setMaxDelay and read by process
+    std::atomic<double> m_MaxDelaySeconds;
+    bool m_Active;
+
+    // Layout the group buffers were last sized for, only touched outside of process
+    int m_BufferChannels;
+    int m_BufferCapacity;
+
+    // Delay memory for every group on its way between setMaxDelay and process
+    struct BufferHandoff
+    {
+        MultiChannelBuffer buffers[kMaxChannelGroups];
+        BufferHandoff* next;
+    };
+
+    // Grown delay memory waiting for process to swap it in, and a list of the memory it
+    // replaced, waiting to be freed outside of process
+    std::atomic<BufferHandoff*> m_PendingBuffer;
+    std::atomic<BufferHandoff*> m_RetiredBuffers;
+
+    // The group buffers' footprint, updated by whichever thread last changed them
+    std::atomic<size_t> m_BufferFootprint;
+
+    // Convolution mode option, applied by sizeDelayBuffer, and the memory it holds there
+    std::atomic<bool> m_ConvolutionEnabled;
+    std::atomic<size_t> m_ConvolutionFootprint;
+
+    // Reduced rate option, applied by sizeDelayBuffer
+    std::atomic<int> m_RateReduction;
+
+    // Parameter values of a loaded preset on their way to the engines
+    struct PresetSnapshot
+    {
+        double values[kNumParams];
+        PresetSnapshot* next;
+    };
+
+    // The preset process picks up at the start of its next call, and a list of those it has
+    // applied, waiting to be freed outside of process
+    std::atomic<PresetSnapshot*> m_PendingPreset;
+    std::atomic<PresetSnapshot*> m_RetiredPresets;
+
+    // Latest value of every parameter for getState, written by setState and by process
+    // for the host's changes, so the state can be saved without touching the engines
+    std::atomic<double> m_StateValues[kNumParams];
     
 private:
-    // Allpass filter coefficients
-    double m_AllpassCoefficient;
-    double m_PreviousInput;
-    double m_PreviousOutput;
+    // Splits the output bus into channel groups and sizes their buffers for processSetup and
+    // the max delay range, allocating only when one of them changed
+    bool sizeDelayBuffer();
+
+    // Bytes held by the group buffers
+    size_t getBufferFootprint() const;
+
+    // Frees the buffers process has replaced, and the pending ones as well if 'all' is set,
+    // which is only safe while not processing
+    void releaseHandoffBuffers(bool all);
+
+    // Frees the presets process has applied, and the pending one as well if 'all' is set,
+    // which is only safe while not processing
+    void releasePresets(bool all);
+
+    // The block process hands to the groups, valid for the duration of one m_Workers.run
+    struct GroupBlock
+    {
+        void** in;
+        void** out;
+        Steinberg::int32 numSamples;
+        Steinberg::int32 numEvents;
+        bool is64;
+    };
+    GroupBlock m_GroupBlock;
+
+    // AudioWorkerPool task: runs group 'index' over m_GroupBlock
+    static void processGroupTask(void* context, int index);
+
+    // Runs one group's engine over a whole block, split at the parameter changes
+    template <typename SampleType>
+    void processGroup(ChannelGroup& group, const GroupBlock& block);
+
+    // One automation point taken from the host's parameter queues
+    struct ParamEvent
+    {
+        Steinberg::Vst::ParamID id;
+        Steinberg::int32 sampleOffset;
+        Steinberg::Vst::ParamValue value;
+    };
+
+    // Upper bound on the automation points handled in one block
+    static const int kMaxParamEvents = 512;
+    ParamEvent m_ParamEvents[kMaxParamEvents];
 
-    // Function to calculate allpass filter coefficients
-    void calculateAllpassCoefficient(double delayTimeSeconds);
+    // Gathers every point of every queue into m_ParamEvents, sorted by sample offset
+    Steinberg::int32 collectParameterChanges(Steinberg::Vst::IParameterChanges* changes);
 
-    // Allpass filter processing function
-    double processAllpass(double input);
+    // Applies the collected points up to a sample offset to one engine, advancing eventIndex
+    void applyParameterEvents(DelayEngine& engine, Steinberg::int32& eventIndex, Steinberg::int32 numEvents,
+                              Steinberg::int32 untilOffset);
 
 };
 
@@ -0,0 +1,844 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Four tap interpolation and allpass kernels with runtime CPU dispatch.
+//------------------------------------------------------------------------
+
+#include "tapKernels.hpp"
+#include <cstddef>
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define DELAY2_X86_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// GCC and Clang only emit AVX instructions inside functions that ask for them,
+// MSVC accepts the intrinsics anywhere
+#if defined(__GNUC__) || defined(__clang__)
+#define DELAY2_TARGET_AVX __attribute__((target("avx")))
+#else
+#define DELAY2_TARGET_AVX
+#endif
+
+namespace {
+
+//------------------------------------------------------------------------
+// Cubic interpolation formula, see CircularBuffer::performInterpolation
+inline double interpolateCubic(double v3, double v2, double v1, double v0, double fraction)
+{
+    double a = v3 - v2 - v0 + v1;
+    double b = v0 - v1 - a;
+    double c = v2 - v0;
+    double d = v1;
+
+    return ((a * fraction + b) * fraction + c) * fraction + d;
+}
+
+//------------------------------------------------------------------------
+void processTapsScalar(const double* const windows[4], const double fraction[4], const double feedback[4],
+                       const double gain[4], int numSamples, double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numSamples; n++)
+    {
+        double delayedSig[4];
+        for (int t = 0; t < 4; t++)
+        {
+            // Oldest sample first, so v0 (the newest) sits at the end of the window
+            const double* window = windows[t] + n;
+            delayedSig[t] = interpolateCubic(window[0], window[1], window[2], window[3], fraction[t]);
+        }
+
+        double feedbackSig = feedback[0] * delayedSig[0] + feedback[1] * delayedSig[1]
+                           + feedback[2] * delayedSig[2] + feedback[3] * delayedSig[3];
+        double wetSig = gain[0] * delayedSig[0] + gain[1] * delayedSig[1]
+                      + gain[2] * delayedSig[2] + gain[3] * delayedSig[3];
+        feedbackSum[n] = accumulate ? feedbackSum[n] + feedbackSig : feedbackSig;
+        wetSum[n] = accumulate ? wetSum[n] + wetSig : wetSig;
+    }
+}
+
+//------------------------------------------------------------------------
+// One channel of an interleaved frame, 'offset' is the frame start plus the channel
+inline void processChannelScalar(const double* const windows[4], int stride, int offset, const double fraction[4],
+                                 const double feedback[4], const double gain[4], double* feedbackSum, double* wetSum, bool accumulate)
+{
+    double feedbackAcc = 0.0;
+    double wetAcc = 0.0;
+    for (int t = 0; t < 4; t++)
+    {
+        const double* window = windows[t] + offset;
+        double delayedSig = interpolateCubic(window[0], window[stride], window[2 * stride], window[3 * stride], fraction[t]);
+        feedbackAcc = t == 0 ? feedback[t] * delayedSig : feedbackAcc + feedback[t] * delayedSig;
+        wetAcc = t == 0 ? gain[t] * delayedSig : wetAcc + gain[t] * delayedSig;
+    }
+    feedbackSum[offset] = accumulate ? feedbackSum[offset] + feedbackAcc : feedbackAcc;
+    wetSum[offset] = accumulate ? wetSum[offset] + wetAcc : wetAcc;
+}
+
+//------------------------------------------------------------------------
+void processFramesScalar(const double* const windows[4], int numChannels, const double fraction[4], const double feedback[4],
+                         const double gain[4], int numFrames, double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        for (int c = 0; c < numChannels; c++)
+            processChannelScalar(windows, numChannels, n * numChannels + c, fraction, feedback, gain, feedbackSum, wetSum, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// Window start and fraction of the four taps of a moving group for one frame, each window
+// starting 'halfWindow' frames further back than the whole part of its delay
+inline void locateWindowsScalar(const double* frames, int numChannels, int mask, int frame, int halfWindow, double position,
+                                const double delay[4], const double delayStep[4], const double* windows[4], double fraction[4])
+{
+    for (int t = 0; t < 4; t++)
+    {
+        const double delaySamples = delay[t] + position * delayStep[t];
+        const int whole = static_cast<int>(delaySamples);
+        fraction[t] = delaySamples - whole;
+        windows[t] = frames + static_cast<size_t>((frame - whole - halfWindow) & mask) * numChannels;
+    }
+}
+
+//------------------------------------------------------------------------
+void processModulatedScalar(const double* frames, int numChannels, int mask, int writeFrame, const double delay[4],
+                            const double delayStep[4], const double feedback[4], const double gain[4], int numFrames,
+                            double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double* windows[4];
+        double fraction[4];
+        locateWindowsScalar(frames, numChannels, mask, writeFrame + n, 2, n, delay, delayStep, windows, fraction);
+
+        const int frame = n * numChannels;
+        for (int c = 0; c < numChannels; c++)
+            processChannelScalar(windows, numChannels, c, fraction, feedback, gain, feedbackSum + frame, wetSum + frame, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// One channel of an interleaved frame (or one mono sample) weighed by the window coefficients of all four taps
+inline void processFirChannelScalar(const double* const windows[4], int stride, int offset, int numPoints, const double* coefficients,
+                                    const double feedback[4], const double gain[4], double* feedbackSum, double* wetSum, bool accumulate)
+{
+    double feedbackAcc = 0.0;
+    double wetAcc = 0.0;
+    for (int t = 0; t < 4; t++)
+    {
+        const double* window = windows[t] + offset;
+        const double* weights = coefficients + t * kMaxInterpolationPoints;
+        double delayedSig = weights[0] * window[0];
+        for (int k = 1; k < numPoints; k++)
+            delayedSig += weights[k] * window[k * stride];
+        feedbackAcc = t == 0 ? feedback[t] * delayedSig : feedbackAcc + feedback[t] * delayedSig;
+        wetAcc = t == 0 ? gain[t] * delayedSig : wetAcc + gain[t] * delayedSig;
+    }
+    feedbackSum[offset] = accumulate ? feedbackSum[offset] + feedbackAcc : feedbackAcc;
+    wetSum[offset] = accumulate ? wetSum[offset] + wetAcc : wetAcc;
+}
+
+//------------------------------------------------------------------------
+void processFirScalar(const double* const windows[4], int numChannels, int numPoints, const double* coefficients,
+                      const double feedback[4], const double gain[4], int numFrames, double* feedbackSum, double* wetSum,
+                      bool accumulate)
+{
+    for (int i = 0; i < numFrames * numChannels; i++)
+        processFirChannelScalar(windows, numChannels, i, numPoints, coefficients, feedback, gain, feedbackSum, wetSum, accumulate);
+}
+
+//------------------------------------------------------------------------
+void processModulatedFirScalar(const double* frames, int numChannels, int mask, int writeFrame, int numPoints,
+                               CoefficientFunction coefficientsAt, const double delay[4], const double delayStep[4],
+                               const double feedback[4], const double gain[4], int numFrames, double* feedbackSum,
+                               double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double* windows[4];
+        double fraction[4];
+        double coefficients[4 * kMaxInterpolationPoints];
+        locateWindowsScalar(frames, numChannels, mask, writeFrame + n, numPoints / 2, n, delay, delayStep, windows, fraction);
+        for (int t = 0; t < 4; t++)
+            coefficientsAt(fraction[t], coefficients + t * kMaxInterpolationPoints);
+
+        const int frame = n * numChannels;
+        processFirScalar(windows, numChannels, numPoints, coefficients, feedback, gain, 1, feedbackSum + frame, wetSum + frame, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// One channel of the allpass bank, 'stride' samples from frame to frame
+inline void processAllpassChannel(double* samples, int stride, int numFrames, double coefficient,
+                                  double& previousInput, double& previousOutput)
+{
+    double x1 = previousInput;
+    double y1 = previousOutput;
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double x = samples[n * stride];
+        const double y = x * (-coefficient) + x1 + coefficient * y1;
+        samples[n * stride] = y;
+        x1 = x;
+        y1 = y;
+    }
+    previousInput = x1;
+    previousOutput = y1;
+}
+
+//------------------------------------------------------------------------
+void processAllpassScalar(double* frames, int numChannels, int numFrames, double coefficient,
+                          double* previousInput, double* previousOutput)
+{
+    for (int c = 0; c < numChannels; c++)
+        processAllpassChannel(frames + c, numChannels, numFrames, coefficient, previousInput[c], previousOutput[c]);
+}
+
+#if DELAY2_X86_SIMD
+//------------------------------------------------------------------------
+// Interpolates two taps, one per lane, from their windows split into (v3, v2) and (v1, v0) halves
+inline __m128d interpolatePairSSE2(__m128d lowA, __m128d highA, __m128d lowB, __m128d highB, __m128d fraction)
+{
+    __m128d v3 = _mm_unpacklo_pd(lowA, lowB);
+    __m128d v2 = _mm_unpackhi_pd(lowA, lowB);
+    __m128d v1 = _mm_unpacklo_pd(highA, highB);
+    __m128d v0 = _mm_unpackhi_pd(highA, highB);
+
+    __m128d a = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(v3, v2), v0), v1);
+    __m128d b = _mm_sub_pd(_mm_sub_pd(v0, v1), a);
+    __m128d c = _mm_sub_pd(v2, v0);
+
+    __m128d y = _mm_add_pd(_mm_mul_pd(a, fraction), b);
+    y = _mm_add_pd(_mm_mul_pd(y, fraction), c);
+    return _mm_add_pd(_mm_mul_pd(y, fraction), v1);
+}
+
+//------------------------------------------------------------------------
+// Adds the four lanes of two pairs in tap order
+inline double sumInTapOrderSSE2(__m128d taps01, __m128d taps23)
+{
+    double sum = _mm_cvtsd_f64(taps01) + _mm_cvtsd_f64(_mm_unpackhi_pd(taps01, taps01));
+    sum += _mm_cvtsd_f64(taps23);
+    return sum + _mm_cvtsd_f64(_mm_unpackhi_pd(taps23, taps23));
+}
+
+//------------------------------------------------------------------------
+void processTapsSSE2(const double* const windows[4], const double fraction[4], const double feedback[4],
+                     const double gain[4], int numSamples, double* feedbackSum, double* wetSum, bool accumulate)
+{
+    const __m128d fraction01 = _mm_loadu_pd(fraction);
+    const __m128d fraction23 = _mm_loadu_pd(fraction + 2);
+    const __m128d feedback01 = _mm_loadu_pd(feedback);
+    const __m128d feedback23 = _mm_loadu_pd(feedback + 2);
+    const __m128d gain01 = _mm_loadu_pd(gain);
+    const __m128d gain23 = _mm_loadu_pd(gain + 2);
+
+    for (int n = 0; n < numSamples; n++)
+    {
+        __m128d y01 = interpolatePairSSE2(_mm_loadu_pd(windows[0] + n), _mm_loadu_pd(windows[0] + n + 2),
+                                          _mm_loadu_pd(windows[1] + n), _mm_loadu_pd(windows[1] + n + 2),
+                                          fraction01);
+        __m128d y23 = interpolatePairSSE2(_mm_loadu_pd(windows[2] + n), _mm_loadu_pd(windows[2] + n + 2),
+                                          _mm_loadu_pd(windows[3] + n), _mm_loadu_pd(windows[3] + n + 2),
+                                          fraction23);
+
+        double feedbackSig = sumInTapOrderSSE2(_mm_mul_pd(feedback01, y01), _mm_mul_pd(feedback23, y23));
+        double wetSig = sumInTapOrderSSE2(_mm_mul_pd(gain01, y01), _mm_mul_pd(gain23, y23));
+        feedbackSum[n] = accumulate ? feedbackSum[n] + feedbackSig : feedbackSig;
+        wetSum[n] = accumulate ? wetSum[n] + wetSig : wetSig;
+    }
+}
+
+//------------------------------------------------------------------------
+// Two neighbouring channels of an interleaved frame
+inline void processChannelPairSSE2(const double* const windows[4], int stride, int offset, const double fraction[4],
+                                   const double feedback[4], const double gain[4], double* feedbackSum, double* wetSum, bool accumulate)
+{
+    __m128d feedbackAcc = _mm_setzero_pd();
+    __m128d wetAcc = _mm_setzero_pd();
+    for (int t = 0; t < 4; t++)
+    {
+        const double* window = windows[t] + offset;
+        __m128d v3 = _mm_loadu_pd(window);
+        __m128d v2 = _mm_loadu_pd(window + stride);
+        __m128d v1 = _mm_loadu_pd(window + 2 * stride);
+        __m128d v0 = _mm_loadu_pd(window + 3 * stride);
+        __m128d f = _mm_set1_pd(fraction[t]);
+
+        __m128d a = _mm_add_pd(_mm_sub_pd(_mm_sub_pd(v3, v2), v0), v1);
+        __m128d b = _mm_sub_pd(_mm_sub_pd(v0, v1), a);
+        __m128d c = _mm_sub_pd(v2, v0);
+        __m128d y = _mm_add_pd(_mm_mul_pd(a, f), b);
+        y = _mm_add_pd(_mm_mul_pd(y, f), c);
+        y = _mm_add_pd(_mm_mul_pd(y, f), v1);
+
+        __m128d feedbackSig = _mm_mul_pd(_mm_set1_pd(feedback[t]), y);
+        __m128d wetSig = _mm_mul_pd(_mm_set1_pd(gain[t]), y);
+        feedbackAcc = t == 0 ? feedbackSig : _mm_add_pd(feedbackAcc, feedbackSig);
+        wetAcc = t == 0 ? wetSig : _mm_add_pd(wetAcc, wetSig);
+    }
+    if (accumulate)
+    {
+        feedbackAcc = _mm_add_pd(_mm_loadu_pd(feedbackSum + offset), feedbackAcc);
+        wetAcc = _mm_add_pd(_mm_loadu_pd(wetSum + offset), wetAcc);
+    }
+    _mm_storeu_pd(feedbackSum + offset, feedbackAcc);
+    _mm_storeu_pd(wetSum + offset, wetAcc);
+}
+
+//------------------------------------------------------------------------
+void processFramesSSE2(const double* const windows[4], int numChannels, const double fraction[4], const double feedback[4],
+                       const double gain[4], int numFrames, double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const int frame = n * numChannels;
+        int c = 0;
+        for (; c + 2 <= numChannels; c += 2)
+            processChannelPairSSE2(windows, numChannels, frame + c, fraction, feedback, gain, feedbackSum, wetSum, accumulate);
+        if (c < numChannels)
+            processChannelScalar(windows, numChannels, frame + c, fraction, feedback, gain, feedbackSum, wetSum, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// Window starts of the four taps from their whole delays, wrapped into the ring
+inline void storeWindowsSSE2(const double* frames, int numChannels, int mask, int frame, int halfWindow, __m128i whole,
+                             const double* windows[4])
+{
+    alignas(16) int starts[4];
+    _mm_store_si128(reinterpret_cast<__m128i*>(starts),
+                    _mm_and_si128(_mm_sub_epi32(_mm_set1_epi32(frame - halfWindow), whole), _mm_set1_epi32(mask)));
+    for (int t = 0; t < 4; t++)
+        windows[t] = frames + static_cast<size_t>(starts[t]) * numChannels;
+}
+
+//------------------------------------------------------------------------
+// locateWindowsScalar with the delays of two taps per vector
+inline void locateWindowsSSE2(const double* frames, int numChannels, int mask, int frame, int halfWindow, double position,
+                              const double delay[4], const double delayStep[4], const double* windows[4], double fraction[4])
+{
+    const __m128d positions = _mm_set1_pd(position);
+    const __m128d delay01 = _mm_add_pd(_mm_loadu_pd(delay), _mm_mul_pd(positions, _mm_loadu_pd(delayStep)));
+    const __m128d delay23 = _mm_add_pd(_mm_loadu_pd(delay + 2), _mm_mul_pd(positions, _mm_loadu_pd(delayStep + 2)));
+    const __m128i whole01 = _mm_cvttpd_epi32(delay01);
+    const __m128i whole23 = _mm_cvttpd_epi32(delay23);
+    _mm_storeu_pd(fraction, _mm_sub_pd(delay01, _mm_cvtepi32_pd(whole01)));
+    _mm_storeu_pd(fraction + 2, _mm_sub_pd(delay23, _mm_cvtepi32_pd(whole23)));
+    storeWindowsSSE2(frames, numChannels, mask, frame, halfWindow, _mm_unpacklo_epi64(whole01, whole23), windows);
+}
+
+//------------------------------------------------------------------------
+void processModulatedSSE2(const double* frames, int numChannels, int mask, int writeFrame, const double delay[4],
+                          const double delayStep[4], const double feedback[4], const double gain[4], int numFrames,
+                          double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double* windows[4];
+        alignas(16) double fraction[4];
+        locateWindowsSSE2(frames, numChannels, mask, writeFrame + n, 2, n, delay, delayStep, windows, fraction);
+
+        // Mono puts the taps into the lanes, as processTapsSSE2 does
+        if (numChannels == 1)
+        {
+            processTapsSSE2(windows, fraction, feedback, gain, 1, feedbackSum + n, wetSum + n, accumulate);
+            continue;
+        }
+
+        const int frame = n * numChannels;
+        int c = 0;
+        for (; c + 2 <= numChannels; c += 2)
+            processChannelPairSSE2(windows, numChannels, c, fraction, feedback, gain, feedbackSum + frame, wetSum + frame, accumulate);
+        if (c < numChannels)
+            processChannelScalar(windows, numChannels, c, fraction, feedback, gain, feedbackSum + frame, wetSum + frame, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// Two neighbouring channels of an interleaved frame, or two consecutive mono samples with a stride of 1
+inline void processFirPairSSE2(const double* const windows[4], int stride, int offset, int numPoints, const double* coefficients,
+                               const double feedback[4], const double gain[4], double* feedbackSum, double* wetSum, bool accumulate)
+{
+    __m128d feedbackAcc = _mm_setzero_pd();
+    __m128d wetAcc = _mm_setzero_pd();
+    for (int t = 0; t < 4; t++)
+    {
+        const double* window = windows[t] + offset;
+        const double* weights = coefficients + t * kMaxInterpolationPoints;
+        __m128d y = _mm_mul_pd(_mm_set1_pd(weights[0]), _mm_loadu_pd(window));
+        for (int k = 1; k < numPoints; k++)
+            y = _mm_add_pd(y, _mm_mul_pd(_mm_set1_pd(weights[k]), _mm_loadu_pd(window + k * stride)));
+
+        __m128d feedbackSig = _mm_mul_pd(_mm_set1_pd(feedback[t]), y);
+        __m128d wetSig = _mm_mul_pd(_mm_set1_pd(gain[t]), y);
+        feedbackAcc = t == 0 ? feedbackSig : _mm_add_pd(feedbackAcc, feedbackSig);
+        wetAcc = t == 0 ? wetSig : _mm_add_pd(wetAcc, wetSig);
+    }
+    if (accumulate)
+    {
+        feedbackAcc = _mm_add_pd(_mm_loadu_pd(feedbackSum + offset), feedbackAcc);
+        wetAcc = _mm_add_pd(_mm_loadu_pd(wetSum + offset), wetAcc);
+    }
+    _mm_storeu_pd(feedbackSum + offset, feedbackAcc);
+    _mm_storeu_pd(wetSum + offset, wetAcc);
+}
+
+//------------------------------------------------------------------------
+void processFirSSE2(const double* const windows[4], int numChannels, int numPoints, const double* coefficients,
+                    const double feedback[4], const double gain[4], int numFrames, double* feedbackSum, double* wetSum,
+                    bool accumulate)
+{
+    // A mono ring has its samples side by side, so consecutive samples share the lanes
+    const int lanes = numChannels == 1 ? numFrames : numChannels;
+    const int numLoops = numChannels == 1 ? 1 : numFrames;
+    for (int n = 0; n < numLoops; n++)
+    {
+        const int frame = n * numChannels;
+        int c = 0;
+        for (; c + 2 <= lanes; c += 2)
+            processFirPairSSE2(windows, numChannels, frame + c, numPoints, coefficients, feedback, gain, feedbackSum, wetSum, accumulate);
+        if (c < lanes)
+            processFirChannelScalar(windows, numChannels, frame + c, numPoints, coefficients, feedback, gain, feedbackSum, wetSum, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+void processModulatedFirSSE2(const double* frames, int numChannels, int mask, int writeFrame, int numPoints,
+                             CoefficientFunction coefficientsAt, const double delay[4], const double delayStep[4],
+                             const double feedback[4], const double gain[4], int numFrames, double* feedbackSum,
+                             double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double* windows[4];
+        alignas(16) double fraction[4];
+        double coefficients[4 * kMaxInterpolationPoints];
+        locateWindowsSSE2(frames, numChannels, mask, writeFrame + n, numPoints / 2, n, delay, delayStep, windows, fraction);
+        for (int t = 0; t < 4; t++)
+            coefficientsAt(fraction[t], coefficients + t * kMaxInterpolationPoints);
+
+        const int frame = n * numChannels;
+        processFirSSE2(windows, numChannels, numPoints, coefficients, feedback, gain, 1, feedbackSum + frame, wetSum + frame, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// Two neighbouring channels of the allpass bank, same order of operations as the scalar filter
+inline void processAllpassPairSSE2(double* frames, int numChannels, int numFrames, double coefficient,
+                                   double* previousInput, double* previousOutput)
+{
+    const __m128d g = _mm_set1_pd(coefficient);
+    const __m128d minusG = _mm_set1_pd(-coefficient);
+    __m128d x1 = _mm_loadu_pd(previousInput);
+    __m128d y1 = _mm_loadu_pd(previousOutput);
+    for (int n = 0; n < numFrames; n++)
+    {
+        double* frame = frames + n * numChannels;
+        const __m128d x = _mm_loadu_pd(frame);
+        const __m128d y = _mm_add_pd(_mm_add_pd(_mm_mul_pd(x, minusG), x1), _mm_mul_pd(g, y1));
+        _mm_storeu_pd(frame, y);
+        x1 = x;
+        y1 = y;
+    }
+    _mm_storeu_pd(previousInput, x1);
+    _mm_storeu_pd(previousOutput, y1);
+}
+
+//------------------------------------------------------------------------
+void processAllpassSSE2(double* frames, int numChannels, int numFrames, double coefficient,
+                        double* previousInput, double* previousOutput)
+{
+    int c = 0;
+    for (; c + 2 <= numChannels; c += 2)
+        processAllpassPairSSE2(frames + c, numChannels, numFrames, coefficient, previousInput + c, previousOutput + c);
+    if (c < numChannels)
+        processAllpassChannel(frames + c, numChannels, numFrames, coefficient, previousInput[c], previousOutput[c]);
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX inline double sumInTapOrderAVX(__m256d taps)
+{
+    return sumInTapOrderSSE2(_mm256_castpd256_pd128(taps), _mm256_extractf128_pd(taps, 1));
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX void processTapsAVX(const double* const windows[4], const double fraction[4], const double feedback[4],
+                                      const double gain[4], int numSamples, double* feedbackSum, double* wetSum, bool accumulate)
+{
+    const __m256d fractions = _mm256_loadu_pd(fraction);
+    const __m256d feedbacks = _mm256_loadu_pd(feedback);
+    const __m256d gains = _mm256_loadu_pd(gain);
+
+    for (int n = 0; n < numSamples; n++)
+    {
+        // One row per tap: (v3, v2, v1, v0)
+        __m256d row0 = _mm256_loadu_pd(windows[0] + n);
+        __m256d row1 = _mm256_loadu_pd(windows[1] + n);
+        __m256d row2 = _mm256_loadu_pd(windows[2] + n);
+        __m256d row3 = _mm256_loadu_pd(windows[3] + n);
+
+        // Transpose so each vector holds the same window sample of all four taps
+        __m256d low01 = _mm256_unpacklo_pd(row0, row1);
+        __m256d high01 = _mm256_unpackhi_pd(row0, row1);
+        __m256d low23 = _mm256_unpacklo_pd(row2, row3);
+        __m256d high23 = _mm256_unpackhi_pd(row2, row3);
+        __m256d v3 = _mm256_permute2f128_pd(low01, low23, 0x20);
+        __m256d v1 = _mm256_permute2f128_pd(low01, low23, 0x31);
+        __m256d v2 = _mm256_permute2f128_pd(high01, high23, 0x20);
+        __m256d v0 = _mm256_permute2f128_pd(high01, high23, 0x31);
+
+        __m256d a = _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(v3, v2), v0), v1);
+        __m256d b = _mm256_sub_pd(_mm256_sub_pd(v0, v1), a);
+        __m256d c = _mm256_sub_pd(v2, v0);
+
+        __m256d y = _mm256_add_pd(_mm256_mul_pd(a, fractions), b);
+        y = _mm256_add_pd(_mm256_mul_pd(y, fractions), c);
+        y = _mm256_add_pd(_mm256_mul_pd(y, fractions), v1);
+
+        double feedbackSig = sumInTapOrderAVX(_mm256_mul_pd(feedbacks, y));
+        double wetSig = sumInTapOrderAVX(_mm256_mul_pd(gains, y));
+        feedbackSum[n] = accumulate ? feedbackSum[n] + feedbackSig : feedbackSig;
+        wetSum[n] = accumulate ? wetSum[n] + wetSig : wetSig;
+    }
+}
+//------------------------------------------------------------------------
+// Four neighbouring channels of an interleaved frame
+DELAY2_TARGET_AVX inline void processChannelQuadAVX(const double* const windows[4], int stride, int offset, const double fraction[4],
+                                                    const double feedback[4], const double gain[4], double* feedbackSum, double* wetSum, bool accumulate)
+{
+    __m256d feedbackAcc = _mm256_setzero_pd();
+    __m256d wetAcc = _mm256_setzero_pd();
+    for (int t = 0; t < 4; t++)
+    {
+        const double* window = windows[t] + offset;
+        __m256d v3 = _mm256_loadu_pd(window);
+        __m256d v2 = _mm256_loadu_pd(window + stride);
+        __m256d v1 = _mm256_loadu_pd(window + 2 * stride);
+        __m256d v0 = _mm256_loadu_pd(window + 3 * stride);
+        __m256d f = _mm256_set1_pd(fraction[t]);
+
+        __m256d a = _mm256_add_pd(_mm256_sub_pd(_mm256_sub_pd(v3, v2), v0), v1);
+        __m256d b = _mm256_sub_pd(_mm256_sub_pd(v0, v1), a);
+        __m256d c = _mm256_sub_pd(v2, v0);
+        __m256d y = _mm256_add_pd(_mm256_mul_pd(a, f), b);
+        y = _mm256_add_pd(_mm256_mul_pd(y, f), c);
+        y = _mm256_add_pd(_mm256_mul_pd(y, f), v1);
+
+        __m256d feedbackSig = _mm256_mul_pd(_mm256_set1_pd(feedback[t]), y);
+        __m256d wetSig = _mm256_mul_pd(_mm256_set1_pd(gain[t]), y);
+        feedbackAcc = t == 0 ? feedbackSig : _mm256_add_pd(feedbackAcc, feedbackSig);
+        wetAcc = t == 0 ? wetSig : _mm256_add_pd(wetAcc, wetSig);
+    }
+    if (accumulate)
+    {
+        feedbackAcc = _mm256_add_pd(_mm256_loadu_pd(feedbackSum + offset), feedbackAcc);
+        wetAcc = _mm256_add_pd(_mm256_loadu_pd(wetSum + offset), wetAcc);
+    }
+    _mm256_storeu_pd(feedbackSum + offset, feedbackAcc);
+    _mm256_storeu_pd(wetSum + offset, wetAcc);
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX void processFramesAVX(const double* const windows[4], int numChannels, const double fraction[4], const double feedback[4],
+                                        const double gain[4], int numFrames, double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const int frame = n * numChannels;
+        int c = 0;
+        for (; c + 4 <= numChannels; c += 4)
+            processChannelQuadAVX(windows, numChannels, frame + c, fraction, feedback, gain, feedbackSum, wetSum, accumulate);
+        if (c + 2 <= numChannels)
+        {
+            processChannelPairSSE2(windows, numChannels, frame + c, fraction, feedback, gain, feedbackSum, wetSum, accumulate);
+            c += 2;
+        }
+        if (c < numChannels)
+            processChannelScalar(windows, numChannels, frame + c, fraction, feedback, gain, feedbackSum, wetSum, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// locateWindowsScalar with all four delays in one vector
+DELAY2_TARGET_AVX inline void locateWindowsAVX(const double* frames, int numChannels, int mask, int frame, int halfWindow,
+                                               double position, const double delay[4], const double delayStep[4], const double* windows[4],
+                                               double fraction[4])
+{
+    const __m256d delays = _mm256_add_pd(_mm256_loadu_pd(delay), _mm256_mul_pd(_mm256_set1_pd(position), _mm256_loadu_pd(delayStep)));
+    const __m128i whole = _mm256_cvttpd_epi32(delays);
+    _mm256_storeu_pd(fraction, _mm256_sub_pd(delays, _mm256_cvtepi32_pd(whole)));
+    storeWindowsSSE2(frames, numChannels, mask, frame, halfWindow, whole, windows);
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX void processModulatedAVX(const double* frames, int numChannels, int mask, int writeFrame, const double delay[4],
+                                           const double delayStep[4], const double feedback[4], const double gain[4], int numFrames,
+                                           double* feedbackSum, double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double* windows[4];
+        alignas(32) double fraction[4];
+        locateWindowsAVX(frames, numChannels, mask, writeFrame + n, 2, n, delay, delayStep, windows, fraction);
+
+        if (numChannels == 1)
+        {
+            processTapsAVX(windows, fraction, feedback, gain, 1, feedbackSum + n, wetSum + n, accumulate);
+            continue;
+        }
+
+        const int frame = n * numChannels;
+        int c = 0;
+        for (; c + 4 <= numChannels; c += 4)
+            processChannelQuadAVX(windows, numChannels, c, fraction, feedback, gain, feedbackSum + frame, wetSum + frame, accumulate);
+        if (c + 2 <= numChannels)
+        {
+            processChannelPairSSE2(windows, numChannels, c, fraction, feedback, gain, feedbackSum + frame, wetSum + frame, accumulate);
+            c += 2;
+        }
+        if (c < numChannels)
+            processChannelScalar(windows, numChannels, c, fraction, feedback, gain, feedbackSum + frame, wetSum + frame, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+// Four neighbouring channels of an interleaved frame, or four consecutive mono samples with a stride of 1
+DELAY2_TARGET_AVX inline void processFirQuadAVX(const double* const windows[4], int stride, int offset, int numPoints,
+                                                const double* coefficients, const double feedback[4], const double gain[4],
+                                                double* feedbackSum, double* wetSum, bool accumulate)
+{
+    __m256d feedbackAcc = _mm256_setzero_pd();
+    __m256d wetAcc = _mm256_setzero_pd();
+    for (int t = 0; t < 4; t++)
+    {
+        const double* window = windows[t] + offset;
+        const double* weights = coefficients + t * kMaxInterpolationPoints;
+        __m256d y = _mm256_mul_pd(_mm256_set1_pd(weights[0]), _mm256_loadu_pd(window));
+        for (int k = 1; k < numPoints; k++)
+            y = _mm256_add_pd(y, _mm256_mul_pd(_mm256_set1_pd(weights[k]), _mm256_loadu_pd(window + k * stride)));
+
+        __m256d feedbackSig = _mm256_mul_pd(_mm256_set1_pd(feedback[t]), y);
+        __m256d wetSig = _mm256_mul_pd(_mm256_set1_pd(gain[t]), y);
+        feedbackAcc = t == 0 ? feedbackSig : _mm256_add_pd(feedbackAcc, feedbackSig);
+        wetAcc = t == 0 ? wetSig : _mm256_add_pd(wetAcc, wetSig);
+    }
+    if (accumulate)
+    {
+        feedbackAcc = _mm256_add_pd(_mm256_loadu_pd(feedbackSum + offset), feedbackAcc);
+        wetAcc = _mm256_add_pd(_mm256_loadu_pd(wetSum + offset), wetAcc);
+    }
+    _mm256_storeu_pd(feedbackSum + offset, feedbackAcc);
+    _mm256_storeu_pd(wetSum + offset, wetAcc);
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX void processFirAVX(const double* const windows[4], int numChannels, int numPoints, const double* coefficients,
+                                     const double feedback[4], const double gain[4], int numFrames, double* feedbackSum,
+                                     double* wetSum, bool accumulate)
+{
+    const int lanes = numChannels == 1 ? numFrames : numChannels;
+    const int numLoops = numChannels == 1 ? 1 : numFrames;
+    for (int n = 0; n < numLoops; n++)
+    {
+        const int frame = n * numChannels;
+        int c = 0;
+        for (; c + 4 <= lanes; c += 4)
+            processFirQuadAVX(windows, numChannels, frame + c, numPoints, coefficients, feedback, gain, feedbackSum, wetSum, accumulate);
+        if (c + 2 <= lanes)
+        {
+            processFirPairSSE2(windows, numChannels, frame + c, numPoints, coefficients, feedback, gain, feedbackSum, wetSum, accumulate);
+            c += 2;
+        }
+        if (c < lanes)
+            processFirChannelScalar(windows, numChannels, frame + c, numPoints, coefficients, feedback, gain, feedbackSum, wetSum, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX void processModulatedFirAVX(const double* frames, int numChannels, int mask, int writeFrame, int numPoints,
+                                              CoefficientFunction coefficientsAt, const double delay[4], const double delayStep[4],
+                                              const double feedback[4], const double gain[4], int numFrames, double* feedbackSum,
+                                              double* wetSum, bool accumulate)
+{
+    for (int n = 0; n < numFrames; n++)
+    {
+        const double* windows[4];
+        alignas(32) double fraction[4];
+        double coefficients[4 * kMaxInterpolationPoints];
+        locateWindowsAVX(frames, numChannels, mask, writeFrame + n, numPoints / 2, n, delay, delayStep, windows, fraction);
+        for (int t = 0; t < 4; t++)
+            coefficientsAt(fraction[t], coefficients + t * kMaxInterpolationPoints);
+
+        const int frame = n * numChannels;
+        processFirAVX(windows, numChannels, numPoints, coefficients, feedback, gain, 1, feedbackSum + frame, wetSum + frame, accumulate);
+    }
+}
+
+//------------------------------------------------------------------------
+DELAY2_TARGET_AVX void processAllpassAVX(double* frames, int numChannels, int numFrames, double coefficient,
+                                         double* previousInput, double* previousOutput)
+{
+    int c = 0;
+    for (; c + 4 <= numChannels; c += 4)
+    {
+        const __m256d g = _mm256_set1_pd(coefficient);
+        const __m256d minusG = _mm256_set1_pd(-coefficient);
+        __m256d x1 = _mm256_loadu_pd(previousInput + c);
+        __m256d y1 = _mm256_loadu_pd(previousOutput + c);
+        for (int n = 0; n < numFrames; n++)
+        {
+            double* frame = frames + n * numChannels + c;
+            const __m256d x = _mm256_loadu_pd(frame);
+            const __m256d y = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(x, minusG), x1), _mm256_mul_pd(g, y1));
+            _mm256_storeu_pd(frame, y);
+            x1 = x;
+            y1 = y;
+        }
+        _mm256_storeu_pd(previousInput + c, x1);
+        _mm256_storeu_pd(previousOutput + c, y1);
+    }
+    if (c + 2 <= numChannels)
+    {
+        processAllpassPairSSE2(frames + c, numChannels, numFrames, coefficient, previousInput + c, previousOutput + c);
+        c += 2;
+    }
+    if (c < numChannels)
+        processAllpassChannel(frames + c, numChannels, numFrames, coefficient, previousInput[c], previousOutput[c]);
+}
+#endif
+
+} // namespace
+
+//------------------------------------------------------------------------
+SimdLevel detectSimdLevel()
+{
+#if DELAY2_X86_SIMD
+    // SSE2 is part of x86-64, AVX also needs the OS to save the YMM registers
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 1);
+    bool osSavesYmm = (info[2] & (1 << 27)) != 0 && (_xgetbv(0) & 0x6) == 0x6;
+    if (osSavesYmm && (info[2] & (1 << 28)) != 0)
+        return SimdLevel::kAVX;
+#else
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx"))
+        return SimdLevel::kAVX;
+#endif
+    return SimdLevel::kSSE2;
+#else
+    return SimdLevel::kScalar;
+#endif
+}
+
+//------------------------------------------------------------------------
+TapKernel getTapKernel(SimdLevel level)
+{
+#if DELAY2_X86_SIMD
+    switch (level)
+    {
+        case SimdLevel::kAVX:
+            return processTapsAVX;
+        case SimdLevel::kSSE2:
+            return processTapsSSE2;
+        default:
+            break;
+    }
+#endif
+    (void)level;
+    return processTapsScalar;
+}
+
+//------------------------------------------------------------------------
+FrameKernel getFrameKernel(SimdLevel level)
+{
+#if DELAY2_X86_SIMD
+    switch (level)
+    {
+        case SimdLevel::kAVX:
+            return processFramesAVX;
+        case SimdLevel::kSSE2:
+            return processFramesSSE2;
+        default:
+            break;
+    }
+#endif
+    (void)level;
+    return processFramesScalar;
+}
+
+//------------------------------------------------------------------------
+ModulatedKernel getModulatedKernel(SimdLevel level)
+{
+#if DELAY2_X86_SIMD
+    switch (level)
+    {
+        case SimdLevel::kAVX:
+            return processModulatedAVX;
+        case SimdLevel::kSSE2:
+            return processModulatedSSE2;
+        default:
+            break;
+    }
+#endif
+    (void)level;
+    return processModulatedScalar;
+}
+
+//------------------------------------------------------------------------
+FirKernel getFirKernel(SimdLevel level)
+{
+#if DELAY2_X86_SIMD
+    switch (level)
+    {
+        case SimdLevel::kAVX:
+            return processFirAVX;
+        case SimdLevel::kSSE2:
+            return processFirSSE2;
+        default:
+            break;
+    }
+#endif
+    (void)level;
+    return processFirScalar;
+}
+
+//------------------------------------------------------------------------
+ModulatedFirKernel getModulatedFirKernel(SimdLevel level)
+{
+#if DELAY2_X86_SIMD
+    switch (level)
+    {
+        case SimdLevel::kAVX:
+            return processModulatedFirAVX;
+        case SimdLevel::kSSE2:
+            return processModulatedFirSSE2;
+        default:
+            break;
+    }
+#endif
+    (void)level;
+    return processModulatedFirScalar;
+}
+
+//------------------------------------------------------------------------
+AllpassKernel getAllpassKernel(SimdLevel level)
+{
+#if DELAY2_X86_SIMD
+    switch (level)
+    {
+        case SimdLevel::kAVX:
+            return processAllpassAVX;
+        case SimdLevel::kSSE2:
+            return processAllpassSSE2;
+        default:
+            break;
+    }
+#endif
+    (void)level;
+    return processAllpassScalar;
+}
@@ -0,0 +1,147 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Four tap interpolation and allpass kernels with runtime CPU dispatch.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "interpolation.hpp"
+
+//------------------------------------------------------------------------
+//  Tap kernels
+//------------------------------------------------------------------------
+// Every kernel evaluates the cubic interpolation of all four taps of a
+// sample at once, followed by the four feedback and four gain products.
+// Tap kernels put the four taps of one channel into the SIMD lanes, frame
+// kernels work on interleaved frames and put the channels into the lanes.
+// The vector versions keep the scalar order of operations (no fused
+// multiply-add, sums added tap 1 to tap 4), so all of them produce the
+// same output bit for bit.
+//
+// Larger tap sets are run four taps at a time, every group after the first
+// adding to the sums of the groups before it.
+//
+// Modulated kernels read taps whose delay moves from sample to sample, so
+// every sample has its own window and fraction. Those are worked out for
+// the four taps at once in the SIMD lanes before the interpolation, which
+// then runs like the kernels above.
+//
+// The other interpolation modes go through the FIR kernels, which weigh
+// an N point window with coefficients worked out beforehand. A mono ring
+// puts consecutive samples into the lanes there, interleaved frames put
+// their channels into them.
+
+// Instruction sets a kernel is available for
+enum class SimdLevel
+{
+    kScalar,
+    kSSE2,  // two taps per vector
+    kAVX    // all four taps in one vector
+};
+
+// windows[t] points at the oldest sample of tap t's first 4 sample window,
+// the window of each following sample starts one sample later.
+// Writes the summed feedback and wet contributions of the taps for every sample,
+// or adds them to the sums already there if 'accumulate' is set.
+typedef void (*TapKernel)(const double* const windows[4],
+                          const double fraction[4],
+                          const double feedback[4],
+                          const double gain[4],
+                          int numSamples,
+                          double* feedbackSum,
+                          double* wetSum,
+                          bool accumulate);
+
+// Interleaved variant: windows[t] points at the oldest frame of tap t's first 4 frame
+// window, the window of each following frame starts one frame later. The sums are
+// written interleaved as well, one value per channel and frame.
+typedef void (*FrameKernel)(const double* const windows[4],
+                            int numChannels,
+                            const double fraction[4],
+                            const double feedback[4],
+                            const double gain[4],
+                            int numFrames,
+                            double* feedbackSum,
+                            double* wetSum,
+                            bool accumulate);
+
+// First order allpass over interleaved frames, one filter per channel, in place:
+// y = -g * x + x1 + g * y1. The state arrays hold x1 and y1 of every channel and
+// carry them to the next call. The channels go into the SIMD lanes, so a frame
+// of up to four channels is one vector step.
+typedef void (*AllpassKernel)(double* frames,
+                              int numChannels,
+                              int numFrames,
+                              double coefficient,
+                              double* previousInput,
+                              double* previousOutput);
+
+// Moving taps over interleaved frames, a mono buffer being one channel per frame.
+// Tap t is delay[t] + n * delayStep[t] frames behind frame writeFrame + n, where the
+// output of sample n is written, and never less than 1. 'mask' wraps frame numbers
+// into the ring at 'frames' (its capacity, a power of two, minus one), whose guard
+// frames keep each window contiguous. Sums are written or accumulated as above.
+typedef void (*ModulatedKernel)(const double* frames,
+                                int numChannels,
+                                int mask,
+                                int writeFrame,
+                                const double delay[4],
+                                const double delayStep[4],
+                                const double feedback[4],
+                                const double gain[4],
+                                int numFrames,
+                                double* feedbackSum,
+                                double* wetSum,
+                                bool accumulate);
+
+// Interpolation modes other than cubic: windows[t] points at the oldest frame of tap t's
+// first 'numPoints' frame window, and coefficients + t * kMaxInterpolationPoints holds
+// the weights of that window. Sums as for the frame kernel.
+typedef void (*FirKernel)(const double* const windows[4],
+                          int numChannels,
+                          int numPoints,
+                          const double* coefficients,
+                          const double feedback[4],
+                          const double gain[4],
+                          int numFrames,
+                          double* feedbackSum,
+                          double* wetSum,
+                          bool accumulate);
+
+// Moving taps in the other interpolation modes: as the modulated kernel, with each window
+// numPoints frames wide and weighted by 'coefficientsAt' for its fraction
+typedef void (*ModulatedFirKernel)(const double* frames,
+                                   int numChannels,
+                                   int mask,
+                                   int writeFrame,
+                                   int numPoints,
+                                   CoefficientFunction coefficientsAt,
+                                   const double delay[4],
+                                   const double delayStep[4],
+                                   const double feedback[4],
+                                   const double gain[4],
+                                   int numFrames,
+                                   double* feedbackSum,
+                                   double* wetSum,
+                                   bool accumulate);
+
+/** Best instruction set supported by the CPU we are running on */
+SimdLevel detectSimdLevel();
+
+/** Kernel for the given level, falls back to the scalar one if it is not compiled in */
+TapKernel getTapKernel(SimdLevel level);
+
+/** Interleaved kernel for the given level, falls back to the scalar one if it is not compiled in */
+FrameKernel getFrameKernel(SimdLevel level);
+
+/** Modulated kernel for the given level, falls back to the scalar one if it is not compiled in */
+ModulatedKernel getModulatedKernel(SimdLevel level);
+
+/** FIR kernel for the given level, falls back to the scalar one if it is not compiled in */
+FirKernel getFirKernel(SimdLevel level);
+
+/** Modulated FIR kernel for the given level, falls back to the scalar one if it is not compiled in */
+ModulatedFirKernel getModulatedFirKernel(SimdLevel level);
+
+/** Allpass kernel for the given level, falls back to the scalar one if it is not compiled in */
+AllpassKernel getAllpassKernel(SimdLevel level);
@@ -0,0 +1,27 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Table lookup LFO for the tap time modulation.
+//------------------------------------------------------------------------
+
+#include "wavetableLfo.hpp"
+#include <cmath>
+
+double WavetableLfo::sTables[kNumShapes][kTableSize + 1];
+const bool WavetableLfo::sTablesBuilt = WavetableLfo::buildTables();
+
+//------------------------------------------------------------------------
+bool WavetableLfo::buildTables()
+{
+    // Both shapes start at 0 heading up, so switching shapes does not jump at phase 0
+    const double pi = 3.14159265358979323846;
+    for (int i = 0; i <= kTableSize; i++)
+    {
+        const double phase = static_cast<double>(i) / kTableSize;
+        sTables[kSine][i] = std::sin(2.0 * pi * phase);
+
+        // 0 -> 1 -> -1 -> 0 over a cycle
+        const double rising = phase < 0.25 ? phase : (phase < 0.75 ? 0.5 - phase : phase - 1.0);
+        sTables[kTriangle][i] = 4.0 * rising;
+    }
+    return true;
+}
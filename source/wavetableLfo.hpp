@@ -0,0 +1,95 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Table lookup LFO for the tap time modulation.
+//------------------------------------------------------------------------
+
+#pragma once
+
+//------------------------------------------------------------------------
+//  WavetableLfo
+//------------------------------------------------------------------------
+// One cycle of each shape is stored in a shared table and read with
+// linear interpolation, so a value costs a multiply, a truncation and a
+// lerp instead of a call to sin().
+//
+// The LFO is not run per sample. Time is split into intervals (the engine
+// uses its control interval), and only the values at both ends of the
+// current interval are looked up. The caller ramps linearly in between.
+// Rate and shape changes are picked up at the next interval, so the ramp
+// of the current one never bends halfway.
+class WavetableLfo
+{
+public:
+    enum Shape
+    {
+        kSine,
+        kTriangle,
+        kNumShapes
+    };
+
+    // Table points per cycle, one more is stored so the lerp never wraps
+    static const int kTableSize = 1024;
+
+    WavetableLfo() : m_Phase(0.0), m_Increment(0.0), m_NextIncrement(0.0),
+                     m_IntervalLength(0), m_Shape(kSine), m_NextShape(kSine) {}
+
+    /** Cycles per sample and shape, both taking effect at the next interval */
+    void setRate(double cyclesPerSample) { m_NextIncrement = cyclesPerSample; }
+    void setShape(Shape shape) { m_NextShape = shape; }
+
+    /** Back to phase 0 with the latest rate and shape, no interval started */
+    void reset()
+    {
+        m_Phase = 0.0;
+        m_Increment = m_NextIncrement;
+        m_Shape = m_NextShape;
+        m_IntervalLength = 0;
+    }
+
+    /** Moves the phase past the current interval and starts one of 'length' samples */
+    void nextInterval(int length)
+    {
+        m_Phase += m_IntervalLength * m_Increment;
+        m_Phase -= static_cast<int>(m_Phase);
+        m_Increment = m_NextIncrement;
+        m_Shape = m_NextShape;
+        m_IntervalLength = length;
+    }
+
+    int getIntervalLength() const { return m_IntervalLength; }
+
+    /** Value from -1 to 1 at the start of the current interval, 'phaseOffset' cycles ahead */
+    double getStartValue(double phaseOffset) const { return lookup(m_Shape, m_Phase + phaseOffset); }
+
+    /** Value at the end of the current interval, where the next one starts */
+    double getEndValue(double phaseOffset) const
+    {
+        return lookup(m_Shape, m_Phase + phaseOffset + m_IntervalLength * m_Increment);
+    }
+
+    /** Interpolated table value of 'shape' at 'phase' cycles, phase >= 0 */
+    static double lookup(Shape shape, double phase)
+    {
+        const double position = (phase - static_cast<int>(phase)) * kTableSize;
+        const int index = static_cast<int>(position);
+        const double* point = sTables[shape] + index;
+        return point[0] + (position - index) * (point[1] - point[0]);
+    }
+
+private:
+    // Cycle start of the current interval, 0 to 1
+    double m_Phase;
+
+    // Cycles per sample of the current interval and of the next one
+    double m_Increment;
+    double m_NextIncrement;
+
+    int m_IntervalLength;
+    Shape m_Shape;
+    Shape m_NextShape;
+
+    // Filled once at static initialisation, before any engine runs
+    static double sTables[kNumShapes][kTableSize + 1];
+    static bool buildTables();
+    static const bool sTablesBuilt;
+};
@@ -0,0 +1,120 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Parameter lookup and automation files for the command-line tools.
+//------------------------------------------------------------------------
+
+#include "automation.hpp"
+#include "parameters.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// Lower case letters and digits only, so titles and typed names compare equal
+std::string simplifyName(const std::string& name)
+{
+    std::string simple;
+    for (char c : name)
+    {
+        if (std::isalnum(static_cast<unsigned char>(c)))
+            simple += static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+    }
+    return simple;
+}
+
+std::string simplifyTitle(const char16_t* title)
+{
+    std::string ascii;
+    for (; *title != 0; title++)
+        ascii += *title < 0x80 ? static_cast<char>(*title) : ' ';
+    return simplifyName(ascii);
+}
+
+bool parseNormalised(const std::string& text, double& value)
+{
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return !text.empty() && *end == 0 && value >= 0.0 && value <= 1.0;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int findParameter(const std::string& name)
+{
+    char* end = nullptr;
+    const unsigned long id = std::strtoul(name.c_str(), &end, 10);
+    if (!name.empty() && *end == 0)
+        return getParamIndex(static_cast<uint32_t>(id));
+
+    const std::string simple = simplifyName(name);
+    for (int i = 0; i < kNumParams; i++)
+    {
+        if (simplifyTitle(kParamDescriptors[i].title) == simple)
+            return i;
+    }
+    return -1;
+}
+
+//------------------------------------------------------------------------
+bool parseParameterAssignment(const std::string& text, int& index, double& value)
+{
+    const size_t equals = text.find('=');
+    if (equals == std::string::npos)
+        return false;
+    index = findParameter(text.substr(0, equals));
+    return index >= 0 && parseNormalised(text.substr(equals + 1), value);
+}
+
+//------------------------------------------------------------------------
+bool loadAutomation(const char* path, double sampleRate, std::vector<ParameterEvent>& events, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+
+    events.clear();
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream fields(line);
+        std::string time, name, value;
+        if (!(fields >> time))
+            continue;
+
+        ParameterEvent event;
+        double seconds = 0.0;
+        char* end = nullptr;
+        seconds = std::strtod(time.c_str(), &end);
+        std::string rest;
+        if (*end != 0 || seconds < 0.0 || !(fields >> name >> value) || (fields >> rest))
+        {
+            error = std::string(path) + ":" + std::to_string(lineNumber) + ": expected <seconds> <parameter> <value>";
+            return false;
+        }
+        event.frame = static_cast<int64_t>(std::llround(seconds * sampleRate));
+        event.index = findParameter(name);
+        if (event.index < 0 || !parseNormalised(value, event.value))
+        {
+            error = std::string(path) + ":" + std::to_string(lineNumber) + ": unknown parameter or value outside 0..1";
+            return false;
+        }
+        events.push_back(event);
+    }
+
+    // Events at the same frame keep their file order
+    std::stable_sort(events.begin(), events.end(),
+                     [](const ParameterEvent& a, const ParameterEvent& b) { return a.frame < b.frame; });
+    return true;
+}
@@ -0,0 +1,30 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Parameter lookup and automation files for the command-line tools.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// A normalised parameter value taking effect at a frame of the render
+struct ParameterEvent
+{
+    int64_t frame;
+    int index;   // dense parameter index, see getParamIndex
+    double value;
+};
+
+/** Dense index of a parameter named by its ID or its title, where the title is matched
+    ignoring case, spaces and dashes ("104", "Wet Mix", "wet-mix"). -1 if none matches. */
+int findParameter(const std::string& name);
+
+/** Parses "<parameter>=<normalised value>", returns false if either part is invalid */
+bool parseParameterAssignment(const std::string& text, int& index, double& value);
+
+/** Reads an automation file into 'events', sorted by frame. Each line holds
+    "<seconds> <parameter> <normalised value>"; '#' starts a comment. On failure
+    'error' says which line is wrong. */
+bool loadAutomation(const char* path, double sampleRate, std::vector<ParameterEvent>& events, std::string& error);
@@ -0,0 +1,564 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Batch renderer: runs a manifest of render jobs over a pool of workers.
+//------------------------------------------------------------------------
+
+#include "automation.hpp"
+#include "delayEngine.hpp"
+#include "multiChannelBuffer.hpp"
+#include "renderSession.hpp"
+#include "wavFile.hpp"
+#include "workStealingPool.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+const int kDefaultBlockSize = 512;
+const int kMaxBlockSize = 1 << 16;
+
+// Upper bound for --tail auto when the feedback never dies away
+const double kMaxAutoTail = 60.0;
+
+// Frames handed between the disk threads and the engine at a time, rounded up to whole blocks
+const int kChunkFrames = 1 << 15;
+
+// Chunks per direction: one on disk, one in the engine and one spare to even out hiccups
+const int kChunksInFlight = 3;
+
+// One manifest line
+struct Job
+{
+    std::string inputPath;
+    std::string outputPath;
+    std::vector<ParameterEvent> parameters;
+};
+
+struct Options
+{
+    const char* manifestPath = nullptr;
+    const char* format = nullptr;
+    int numThreads = 0;
+    int blockSize = kDefaultBlockSize;
+    double maxDelay = DelayEngine::kDefaultMaxDelay;
+    double tempo = DelayEngine::kDefaultTempo;
+    double tailSeconds = 0.0;
+    bool autoTail = false;
+    bool convolution = false;
+    int rateReduction = 1;
+    bool quiet = false;
+};
+
+// Outcome of one job
+struct JobResult
+{
+    bool passed = false;
+    double audioSeconds = 0.0;
+    double processSeconds = 0.0;
+    std::string message;
+};
+
+//------------------------------------------------------------------------
+// Planar audio travelling between a worker and its disk threads
+struct Chunk
+{
+    std::vector<float> memory;
+    float* channels[MultiChannelBuffer::kMaxChannels];
+    int numFrames = 0;
+
+    // Only grows, so a worker allocates once for the widest file it sees
+    void setLayout(int numChannels, int capacity)
+    {
+        const size_t size = static_cast<size_t>(numChannels) * capacity;
+        if (memory.size() < size)
+            memory.resize(size);
+        for (int c = 0; c < numChannels; c++)
+            channels[c] = &memory[static_cast<size_t>(c) * capacity];
+        numFrames = 0;
+    }
+};
+
+// Blocking hand-over of chunks between two threads, nullptr marks the end of a stream
+class ChunkQueue
+{
+public:
+    void push(Chunk* chunk)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_Mutex);
+            m_Chunks.push_back(chunk);
+        }
+        m_Ready.notify_one();
+    }
+
+    Chunk* pop()
+    {
+        std::unique_lock<std::mutex> lock(m_Mutex);
+        m_Ready.wait(lock, [this] { return !m_Chunks.empty(); });
+        Chunk* chunk = m_Chunks.front();
+        m_Chunks.pop_front();
+        return chunk;
+    }
+
+private:
+    std::mutex m_Mutex;
+    std::condition_variable m_Ready;
+    std::deque<Chunk*> m_Chunks;
+};
+
+//------------------------------------------------------------------------
+// What a worker keeps from one job to the next: the engine with its delay memory and the chunks
+struct Worker
+{
+    RenderSession session;
+    Chunk inputChunks[kChunksInFlight];
+    Chunk outputChunks[kChunksInFlight];
+    ChunkQueue freeInputs;
+    ChunkQueue filledInputs;
+    ChunkQueue freeOutputs;
+    ChunkQueue filledOutputs;
+};
+
+//------------------------------------------------------------------------
+// Renders one job. A reader thread decodes the input ahead of the engine and a writer
+// thread encodes the output behind it, so the worker itself only runs the DSP.
+JobResult renderJob(Worker& worker, const Job& job, const Options& options)
+{
+    JobResult result;
+    WavReader reader;
+    const char* error = nullptr;
+    if (!reader.open(job.inputPath.c_str(), error))
+    {
+        result.message = job.inputPath + ": " + error;
+        return result;
+    }
+    const WavFormat inputFormat = reader.getFormat();
+    const int numChannels = inputFormat.numChannels;
+    const double sampleRate = inputFormat.sampleRate;
+
+    RenderSettings settings;
+    settings.parameters = job.parameters;
+    settings.blockSize = options.blockSize;
+    settings.maxDelay = options.maxDelay;
+    settings.tempo = options.tempo;
+    settings.tailSeconds = options.tailSeconds;
+    settings.autoTail = options.autoTail;
+    settings.convolution = options.convolution;
+    settings.rateReduction = options.rateReduction;
+    if (!worker.session.start(settings, numChannels, sampleRate, result.message))
+    {
+        result.message = job.inputPath + ": " + result.message;
+        return result;
+    }
+
+    WavFormat outputFormat = inputFormat;
+    if (options.format != nullptr)
+        parseSampleFormat(options.format, outputFormat);
+    WavWriter writer;
+    if (!writer.open(job.outputPath.c_str(), outputFormat))
+    {
+        result.message = job.outputPath + ": cannot create file";
+        return result;
+    }
+
+    // Chunks start on block boundaries, so the engine sees the same blocks as delay2-render
+    const int blockSize = options.blockSize;
+    const int chunkFrames = (kChunkFrames + blockSize - 1) / blockSize * blockSize;
+    for (int i = 0; i < kChunksInFlight; i++)
+    {
+        worker.inputChunks[i].setLayout(numChannels, chunkFrames);
+        worker.outputChunks[i].setLayout(numChannels, chunkFrames);
+        worker.freeInputs.push(&worker.inputChunks[i]);
+        worker.freeOutputs.push(&worker.outputChunks[i]);
+    }
+
+    std::atomic<bool> stopReading(false);
+    std::thread readThread([&] {
+        while (true)
+        {
+            Chunk* chunk = worker.freeInputs.pop();
+            chunk->numFrames = stopReading ? 0 : reader.read(chunk->channels, chunkFrames);
+            if (chunk->numFrames == 0)
+            {
+                worker.freeInputs.push(chunk);
+                worker.filledInputs.push(nullptr);
+                return;
+            }
+            worker.filledInputs.push(chunk);
+        }
+    });
+
+    std::atomic<bool> writeFailed(false);
+    std::thread writeThread([&] {
+        while (Chunk* chunk = worker.filledOutputs.pop())
+        {
+            if (!writeFailed && !writer.write(chunk->channels, chunk->numFrames))
+                writeFailed = true;
+            worker.freeOutputs.push(chunk);
+        }
+    });
+
+    const int64_t inputFrames = reader.getNumFrames();
+    const int64_t totalFrames = inputFrames + static_cast<int64_t>(settings.tailSeconds * sampleRate);
+    bool inputEnded = false;
+    Chunk* silence = nullptr;
+    int64_t position = 0;
+    while (position < totalFrames && !writeFailed)
+    {
+        // Past the input the engine renders the tail from a zeroed chunk
+        Chunk* input = nullptr;
+        if (!inputEnded)
+        {
+            input = worker.filledInputs.pop();
+            inputEnded = input == nullptr;
+            if (inputEnded && position < inputFrames)
+            {
+                result.message = job.inputPath + ": input ended early";
+                break;
+            }
+        }
+        if (input == nullptr)
+        {
+            if (silence == nullptr)
+            {
+                silence = worker.freeInputs.pop();
+                for (int c = 0; c < numChannels; c++)
+                    std::fill(silence->channels[c], silence->channels[c] + chunkFrames, 0.0f);
+            }
+            input = silence;
+        }
+
+        const int numFrames = static_cast<int>(std::min<int64_t>(chunkFrames, totalFrames - position));
+        if (input != silence)
+        {
+            for (int c = 0; c < numChannels; c++)
+                std::fill(input->channels[c] + input->numFrames, input->channels[c] + numFrames, 0.0f);
+        }
+
+        Chunk* output = worker.freeOutputs.pop();
+        int done = 0;
+        bool tailEnded = false;
+        while (done < numFrames)
+        {
+            // An automatic tail ends at the first block boundary after the feedback has died away
+            if (settings.autoTail && position + done >= inputFrames && worker.session.isTailSilent())
+            {
+                tailEnded = true;
+                break;
+            }
+            const int blockFrames = std::min(blockSize, numFrames - done);
+            const float* blockInputs[MultiChannelBuffer::kMaxChannels];
+            float* blockOutputs[MultiChannelBuffer::kMaxChannels];
+            for (int c = 0; c < numChannels; c++)
+            {
+                blockInputs[c] = input->channels[c] + done;
+                blockOutputs[c] = output->channels[c] + done;
+            }
+            worker.session.process(blockInputs, blockOutputs, blockFrames);
+            done += blockFrames;
+        }
+
+        output->numFrames = done;
+        worker.filledOutputs.push(output);
+        if (input != silence)
+            worker.freeInputs.push(input);
+        position += done;
+        if (tailEnded)
+            break;
+    }
+
+    // Let the writer finish, then stop the reader and take back whatever it decoded ahead
+    if (silence != nullptr)
+        worker.freeInputs.push(silence);
+    worker.filledOutputs.push(nullptr);
+    writeThread.join();
+    stopReading = true;
+    while (!inputEnded)
+    {
+        Chunk* chunk = worker.filledInputs.pop();
+        inputEnded = chunk == nullptr;
+        if (!inputEnded)
+            worker.freeInputs.push(chunk);
+    }
+    readThread.join();
+
+    // Leave the queues empty for the next job
+    for (int i = 0; i < kChunksInFlight; i++)
+    {
+        worker.freeInputs.pop();
+        worker.freeOutputs.pop();
+    }
+
+    const bool closed = writer.close();
+    if (result.message.empty() && (writeFailed || !closed))
+        result.message = job.outputPath + ": write failed";
+    result.passed = result.message.empty();
+    result.audioSeconds = position / sampleRate;
+    result.processSeconds = worker.session.getProcessSeconds();
+    return result;
+}
+
+//------------------------------------------------------------------------
+// Splits a manifest line into whitespace separated fields, "double quotes" keep spaces in paths
+bool splitFields(const std::string& line, std::vector<std::string>& fields)
+{
+    fields.clear();
+    size_t i = 0;
+    while (i < line.size())
+    {
+        if (line[i] == ' ' || line[i] == '\t' || line[i] == '\r')
+        {
+            i++;
+            continue;
+        }
+        if (line[i] == '#')
+            break;
+
+        std::string field;
+        if (line[i] == '"')
+        {
+            const size_t close = line.find('"', i + 1);
+            if (close == std::string::npos)
+                return false;
+            field = line.substr(i + 1, close - i - 1);
+            i = close + 1;
+        }
+        else
+        {
+            while (i < line.size() && line[i] != ' ' && line[i] != '\t' && line[i] != '\r')
+                field += line[i++];
+        }
+        fields.push_back(field);
+    }
+    return true;
+}
+
+// Relative paths in a manifest are relative to the manifest itself
+std::string resolvePath(const std::string& directory, const std::string& path)
+{
+    const bool absolute = (!path.empty() && (path[0] == '/' || path[0] == '\\'))
+                       || (path.size() > 1 && path[1] == ':');
+    return absolute || directory.empty() ? path : directory + "/" + path;
+}
+
+bool loadJobs(const char* path, std::vector<Job>& jobs, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = std::string("cannot open ") + path;
+        return false;
+    }
+    const std::string manifest = path;
+    const size_t slash = manifest.find_last_of("/\\");
+    const std::string directory = slash == std::string::npos ? std::string() : manifest.substr(0, slash);
+
+    std::string line;
+    std::vector<std::string> fields;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        const std::string where = manifest + ":" + std::to_string(lineNumber) + ": ";
+        if (!splitFields(line, fields))
+        {
+            error = where + "unterminated quote";
+            return false;
+        }
+        if (fields.empty())
+            continue;
+        if (fields.size() < 2)
+        {
+            error = where + "expected <input.wav> <output.wav> [name=value...]";
+            return false;
+        }
+
+        Job job;
+        job.inputPath = resolvePath(directory, fields[0]);
+        job.outputPath = resolvePath(directory, fields[1]);
+        for (size_t f = 2; f < fields.size(); f++)
+        {
+            ParameterEvent parameter = { 0, -1, 0.0 };
+            if (!parseParameterAssignment(fields[f], parameter.index, parameter.value))
+            {
+                error = where + "invalid parameter setting '" + fields[f] + "'";
+                return false;
+            }
+            job.parameters.push_back(parameter);
+        }
+        jobs.push_back(job);
+    }
+    return true;
+}
+
+// Input size decides the order jobs are handed out in, a missing file simply goes last
+int64_t getFileSize(const std::string& path)
+{
+    std::ifstream file(path, std::ios::binary | std::ios::ate);
+    return file ? static_cast<int64_t>(file.tellg()) : 0;
+}
+
+void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: delay2-batch [options] <manifest>\n"
+        "  The manifest has one job per line: <input.wav> <output.wav> [name=value...],\n"
+        "  paths relative to the manifest, \"quoted\" if they contain spaces, '#' comments.\n"
+        "  --threads <count>        workers, default one per hardware thread\n"
+        "  --block <frames>         block size, default %d\n"
+        "  --max-delay <seconds>    tap 1 range, default %g\n"
+        "  --tempo <bpm>            tempo the synced tap times follow, default %g\n"
+        "  --tail <seconds|auto>    keep rendering after the input ends, auto stops once\n"
+        "                           the delay memory is silent (at most %g s)\n"
+        "  --convolution            let settled dense tap setups run as FFT convolution\n"
+        "  --eco <factor>           run the taps at 1/2 or 1/4 of the sample rate, 2 or 4\n"
+        "  --format <format>        pcm16, pcm24, pcm32, float32 or float64, default as input\n"
+        "  --quiet                  only report failed jobs and the summary\n",
+        kDefaultBlockSize, DelayEngine::kDefaultMaxDelay, DelayEngine::kDefaultTempo, kMaxAutoTail);
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--threads" && hasValue)
+            options.numThreads = std::atoi(argv[++i]);
+        else if (arg == "--block" && hasValue)
+            options.blockSize = std::atoi(argv[++i]);
+        else if (arg == "--max-delay" && hasValue)
+            options.maxDelay = std::atof(argv[++i]);
+        else if (arg == "--tempo" && hasValue)
+            options.tempo = std::atof(argv[++i]);
+        else if (arg == "--tail" && hasValue)
+        {
+            options.autoTail = std::strcmp(argv[++i], "auto") == 0;
+            options.tailSeconds = options.autoTail ? kMaxAutoTail : std::atof(argv[i]);
+        }
+        else if (arg == "--convolution")
+            options.convolution = true;
+        else if (arg == "--eco" && hasValue)
+            options.rateReduction = std::atoi(argv[++i]);
+        else if (arg == "--format" && hasValue)
+            options.format = argv[++i];
+        else if (arg == "--quiet")
+            options.quiet = true;
+        else if (!arg.empty() && arg[0] != '-' && options.manifestPath == nullptr)
+            options.manifestPath = argv[i];
+        else
+        {
+            std::fprintf(stderr, "unexpected argument '%s'\n", argv[i]);
+            return false;
+        }
+    }
+
+    if (options.manifestPath == nullptr)
+        return false;
+    if (options.blockSize <= 0 || options.blockSize > kMaxBlockSize)
+    {
+        std::fprintf(stderr, "block size must be 1..%d\n", kMaxBlockSize);
+        return false;
+    }
+    if (options.tempo <= 0.0)
+    {
+        std::fprintf(stderr, "tempo must be positive\n");
+        return false;
+    }
+    if (options.rateReduction != 1 && options.rateReduction != 2 && options.rateReduction != 4)
+    {
+        std::fprintf(stderr, "eco factor must be 1, 2 or 4\n");
+        return false;
+    }
+    if (options.tailSeconds < 0.0 || options.numThreads < 0)
+    {
+        std::fprintf(stderr, "tail and thread count must not be negative\n");
+        return false;
+    }
+    WavFormat format = {};
+    if (options.format != nullptr && !parseSampleFormat(options.format, format))
+    {
+        std::fprintf(stderr, "unknown output format '%s'\n", options.format);
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<Job> jobs;
+    std::string error;
+    if (!loadJobs(options.manifestPath, jobs, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    if (jobs.empty())
+    {
+        std::fprintf(stderr, "no jobs in %s\n", options.manifestPath);
+        return 2;
+    }
+
+    std::vector<int64_t> costs;
+    for (const Job& job : jobs)
+        costs.push_back(getFileSize(job.inputPath));
+
+    WorkStealingPool pool(options.numThreads);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (int w = 0; w < pool.getNumWorkers(); w++)
+        workers.emplace_back(new Worker());
+
+    std::vector<JobResult> results(jobs.size());
+    std::mutex printMutex;
+    const auto start = std::chrono::steady_clock::now();
+    pool.run(costs, [&](int worker, int index) {
+        JobResult& result = results[index];
+        result = renderJob(*workers[worker], jobs[index], options);
+
+        std::lock_guard<std::mutex> lock(printMutex);
+        if (!result.passed)
+            std::fprintf(stderr, "FAILED: %s\n", result.message.c_str());
+        else if (!options.quiet)
+            std::printf("%s: %.1f s of audio, %.0fx realtime in the engine\n", jobs[index].outputPath.c_str(),
+                        result.audioSeconds, result.audioSeconds / std::max(result.processSeconds, 1e-9));
+    });
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    int failures = 0;
+    double audioSeconds = 0.0;
+    double processSeconds = 0.0;
+    for (const JobResult& result : results)
+    {
+        failures += result.passed ? 0 : 1;
+        audioSeconds += result.audioSeconds;
+        processSeconds += result.processSeconds;
+    }
+
+    // Overall is what the batch achieved end to end, per worker is the engine alone
+    std::printf("%d of %d jobs rendered: %.1f s of audio in %.2f s on %d workers, %.0fx realtime "
+                "(%.0fx per worker in the engine)\n",
+                static_cast<int>(jobs.size()) - failures, static_cast<int>(jobs.size()), audioSeconds, seconds,
+                pool.getNumWorkers(), audioSeconds / std::max(seconds, 1e-9),
+                audioSeconds / std::max(processSeconds, 1e-9));
+    return failures == 0 ? 0 : 1;
+}
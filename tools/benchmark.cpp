@@ -0,0 +1,556 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Micro-benchmarks for the buffer primitives and the engine's process path.
+//------------------------------------------------------------------------
+
+#include "circularBuffer.hpp"
+#include "delayEngine.hpp"
+#include "multiChannelBuffer.hpp"
+#include "parameters.hpp"
+#include "tapKernels.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#ifndef DELAY2_VERSION
+#define DELAY2_VERSION "unknown"
+#endif
+
+namespace {
+
+// Values each dimension is swept over
+const int kBlockSizes[] = { 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192 };
+const int kSampleRates[] = { 44100, 48000, 88200, 96000, 176400, 192000 };
+const int kChannelCounts[] = { 1, 2, 4, 6, 8 };
+const int kTapCounts[] = { 1, 2, 4, 8, 16, 32, 64 };
+const int kEventRates[] = { 0, 10, 100, 1000, 10000 };
+
+// Interpolation modes in InterpolationMode order, as they appear in the case names and results
+const char* const kInterpolationModeNames[] = { "none", "linear", "cubic", "hermite", "lagrange6", "sinc16" };
+
+// Operations per timed call of a primitive
+const int kPrimitiveOps = 4096;
+
+// Fed to the optimiser as if it were used, so timed work is not thrown away
+volatile double g_Sink;
+
+struct Settings
+{
+    double minTime = 0.05;  // seconds per repeat
+    int repeats = 5;
+    bool grid = false;
+    bool json = false;
+    bool primitives = true;
+    bool process = true;
+    SimdLevel simd = detectSimdLevel();
+    const char* outputPath = nullptr;
+};
+
+// One engine configuration
+struct ProcessCase
+{
+    int blockSize;
+    int sampleRate;
+    int numChannels;
+    int numTaps;
+    int eventsPerSecond;
+    bool modulated = false;  // taps swinging at half the modulation depth
+    InterpolationMode interpolation = InterpolationMode::kCubic;
+    int rateReduction = 1;
+    bool reflections = false;  // taps packed into the first 40 ms without feedback, as the convolution mode wants
+    bool convolution = false;  // convolution mode on, timed once it has taken over
+
+    bool operator==(const ProcessCase& other) const
+    {
+        return blockSize == other.blockSize && sampleRate == other.sampleRate && numChannels == other.numChannels
+               && numTaps == other.numTaps && eventsPerSecond == other.eventsPerSecond && modulated == other.modulated
+               && interpolation == other.interpolation && rateReduction == other.rateReduction
+               && reflections == other.reflections && convolution == other.convolution;
+    }
+};
+
+struct Result
+{
+    std::string suite;
+    std::string name;
+    ProcessCase config;  // all zero for the primitives
+    double nsPerSample;
+    double nsPerSampleMin;
+};
+
+const char* getSimdName(SimdLevel level)
+{
+    switch (level)
+    {
+        case SimdLevel::kSSE2: return "sse2";
+        case SimdLevel::kAVX: return "avx";
+        default: return "scalar";
+    }
+}
+
+// Deterministic noise, so every run times the same work
+struct Noise
+{
+    unsigned state = 12345;
+    double next()
+    {
+        state = state * 1664525u + 1013904223u;
+        return (state >> 8) * (1.0 / 16777216.0);
+    }
+};
+
+//------------------------------------------------------------------------
+// Times 'body', which handles 'samplesPerCall' samples per call. The call count is
+// calibrated so one repeat takes about minTime; reports the median and the best repeat.
+template <typename Body>
+void measure(Body&& body, double samplesPerCall, const Settings& settings, double& median, double& best)
+{
+    using Clock = std::chrono::steady_clock;
+    body();
+
+    long calls = 1;
+    for (;;)
+    {
+        const auto start = Clock::now();
+        for (long i = 0; i < calls; i++)
+            body();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        if (seconds >= settings.minTime * 0.5 || calls >= (1L << 30))
+        {
+            calls = std::max(1L, static_cast<long>(calls * settings.minTime / std::max(seconds, 1e-9)));
+            break;
+        }
+        calls *= 2;
+    }
+
+    std::vector<double> times;
+    for (int r = 0; r < settings.repeats; r++)
+    {
+        const auto start = Clock::now();
+        for (long i = 0; i < calls; i++)
+            body();
+        const double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        times.push_back(seconds * 1e9 / (calls * samplesPerCall));
+    }
+    std::sort(times.begin(), times.end());
+    median = times[times.size() / 2];
+    best = times.front();
+}
+
+//------------------------------------------------------------------------
+void benchmarkPrimitives(const Settings& settings, std::vector<Result>& results)
+{
+    const struct { CircularBuffer::Mode mode; const char* name; } modes[] = {
+        { CircularBuffer::kExact, "exact" },
+        { CircularBuffer::kPowerOfTwo, "pow2" },
+    };
+
+    for (const auto& mode : modes)
+    {
+        // One second at 48 kHz, read from all over the buffer
+        CircularBuffer buffer(48000, mode.mode);
+        Noise noise;
+        std::vector<double> values(kPrimitiveOps);
+        std::vector<int> delays(kPrimitiveOps);
+        std::vector<double> fractionalDelays(kPrimitiveOps);
+        for (int i = 0; i < kPrimitiveOps; i++)
+        {
+            values[i] = noise.next() - 0.5;
+            delays[i] = 1 + static_cast<int>(noise.next() * 47000);
+            fractionalDelays[i] = 1.0 + noise.next() * 47000.0;
+        }
+        for (int i = 0; i < buffer.getCapacity(); i++)
+            buffer.performWrite(noise.next() - 0.5);
+
+        Result result = { "primitive", "", { 0, 0, 1, 0, 0 }, 0.0, 0.0 };
+
+        result.name = std::string("performWrite/") + mode.name;
+        measure([&] {
+            for (int i = 0; i < kPrimitiveOps; i++)
+                buffer.performWrite(values[i]);
+        }, kPrimitiveOps, settings, result.nsPerSample, result.nsPerSampleMin);
+        results.push_back(result);
+
+        result.name = std::string("performRead/") + mode.name;
+        measure([&] {
+            double sum = 0.0;
+            for (int i = 0; i < kPrimitiveOps; i++)
+                sum += buffer.performRead(delays[i]);
+            g_Sink = sum;
+        }, kPrimitiveOps, settings, result.nsPerSample, result.nsPerSampleMin);
+        results.push_back(result);
+
+        result.name = std::string("performInterpolation/") + mode.name;
+        measure([&] {
+            double sum = 0.0;
+            for (int i = 0; i < kPrimitiveOps; i++)
+                sum += buffer.performInterpolation(fractionalDelays[i]);
+            g_Sink = sum;
+        }, kPrimitiveOps, settings, result.nsPerSample, result.nsPerSampleMin);
+        results.push_back(result);
+    }
+}
+
+//------------------------------------------------------------------------
+// The engine as the processor drives it: one block per call, split where automation lands
+Result benchmarkProcess(const ProcessCase& config, const Settings& settings)
+{
+    DelayEngine engine;
+    MultiChannelBuffer buffer;
+    engine.setSimdLevel(settings.simd);
+    engine.setRateReduction(config.rateReduction);
+    engine.setSampleRate(config.sampleRate);
+    buffer.setSize(DelayEngine::getRequiredCapacity(engine.getMaxDelay(), engine.getNetworkSampleRate()),
+                   config.numChannels);
+    engine.setConvolution(config.convolution, config.numChannels);
+
+    // Spread the taps over the delay range, a few of them feeding back. Reflections stay
+    // short enough for the convolution mode and keep clear of the write position.
+    Noise noise;
+    engine.setNumTaps(config.numTaps);
+    engine.setParameter(getParamIndex(kParamDelayLengthId_Tap1), config.reflections ? 0.04 : 0.5);
+    for (int t = 0; t < config.numTaps; t++)
+    {
+        if (config.reflections)
+            engine.setTap(t, 0.1 + 0.9 * noise.next(), 0.2 + 0.3 * noise.next(), 0.0);
+        else
+            engine.setTap(t, 0.05 + 0.95 * noise.next(), 0.2 + 0.3 * noise.next(), t % 4 == 0 ? 0.3 / config.numTaps : 0.0);
+    }
+    if (config.modulated)
+        engine.setParameter(getParamIndex(kParamModDepthId), 0.5);
+    const int mode = static_cast<int>(config.interpolation);
+    engine.setParameter(getParamIndex(kParamInterpolationId), (mode + 0.5) / kNumInterpolationModes);
+    engine.snapParameters();
+    engine.reset();
+
+    std::vector<float> inputMemory(static_cast<size_t>(config.blockSize) * config.numChannels);
+    std::vector<float> outputMemory(inputMemory.size());
+    for (float& sample : inputMemory)
+        sample = static_cast<float>(noise.next() - 0.5);
+    const float* inputs[MultiChannelBuffer::kMaxChannels];
+    float* outputs[MultiChannelBuffer::kMaxChannels];
+
+    // Automation alternates the wet mix and the tap 1 gain, both of which glide
+    const int eventInterval = config.eventsPerSecond > 0 ? std::max(1, config.sampleRate / config.eventsPerSecond) : 0;
+    int untilEvent = eventInterval;
+    int eventCount = 0;
+
+    auto processBlock = [&] {
+        int done = 0;
+        while (done < config.blockSize)
+        {
+            int segment = config.blockSize - done;
+            if (eventInterval > 0)
+            {
+                if (untilEvent == 0)
+                {
+                    const int index = getParamIndex(eventCount % 2 ? kParamWetMixId : kParamDelayGainId_Tap1);
+                    engine.setParameter(index, (eventCount / 2) % 2 ? 0.4 : 0.6);
+                    eventCount++;
+                    untilEvent = eventInterval;
+                }
+                segment = std::min(segment, untilEvent);
+                untilEvent -= segment;
+            }
+            for (int c = 0; c < config.numChannels; c++)
+            {
+                inputs[c] = &inputMemory[static_cast<size_t>(c) * config.blockSize + done];
+                outputs[c] = &outputMemory[static_cast<size_t>(c) * config.blockSize + done];
+            }
+            engine.process(buffer, inputs, outputs, segment);
+            done += segment;
+        }
+    };
+
+    // The settings are columns of their own, the name keeps the cases apart at a glance
+    std::string name = "DelayEngine::process";
+    if (config.interpolation != InterpolationMode::kCubic)
+        name += std::string("/") + kInterpolationModeNames[mode];
+    if (config.modulated)
+        name += "/modulated";
+    if (config.rateReduction > 1)
+        name += "/eco" + std::to_string(config.rateReduction);
+    if (config.reflections)
+        name += "/reflections";
+    if (config.convolution)
+        name += "/convolution";
+
+    // The convolution takes over once the impulse response is rendered, loaded and faded in,
+    // unless the engine finds the taps cheaper
+    if (config.convolution)
+    {
+        for (int i = 0; i < 64 && !engine.isConvolutionActive(); i++)
+            processBlock();
+        if (!engine.isConvolutionActive())
+            std::fprintf(stderr, "\n%s: the taps cost less, so the convolution stays off\n", name.c_str());
+    }
+    Result result = { "process", name, config, 0.0, 0.0 };
+    measure(processBlock, static_cast<double>(config.blockSize) * config.numChannels, settings,
+            result.nsPerSample, result.nsPerSampleMin);
+    return result;
+}
+
+//------------------------------------------------------------------------
+std::vector<ProcessCase> getProcessCases(bool grid)
+{
+    // Each sweep moves one dimension away from a stereo, 4 tap, 48 kHz baseline
+    const ProcessCase baseline = { 512, 48000, 2, 4, 0 };
+    std::vector<ProcessCase> cases;
+    auto add = [&cases](const ProcessCase& config) {
+        if (std::find(cases.begin(), cases.end(), config) == cases.end())
+            cases.push_back(config);
+    };
+
+    if (grid)
+    {
+        for (int blockSize : kBlockSizes)
+            for (int sampleRate : kSampleRates)
+                for (int numChannels : kChannelCounts)
+                    for (int numTaps : kTapCounts)
+                        for (int eventsPerSecond : kEventRates)
+                            add({ blockSize, sampleRate, numChannels, numTaps, eventsPerSecond });
+        return cases;
+    }
+
+    ProcessCase config = baseline;
+    for (int blockSize : kBlockSizes)
+    {
+        config.blockSize = blockSize;
+        add(config);
+    }
+    config = baseline;
+    for (int sampleRate : kSampleRates)
+    {
+        config.sampleRate = sampleRate;
+        add(config);
+    }
+    config = baseline;
+    for (int numChannels : kChannelCounts)
+    {
+        config.numChannels = numChannels;
+        add(config);
+    }
+    config = baseline;
+    for (int numTaps : kTapCounts)
+    {
+        config.numTaps = numTaps;
+        add(config);
+    }
+    config = baseline;
+    for (int eventsPerSecond : kEventRates)
+    {
+        config.eventsPerSecond = eventsPerSecond;
+        add(config);
+    }
+
+    // The baseline in every interpolation mode, static and modulated, to keep an eye on what
+    // the moving reads and the wider windows cost.
+    //
+    // Static taps pay for a mode only in the window width, as the weights are cooked with the
+    // tap table. Modulated taps work their weights out every sample, which the cubic kernels
+    // fold into the interpolation and the other modes do through their coefficient function,
+    // from the tables for Lagrange and sinc.
+    for (int mode = 0; mode < static_cast<int>(InterpolationMode::kNumModes); mode++)
+    {
+        for (bool modulated : { false, true })
+        {
+            config = baseline;
+            config.interpolation = static_cast<InterpolationMode>(mode);
+            config.modulated = modulated;
+            add(config);
+        }
+    }
+
+    // The reduced rate wet path at the rates it is meant for, against the full rate. The 15 tap
+    // half-band filters cost about as much as the default four cubic taps save at half the rate,
+    // and the saving grows with everything the network does per sample.
+    for (int sampleRate : { 96000, 192000 })
+    {
+        for (InterpolationMode mode : { InterpolationMode::kCubic, InterpolationMode::kSinc })
+        {
+            for (int numTaps : { 4, 16 })
+            {
+                for (int rateReduction : { 1, 2, 4 })
+                {
+                    config = baseline;
+                    config.sampleRate = sampleRate;
+                    config.interpolation = mode;
+                    config.numTaps = numTaps;
+                    config.rateReduction = rateReduction;
+                    add(config);
+                }
+            }
+        }
+    }
+
+    // Dense early reflections, the setup the convolution mode is for, on the taps and on the
+    // convolution. It only takes over in the wide modes, where the taps cost more than the transforms.
+    for (InterpolationMode mode : { InterpolationMode::kCubic, InterpolationMode::kSinc })
+    {
+        for (bool convolution : { false, true })
+        {
+            config = baseline;
+            config.interpolation = mode;
+            config.numTaps = DelayEngine::kMaxTaps;
+            config.reflections = true;
+            config.convolution = convolution;
+            add(config);
+        }
+    }
+    return cases;
+}
+
+//------------------------------------------------------------------------
+void writeResults(FILE* file, const Settings& settings, const std::vector<Result>& results)
+{
+    const char* simd = getSimdName(settings.simd);
+    if (!settings.json)
+    {
+        std::fprintf(file, "version,simd,suite,name,block,rate,channels,taps,events_per_sec,"
+                           "interpolation,modulated,eco,reflections,convolution,"
+                           "ns_per_sample,ns_per_sample_min,samples_per_sec,realtime\n");
+        for (const Result& r : results)
+        {
+            // Real-time factor: seconds of audio per second of processing
+            const double realtime = r.config.sampleRate > 0
+                ? 1e9 / (r.nsPerSample * r.config.numChannels * r.config.sampleRate) : 0.0;
+            // The engine settings are left empty for the primitives
+            char engineSettings[64] = ",,,,";
+            if (r.suite == "process")
+                std::snprintf(engineSettings, sizeof(engineSettings), "%s,%d,%d,%d,%d",
+                              kInterpolationModeNames[static_cast<int>(r.config.interpolation)],
+                              r.config.modulated ? 1 : 0, r.config.rateReduction, r.config.reflections ? 1 : 0,
+                              r.config.convolution ? 1 : 0);
+            std::fprintf(file, "%s,%s,%s,%s,%d,%d,%d,%d,%d,%s,%.4f,%.4f,%.0f,%.1f\n", DELAY2_VERSION, simd,
+                         r.suite.c_str(), r.name.c_str(), r.config.blockSize, r.config.sampleRate,
+                         r.config.numChannels, r.config.numTaps, r.config.eventsPerSecond, engineSettings,
+                         r.nsPerSample, r.nsPerSampleMin, 1e9 / r.nsPerSample, realtime);
+        }
+        return;
+    }
+
+    std::fprintf(file, "{\n  \"version\": \"%s\",\n  \"simd\": \"%s\",\n  \"results\": [\n", DELAY2_VERSION, simd);
+    for (size_t i = 0; i < results.size(); i++)
+    {
+        const Result& r = results[i];
+        std::fprintf(file, "    { \"suite\": \"%s\", \"name\": \"%s\"", r.suite.c_str(), r.name.c_str());
+        if (r.suite == "process")
+        {
+            std::fprintf(file, ", \"block\": %d, \"rate\": %d, \"channels\": %d, \"taps\": %d, \"events_per_sec\": %d",
+                         r.config.blockSize, r.config.sampleRate, r.config.numChannels, r.config.numTaps,
+                         r.config.eventsPerSecond);
+            std::fprintf(file, ", \"interpolation\": \"%s\", \"modulated\": %s, \"eco\": %d, \"reflections\": %s, "
+                               "\"convolution\": %s",
+                         kInterpolationModeNames[static_cast<int>(r.config.interpolation)],
+                         r.config.modulated ? "true" : "false", r.config.rateReduction,
+                         r.config.reflections ? "true" : "false", r.config.convolution ? "true" : "false");
+        }
+        std::fprintf(file, ", \"ns_per_sample\": %.4f, \"ns_per_sample_min\": %.4f, \"samples_per_sec\": %.0f }%s\n",
+                     r.nsPerSample, r.nsPerSampleMin, 1e9 / r.nsPerSample, i + 1 < results.size() ? "," : "");
+    }
+    std::fprintf(file, "  ]\n}\n");
+}
+
+void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: delay2-bench [options]\n"
+        "  --suite <all|primitives|process>   what to run, default all\n"
+        "  --grid                             every combination of block size, sample rate,\n"
+        "                                     channels, taps and automation density instead\n"
+        "                                     of one sweep per dimension\n"
+        "  --simd <scalar|sse2|avx>           kernel to use, default the best available\n"
+        "  --min-time <seconds>               length of each timed repeat, default 0.05\n"
+        "  --repeats <count>                  timed repeats per case, default 5\n"
+        "  --json                             JSON instead of CSV\n"
+        "  --output <file>                    write there instead of stdout\n");
+}
+
+bool parseOptions(int argc, char* argv[], Settings& settings)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--suite" && hasValue)
+        {
+            const std::string suite = argv[++i];
+            settings.primitives = suite == "all" || suite == "primitives";
+            settings.process = suite == "all" || suite == "process";
+            if (!settings.primitives && !settings.process)
+                return false;
+        }
+        else if (arg == "--grid")
+            settings.grid = true;
+        else if (arg == "--simd" && hasValue)
+        {
+            const std::string name = argv[++i];
+            if (name == "scalar")
+                settings.simd = SimdLevel::kScalar;
+            else if (name == "sse2")
+                settings.simd = SimdLevel::kSSE2;
+            else if (name == "avx")
+                settings.simd = SimdLevel::kAVX;
+            else
+                return false;
+            if (settings.simd > detectSimdLevel())
+            {
+                std::fprintf(stderr, "%s is not supported by this CPU\n", name.c_str());
+                return false;
+            }
+        }
+        else if (arg == "--min-time" && hasValue)
+            settings.minTime = std::atof(argv[++i]);
+        else if (arg == "--repeats" && hasValue)
+            settings.repeats = std::atoi(argv[++i]);
+        else if (arg == "--json")
+            settings.json = true;
+        else if (arg == "--output" && hasValue)
+            settings.outputPath = argv[++i];
+        else
+            return false;
+    }
+    return settings.minTime > 0.0 && settings.repeats > 0;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    Settings settings;
+    if (!parseOptions(argc, argv, settings))
+    {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<Result> results;
+    if (settings.primitives)
+        benchmarkPrimitives(settings, results);
+    if (settings.process)
+    {
+        const std::vector<ProcessCase> cases = getProcessCases(settings.grid);
+        for (size_t i = 0; i < cases.size(); i++)
+        {
+            std::fprintf(stderr, "\rprocess case %zu/%zu", i + 1, cases.size());
+            results.push_back(benchmarkProcess(cases[i], settings));
+        }
+        std::fprintf(stderr, "\n");
+    }
+
+    FILE* file = settings.outputPath != nullptr ? std::fopen(settings.outputPath, "w") : stdout;
+    if (file == nullptr)
+    {
+        std::fprintf(stderr, "%s: cannot create file\n", settings.outputPath);
+        return 1;
+    }
+    writeResults(file, settings, results);
+    if (file != stdout)
+        std::fclose(file);
+    return 0;
+}
@@ -0,0 +1,352 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Golden-audio regression: renders the bundled control samples at pinned
+// settings and compares them with stored reference renders.
+//------------------------------------------------------------------------
+
+#include "automation.hpp"
+#include "renderSession.hpp"
+#include "wavFile.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#ifndef DELAY2_SOURCE_DIR
+#define DELAY2_SOURCE_DIR "."
+#endif
+
+namespace {
+
+// References are stored as 24 bit PCM: quantisation stays around -140 dB, far below the default limits
+const WavFormat kReferenceFormat = { 0, 0, 24, false };
+
+struct Options
+{
+    std::string manifestPath = DELAY2_SOURCE_DIR "/audioSamples/reference/manifest.txt";
+    std::string only;
+    const char* timingsPath = nullptr;
+    const char* baselinePath = nullptr;
+    bool update = false;
+    double maxError = 2e-5;
+    double minSnr = 90.0;
+    double maxSlowdown = 1.5;
+    int blockSize = 512;
+    int repeats = 3;
+};
+
+// One manifest line
+struct Entry
+{
+    std::string name;
+    std::vector<ParameterEvent> parameters;
+};
+
+// Outcome for one entry
+struct Outcome
+{
+    double maxError = 0.0;
+    double snr = 0.0;
+    double renderSeconds = 0.0;
+    double audioSeconds = 0.0;
+    bool compared = false;
+    bool passed = false;
+    std::string message;
+};
+
+std::string getDirectory(const std::string& path)
+{
+    const size_t slash = path.find_last_of("/\\");
+    return slash == std::string::npos ? std::string(".") : path.substr(0, slash);
+}
+
+bool loadManifest(const std::string& path, std::vector<Entry>& entries, std::string& error)
+{
+    std::ifstream file(path);
+    if (!file)
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    std::string line;
+    for (int lineNumber = 1; std::getline(file, line); lineNumber++)
+    {
+        const size_t comment = line.find('#');
+        if (comment != std::string::npos)
+            line.erase(comment);
+
+        std::istringstream fields(line);
+        Entry entry;
+        if (!(fields >> entry.name))
+            continue;
+        std::string assignment;
+        while (fields >> assignment)
+        {
+            ParameterEvent parameter = { 0, -1, 0.0 };
+            if (!parseParameterAssignment(assignment, parameter.index, parameter.value))
+            {
+                error = path + ":" + std::to_string(lineNumber) + ": invalid parameter setting '" + assignment + "'";
+                return false;
+            }
+            entry.parameters.push_back(parameter);
+        }
+        entries.push_back(entry);
+    }
+    return true;
+}
+
+// Per-file render times of an earlier --timings run
+std::map<std::string, double> loadTimings(const char* path)
+{
+    std::map<std::string, double> timings;
+    std::ifstream file(path);
+    std::string line;
+    std::getline(file, line);  // header
+    while (std::getline(file, line))
+    {
+        const size_t comma = line.find(',');
+        if (comma != std::string::npos)
+            timings[line.substr(0, comma)] = std::atof(line.c_str() + comma + 1);
+    }
+    return timings;
+}
+
+//------------------------------------------------------------------------
+// Renders 'entry' and compares it with its reference block by block, or writes the reference
+Outcome runEntry(const Entry& entry, const std::string& directory, const Options& options)
+{
+    Outcome outcome;
+    const std::string controlPath = directory + "/../" + entry.name + " (control).wav";
+    const std::string referencePath = directory + "/" + entry.name + " (reference).wav";
+
+    WavReader control;
+    const char* error = nullptr;
+    if (!control.open(controlPath.c_str(), error))
+    {
+        outcome.message = controlPath + ": " + error;
+        return outcome;
+    }
+    const WavFormat format = control.getFormat();
+
+    RenderSettings settings;
+    settings.parameters = entry.parameters;
+    settings.blockSize = options.blockSize;
+
+    RenderStats stats;
+    std::string message;
+    if (options.update)
+    {
+        WavWriter writer;
+        WavFormat referenceFormat = kReferenceFormat;
+        referenceFormat.numChannels = format.numChannels;
+        referenceFormat.sampleRate = format.sampleRate;
+        if (!writer.open(referencePath.c_str(), referenceFormat))
+        {
+            outcome.message = referencePath + ": cannot create file";
+            return outcome;
+        }
+        const bool rendered = renderStream(control, settings,
+            [&writer](const float* const* channels, int numFrames) { return writer.write(channels, numFrames); },
+            stats, message);
+        outcome.passed = writer.close() && rendered;
+        outcome.message = outcome.passed ? "written" : referencePath + ": write failed";
+    }
+    else
+    {
+        WavReader reference;
+        if (!reference.open(referencePath.c_str(), error))
+        {
+            outcome.message = referencePath + ": " + error + " (run with --update to create it)";
+            return outcome;
+        }
+        if (reference.getFormat().numChannels != format.numChannels
+            || reference.getFormat().sampleRate != format.sampleRate
+            || reference.getNumFrames() != control.getNumFrames())
+        {
+            outcome.message = "reference layout differs from the control file";
+            return outcome;
+        }
+
+        // Compare while rendering, a block of the reference at a time
+        const int numChannels = format.numChannels;
+        std::vector<float> expectedMemory(static_cast<size_t>(options.blockSize) * numChannels);
+        std::vector<float*> expected(numChannels);
+        for (int c = 0; c < numChannels; c++)
+            expected[c] = &expectedMemory[static_cast<size_t>(c) * options.blockSize];
+
+        double signalEnergy = 0.0;
+        double errorEnergy = 0.0;
+        const bool rendered = renderStream(control, settings,
+            [&](const float* const* channels, int numFrames) {
+                if (reference.read(expected.data(), numFrames) != numFrames)
+                    return false;
+                for (int c = 0; c < numChannels; c++)
+                {
+                    for (int n = 0; n < numFrames; n++)
+                    {
+                        const double difference = static_cast<double>(channels[c][n]) - expected[c][n];
+                        outcome.maxError = std::max(outcome.maxError, std::fabs(difference));
+                        signalEnergy += static_cast<double>(expected[c][n]) * expected[c][n];
+                        errorEnergy += difference * difference;
+                    }
+                }
+                return true;
+            },
+            stats, message);
+        if (!rendered)
+        {
+            outcome.message = message;
+            return outcome;
+        }
+
+        outcome.compared = true;
+
+        // Identical renders get a finite SNR so the report stays readable
+        outcome.snr = 10.0 * std::log10(std::max(signalEnergy, 1e-30) / std::max(errorEnergy, 1e-30));
+        outcome.passed = outcome.maxError <= options.maxError && outcome.snr >= options.minSnr;
+        if (!outcome.passed)
+            outcome.message = "drifted from the reference";
+    }
+
+    // Timing only: render again without comparing and keep the fastest run
+    outcome.renderSeconds = stats.processSeconds;
+    outcome.audioSeconds = stats.numFrames / static_cast<double>(format.sampleRate);
+    for (int r = 1; r < options.repeats && outcome.passed; r++)
+    {
+        control.rewind();
+        renderStream(control, settings, [](const float* const*, int) { return true; }, stats, message);
+        outcome.renderSeconds = std::min(outcome.renderSeconds, stats.processSeconds);
+    }
+    return outcome;
+}
+
+void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: delay2-golden [options]\n"
+        "  --manifest <file>        entries to run, default audioSamples/reference/manifest.txt\n"
+        "  --only <name>            run a single entry\n"
+        "  --update                 write the reference renders instead of comparing\n"
+        "  --max-error <value>      largest absolute sample difference, default 2e-5\n"
+        "  --min-snr <dB>           smallest reference to difference ratio, default 90\n"
+        "  --block <frames>         block size, default 512\n"
+        "  --repeats <count>        renders per entry for the timing, default 3\n"
+        "  --timings <file>         write the render time of every entry as CSV\n"
+        "  --baseline <file>        fail entries slower than in this earlier --timings file\n"
+        "  --max-slowdown <ratio>   allowed render time over the baseline, default 1.5\n");
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--manifest" && hasValue)
+            options.manifestPath = argv[++i];
+        else if (arg == "--only" && hasValue)
+            options.only = argv[++i];
+        else if (arg == "--update")
+            options.update = true;
+        else if (arg == "--max-error" && hasValue)
+            options.maxError = std::atof(argv[++i]);
+        else if (arg == "--min-snr" && hasValue)
+            options.minSnr = std::atof(argv[++i]);
+        else if (arg == "--block" && hasValue)
+            options.blockSize = std::atoi(argv[++i]);
+        else if (arg == "--repeats" && hasValue)
+            options.repeats = std::atoi(argv[++i]);
+        else if (arg == "--timings" && hasValue)
+            options.timingsPath = argv[++i];
+        else if (arg == "--baseline" && hasValue)
+            options.baselinePath = argv[++i];
+        else if (arg == "--max-slowdown" && hasValue)
+            options.maxSlowdown = std::atof(argv[++i]);
+        else
+            return false;
+    }
+    return options.blockSize > 0 && options.repeats > 0;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    std::vector<Entry> entries;
+    std::string error;
+    if (!loadManifest(options.manifestPath, entries, error))
+    {
+        std::fprintf(stderr, "%s\n", error.c_str());
+        return 2;
+    }
+    const std::string directory = getDirectory(options.manifestPath);
+    std::map<std::string, double> baseline;
+    if (options.baselinePath != nullptr)
+        baseline = loadTimings(options.baselinePath);
+
+    FILE* timings = nullptr;
+    if (options.timingsPath != nullptr)
+    {
+        timings = std::fopen(options.timingsPath, "w");
+        if (timings == nullptr)
+        {
+            std::fprintf(stderr, "%s: cannot create file\n", options.timingsPath);
+            return 2;
+        }
+        std::fprintf(timings, "name,render_seconds,audio_seconds\n");
+    }
+
+    int failures = 0;
+    int runs = 0;
+    for (const Entry& entry : entries)
+    {
+        if (!options.only.empty() && entry.name != options.only)
+            continue;
+        runs++;
+
+        Outcome outcome = runEntry(entry, directory, options);
+        const auto base = baseline.find(entry.name);
+        if (outcome.passed && base != baseline.end() && outcome.renderSeconds > base->second * options.maxSlowdown)
+        {
+            outcome.passed = false;
+            outcome.message = "slower than the baseline";
+        }
+        if (!outcome.passed)
+            failures++;
+
+        const double realtime = outcome.renderSeconds > 0.0 ? outcome.audioSeconds / outcome.renderSeconds : 0.0;
+        if (!outcome.compared)
+            std::printf("%-8s %s%s\n", entry.name.c_str(), outcome.passed ? "" : "FAILED: ", outcome.message.c_str());
+        else
+            std::printf("%-8s max error %.3g  snr %.1f dB  render %.2f ms (%.0fx realtime)  %s%s%s\n",
+                        entry.name.c_str(), outcome.maxError, outcome.snr, outcome.renderSeconds * 1e3, realtime,
+                        outcome.passed ? "ok" : "FAILED", outcome.message.empty() ? "" : ": ",
+                        outcome.message.c_str());
+        if (timings != nullptr && outcome.renderSeconds > 0.0)
+            std::fprintf(timings, "%s,%.6f,%.3f\n", entry.name.c_str(), outcome.renderSeconds, outcome.audioSeconds);
+    }
+    if (timings != nullptr)
+        std::fclose(timings);
+
+    if (runs == 0)
+    {
+        std::fprintf(stderr, "no entries to run\n");
+        return 2;
+    }
+    std::printf("%d of %d passed\n", runs - failures, runs);
+    return failures == 0 ? 0 : 1;
+}
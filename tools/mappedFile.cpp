@@ -0,0 +1,150 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Read-only memory-mapped file for the command-line tools.
+//------------------------------------------------------------------------
+
+#include "mappedFile.hpp"
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+//------------------------------------------------------------------------
+MappedFile::MappedFile()
+{
+    m_Data = nullptr;
+    m_Size = 0;
+    m_Released = 0;
+#if defined(_WIN32)
+    m_File = INVALID_HANDLE_VALUE;
+    m_Mapping = nullptr;
+#else
+    m_File = -1;
+#endif
+}
+
+//------------------------------------------------------------------------
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+#if defined(_WIN32)
+
+//------------------------------------------------------------------------
+bool MappedFile::open(const char* path)
+{
+    close();
+    m_File = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (m_File == INVALID_HANDLE_VALUE)
+        return false;
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+    {
+        close();
+        return false;
+    }
+    m_Mapping = CreateFileMappingA(m_File, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (m_Mapping == nullptr)
+    {
+        close();
+        return false;
+    }
+    m_Data = static_cast<const unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+    if (m_Data == nullptr)
+    {
+        close();
+        return false;
+    }
+    m_Size = static_cast<size_t>(size.QuadPart);
+    return true;
+}
+
+//------------------------------------------------------------------------
+void MappedFile::close()
+{
+    if (m_Data != nullptr)
+        UnmapViewOfFile(m_Data);
+    if (m_Mapping != nullptr)
+        CloseHandle(m_Mapping);
+    if (m_File != INVALID_HANDLE_VALUE)
+        CloseHandle(m_File);
+    m_Data = nullptr;
+    m_Mapping = nullptr;
+    m_File = INVALID_HANDLE_VALUE;
+    m_Size = 0;
+    m_Released = 0;
+}
+
+//------------------------------------------------------------------------
+void MappedFile::release(size_t offset)
+{
+    // The working set trimmer takes care of pages that are no longer touched
+    (void)offset;
+}
+
+#else
+
+//------------------------------------------------------------------------
+bool MappedFile::open(const char* path)
+{
+    close();
+    m_File = ::open(path, O_RDONLY);
+    if (m_File < 0)
+        return false;
+
+    struct stat info;
+    if (fstat(m_File, &info) != 0 || info.st_size <= 0)
+    {
+        close();
+        return false;
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, m_File, 0);
+    if (data == MAP_FAILED)
+    {
+        close();
+        return false;
+    }
+    m_Data = static_cast<const unsigned char*>(data);
+    m_Size = static_cast<size_t>(info.st_size);
+
+    // Read front to back, so read ahead aggressively
+    madvise(data, m_Size, MADV_SEQUENTIAL);
+    return true;
+}
+
+//------------------------------------------------------------------------
+void MappedFile::close()
+{
+    if (m_Data != nullptr)
+        munmap(const_cast<unsigned char*>(m_Data), m_Size);
+    if (m_File >= 0)
+        ::close(m_File);
+    m_Data = nullptr;
+    m_File = -1;
+    m_Size = 0;
+    m_Released = 0;
+}
+
+//------------------------------------------------------------------------
+void MappedFile::release(size_t offset)
+{
+    // madvise works on whole pages, and only pays off in larger steps
+    const size_t step = 1 << 20;
+    const size_t pageSize = static_cast<size_t>(sysconf(_SC_PAGESIZE));
+    if (m_Data == nullptr || offset < m_Released + step)
+        return;
+
+    const size_t end = offset / pageSize * pageSize;
+    madvise(const_cast<unsigned char*>(m_Data) + m_Released, end - m_Released, MADV_DONTNEED);
+    m_Released = end;
+}
+
+#endif
@@ -0,0 +1,46 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Read-only memory-mapped file for the command-line tools.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstddef>
+
+//------------------------------------------------------------------------
+//  MappedFile
+//------------------------------------------------------------------------
+// Maps a whole file read-only. Pages are only loaded as they are touched, and
+// release() hands pages that were read already back to the OS, so streaming
+// through a long file keeps the resident memory flat.
+class MappedFile
+{
+public:
+    MappedFile();
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    /** Maps 'path', returns false if it cannot be opened or is empty */
+    bool open(const char* path);
+    void close();
+
+    const unsigned char* getData() const { return m_Data; }
+    size_t getSize() const { return m_Size; }
+
+    /** Tells the OS that bytes [0, 'offset') will not be read again */
+    void release(size_t offset);
+
+private:
+    const unsigned char* m_Data;
+    size_t m_Size;
+    size_t m_Released;
+
+#if defined(_WIN32)
+    void* m_File;
+    void* m_Mapping;
+#else
+    int m_File;
+#endif
+};
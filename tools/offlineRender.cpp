@@ -0,0 +1,216 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Headless renderer: streams a WAV file through the delay engine.
+//------------------------------------------------------------------------
+
+#include "automation.hpp"
+#include "delayEngine.hpp"
+#include "renderSession.hpp"
+#include "wavFile.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+namespace {
+
+const int kDefaultBlockSize = 512;
+const int kMaxBlockSize = 1 << 16;
+
+// Upper bound for --tail auto when the feedback never dies away
+const double kMaxAutoTail = 60.0;
+
+void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: delay2-render [options] <input.wav> <output.wav>\n"
+        "  --param <name>=<value>   set a parameter before rendering, by ID or title\n"
+        "                           (\"wet-mix=0.4\"), value normalised to 0..1; repeatable\n"
+        "                           taps 5 to 64 are \"delay-time-tap-5\" and so on, and\n"
+        "                           tap-count=(taps-1)/63 sets how many are in use\n"
+        "  --automation <file>      timed changes, one \"<seconds> <name> <value>\" per line\n"
+        "  --block <frames>         block size, default %d\n"
+        "  --max-delay <seconds>    tap 1 range, default %g\n"
+        "  --tempo <bpm>            tempo the synced tap times follow, default %g\n"
+        "  --tail <seconds|auto>    keep rendering after the input ends, auto stops once\n"
+        "                           the delay memory is silent (at most %g s)\n"
+        "  --convolution            let settled dense tap setups run as FFT convolution\n"
+        "  --eco <factor>           run the taps at 1/2 or 1/4 of the sample rate, 2 or 4\n"
+        "  --format <format>        pcm16, pcm24, pcm32, float32 or float64, default as input\n",
+        kDefaultBlockSize, DelayEngine::kDefaultMaxDelay, DelayEngine::kDefaultTempo, kMaxAutoTail);
+}
+
+struct Options
+{
+    const char* inputPath = nullptr;
+    const char* outputPath = nullptr;
+    const char* automationPath = nullptr;
+    const char* format = nullptr;
+    std::vector<ParameterEvent> parameters;
+    int blockSize = kDefaultBlockSize;
+    double maxDelay = DelayEngine::kDefaultMaxDelay;
+    double tempo = DelayEngine::kDefaultTempo;
+    double tailSeconds = 0.0;
+    bool autoTail = false;
+    bool convolution = false;
+    int rateReduction = 1;
+};
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--param" && hasValue)
+        {
+            ParameterEvent event = { 0, -1, 0.0 };
+            if (!parseParameterAssignment(argv[++i], event.index, event.value))
+            {
+                std::fprintf(stderr, "invalid parameter setting '%s'\n", argv[i]);
+                return false;
+            }
+            options.parameters.push_back(event);
+        }
+        else if (arg == "--automation" && hasValue)
+            options.automationPath = argv[++i];
+        else if (arg == "--block" && hasValue)
+            options.blockSize = std::atoi(argv[++i]);
+        else if (arg == "--max-delay" && hasValue)
+            options.maxDelay = std::atof(argv[++i]);
+        else if (arg == "--tempo" && hasValue)
+            options.tempo = std::atof(argv[++i]);
+        else if (arg == "--tail" && hasValue)
+        {
+            options.autoTail = std::strcmp(argv[++i], "auto") == 0;
+            options.tailSeconds = options.autoTail ? kMaxAutoTail : std::atof(argv[i]);
+        }
+        else if (arg == "--convolution")
+            options.convolution = true;
+        else if (arg == "--eco" && hasValue)
+            options.rateReduction = std::atoi(argv[++i]);
+        else if (arg == "--format" && hasValue)
+            options.format = argv[++i];
+        else if (!arg.empty() && arg[0] != '-' && options.inputPath == nullptr)
+            options.inputPath = argv[i];
+        else if (!arg.empty() && arg[0] != '-' && options.outputPath == nullptr)
+            options.outputPath = argv[i];
+        else
+        {
+            std::fprintf(stderr, "unexpected argument '%s'\n", argv[i]);
+            return false;
+        }
+    }
+
+    if (options.inputPath == nullptr || options.outputPath == nullptr)
+        return false;
+    if (options.blockSize <= 0 || options.blockSize > kMaxBlockSize)
+    {
+        std::fprintf(stderr, "block size must be 1..%d\n", kMaxBlockSize);
+        return false;
+    }
+    if (options.tempo <= 0.0)
+    {
+        std::fprintf(stderr, "tempo must be positive\n");
+        return false;
+    }
+    if (options.rateReduction != 1 && options.rateReduction != 2 && options.rateReduction != 4)
+    {
+        std::fprintf(stderr, "eco factor must be 1, 2 or 4\n");
+        return false;
+    }
+    if (options.tailSeconds < 0.0)
+    {
+        std::fprintf(stderr, "tail must not be negative\n");
+        return false;
+    }
+    return true;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    WavReader reader;
+    const char* error = nullptr;
+    if (!reader.open(options.inputPath, error))
+    {
+        std::fprintf(stderr, "%s: %s\n", options.inputPath, error);
+        return 1;
+    }
+    const WavFormat inputFormat = reader.getFormat();
+    const double sampleRate = inputFormat.sampleRate;
+
+    WavFormat outputFormat = inputFormat;
+    if (options.format != nullptr && !parseSampleFormat(options.format, outputFormat))
+    {
+        std::fprintf(stderr, "unknown output format '%s'\n", options.format);
+        return 2;
+    }
+
+    std::vector<ParameterEvent> automation;
+    if (options.automationPath != nullptr)
+    {
+        std::string message;
+        if (!loadAutomation(options.automationPath, sampleRate, automation, message))
+        {
+            std::fprintf(stderr, "%s\n", message.c_str());
+            return 1;
+        }
+    }
+
+    WavWriter writer;
+    if (!writer.open(options.outputPath, outputFormat))
+    {
+        std::fprintf(stderr, "%s: cannot create file\n", options.outputPath);
+        return 1;
+    }
+
+    RenderSettings settings;
+    settings.parameters = options.parameters;
+    settings.automation = automation;
+    settings.blockSize = options.blockSize;
+    settings.maxDelay = options.maxDelay;
+    settings.tempo = options.tempo;
+    settings.tailSeconds = options.tailSeconds;
+    settings.autoTail = options.autoTail;
+    settings.convolution = options.convolution;
+    settings.rateReduction = options.rateReduction;
+
+    RenderStats stats;
+    std::string message;
+    const auto start = std::chrono::steady_clock::now();
+    const bool rendered = renderStream(reader, settings,
+        [&writer](const float* const* channels, int numFrames) { return writer.write(channels, numFrames); },
+        stats, message);
+    const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    const bool closed = writer.close();
+    if (!rendered)
+    {
+        std::fprintf(stderr, "%s: %s\n", options.inputPath, message.c_str());
+        return 1;
+    }
+    if (!closed)
+    {
+        std::fprintf(stderr, "%s: write failed\n", options.outputPath);
+        return 1;
+    }
+
+    const double audioSeconds = writer.getNumFrames() / sampleRate;
+    std::fprintf(stderr, "rendered %lld frames (%.2f s) in %.3f s, %.1fx realtime\n",
+                 static_cast<long long>(writer.getNumFrames()), audioSeconds, seconds,
+                 seconds > 0.0 ? audioSeconds / seconds : 0.0);
+    return 0;
+}
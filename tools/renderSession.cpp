@@ -0,0 +1,135 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Streams audio through a delay engine, shared by the tools.
+//------------------------------------------------------------------------
+
+#include "renderSession.hpp"
+#include "parameters.hpp"
+#include <algorithm>
+#include <chrono>
+
+//------------------------------------------------------------------------
+bool RenderSession::start(const RenderSettings& settings, int numChannels, double sampleRate, std::string& error)
+{
+    if (numChannels > MultiChannelBuffer::kMaxChannels)
+    {
+        error = std::to_string(numChannels) + " channels, at most " + std::to_string(MultiChannelBuffer::kMaxChannels)
+                + " are supported";
+        return false;
+    }
+    if (settings.blockSize <= 0)
+    {
+        error = "block size must be positive";
+        return false;
+    }
+
+    // Same setup as the processor's activation: delay memory for the range, settled parameters.
+    // A previous render may have moved any parameter, so start over from the defaults.
+    const double maxDelay = std::min(std::max(settings.maxDelay, DelayEngine::kMinMaxDelay), DelayEngine::kMaxMaxDelay);
+    m_Engine.setRateReduction(settings.rateReduction);
+    m_Engine.setSampleRate(sampleRate);
+    m_Engine.setMaxDelay(maxDelay);
+    m_Engine.setTempo(settings.tempo, 4, 4);
+    m_Buffer.setSize(DelayEngine::getRequiredCapacity(maxDelay, m_Engine.getNetworkSampleRate()), numChannels);
+    m_Engine.setConvolution(settings.convolution, numChannels);
+    for (int i = 0; i < kNumParams; i++)
+        m_Engine.setParameter(i, kParamDescriptors[i].defaultValue);
+    for (const ParameterEvent& parameter : settings.parameters)
+        m_Engine.setParameter(parameter.index, parameter.value);
+    m_Engine.snapParameters();
+    m_Engine.reset();
+
+    m_Automation = &settings.automation;
+    m_NextEvent = 0;
+    m_Position = 0;
+    m_NumChannels = numChannels;
+    m_ProcessSeconds = 0.0;
+    return true;
+}
+
+//------------------------------------------------------------------------
+void RenderSession::process(const float* const* inputs, float* const* outputs, int numFrames)
+{
+    const std::vector<ParameterEvent>& automation = *m_Automation;
+    const auto start = std::chrono::steady_clock::now();
+    int done = 0;
+    while (done < numFrames)
+    {
+        while (m_NextEvent < automation.size() && automation[m_NextEvent].frame <= m_Position + done)
+        {
+            m_Engine.setParameter(automation[m_NextEvent].index, automation[m_NextEvent].value);
+            m_NextEvent++;
+        }
+        int segment = numFrames - done;
+        if (m_NextEvent < automation.size())
+            segment = static_cast<int>(std::min<int64_t>(segment, automation[m_NextEvent].frame - m_Position - done));
+
+        const float* segmentInputs[MultiChannelBuffer::kMaxChannels];
+        float* segmentOutputs[MultiChannelBuffer::kMaxChannels];
+        for (int c = 0; c < m_NumChannels; c++)
+        {
+            segmentInputs[c] = inputs[c] + done;
+            segmentOutputs[c] = outputs[c] + done;
+        }
+        m_Engine.process(m_Buffer, segmentInputs, segmentOutputs, segment);
+        done += segment;
+    }
+    m_ProcessSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    m_Position += numFrames;
+}
+
+//------------------------------------------------------------------------
+bool renderStream(RenderSession& session, WavReader& reader, const RenderSettings& settings, const RenderSink& sink,
+                  RenderStats& stats, std::string& error)
+{
+    const int numChannels = reader.getFormat().numChannels;
+    stats = RenderStats();
+    if (!session.start(settings, numChannels, reader.getFormat().sampleRate, error))
+        return false;
+
+    // Planar block buffers, the only memory that depends on the settings rather than the file
+    const int blockSize = settings.blockSize;
+    std::vector<float> inputMemory(static_cast<size_t>(blockSize) * numChannels);
+    std::vector<float> outputMemory(static_cast<size_t>(blockSize) * numChannels);
+    float* inputs[MultiChannelBuffer::kMaxChannels];
+    float* outputs[MultiChannelBuffer::kMaxChannels];
+    for (int c = 0; c < numChannels; c++)
+    {
+        inputs[c] = &inputMemory[static_cast<size_t>(c) * blockSize];
+        outputs[c] = &outputMemory[static_cast<size_t>(c) * blockSize];
+    }
+
+    const int64_t inputFrames = reader.getNumFrames() - reader.getPosition();
+    const int64_t totalFrames = inputFrames + static_cast<int64_t>(settings.tailSeconds * reader.getFormat().sampleRate);
+    while (session.getPosition() < totalFrames)
+    {
+        // An automatic tail ends at the first block boundary after the feedback has died away
+        const int64_t position = session.getPosition();
+        if (settings.autoTail && position >= inputFrames && session.isTailSilent())
+            break;
+
+        const int numFrames = static_cast<int>(std::min<int64_t>(blockSize, totalFrames - position));
+        const int numRead = reader.read(inputs, numFrames);
+        for (int c = 0; c < numChannels; c++)
+            std::fill(inputs[c] + numRead, inputs[c] + numFrames, 0.0f);
+
+        session.process(inputs, outputs, numFrames);
+        stats.processSeconds = session.getProcessSeconds();
+
+        if (!sink(outputs, numFrames))
+        {
+            error = "render stopped by the output";
+            return false;
+        }
+        stats.numFrames = session.getPosition();
+    }
+    return true;
+}
+
+//------------------------------------------------------------------------
+bool renderStream(WavReader& reader, const RenderSettings& settings, const RenderSink& sink, RenderStats& stats,
+                  std::string& error)
+{
+    RenderSession session;
+    return renderStream(session, reader, settings, sink, stats, error);
+}
@@ -0,0 +1,83 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Streams audio through a delay engine, shared by the tools.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "automation.hpp"
+#include "delayEngine.hpp"
+#include "multiChannelBuffer.hpp"
+#include "wavFile.hpp"
+#include <functional>
+#include <string>
+#include <vector>
+
+// How to render one file
+struct RenderSettings
+{
+    std::vector<ParameterEvent> parameters;  // applied before the first block, frames ignored
+    std::vector<ParameterEvent> automation;  // sorted by frame
+    int blockSize = 512;
+    double maxDelay = DelayEngine::kDefaultMaxDelay;
+    double tempo = DelayEngine::kDefaultTempo;   // for tempo synced tap times, in 4/4
+    double tailSeconds = 0.0;                // rendered after the input ends
+    bool autoTail = false;                   // stop the tail early once the delay memory is silent
+    bool convolution = false;
+    int rateReduction = 1;                   // taps at 1/2 or 1/4 of the sample rate
+};
+
+// What a render did
+struct RenderStats
+{
+    int64_t numFrames = 0;
+    double processSeconds = 0.0;  // time spent in DelayEngine::process only
+};
+
+// Receives every rendered block, planar; returning false stops the render
+typedef std::function<bool(const float* const* channels, int numFrames)> RenderSink;
+
+//------------------------------------------------------------------------
+//  RenderSession
+//------------------------------------------------------------------------
+// An engine with its delay memory that can render one file after another.
+// Every start() puts it back into the state of a fresh engine, but the delay
+// memory is only reallocated when the channel count, sample rate or delay
+// range differ from the previous render.
+class RenderSession
+{
+public:
+    /** Sets the engine up like the processor's activation, with every parameter at its default
+        and then 'settings.parameters' applied. Returns false with a message in 'error' if the
+        settings do not fit the layout. 'settings' has to outlive the render. */
+    bool start(const RenderSettings& settings, int numChannels, double sampleRate, std::string& error);
+
+    /** Renders 'numFrames' planar frames, splitting the block where automation lands like the
+        processor does for parameter queues */
+    void process(const float* const* inputs, float* const* outputs, int numFrames);
+
+    /** True once the input is over and the delay memory has died away, see RenderSettings::autoTail */
+    bool isTailSilent() const { return m_Engine.isTailSilent(m_NumChannels); }
+
+    int64_t getPosition() const { return m_Position; }
+    double getProcessSeconds() const { return m_ProcessSeconds; }
+
+private:
+    DelayEngine m_Engine;
+    MultiChannelBuffer m_Buffer;
+    const std::vector<ParameterEvent>* m_Automation = nullptr;
+    size_t m_NextEvent = 0;
+    int64_t m_Position = 0;
+    int m_NumChannels = 0;
+    double m_ProcessSeconds = 0.0;
+};
+
+/** Streams all of 'reader' through 'session' in blocks of 'settings.blockSize', followed by the
+    tail. Returns false with a message in 'error' if the settings do not fit the file or the sink
+    stopped the render. */
+bool renderStream(RenderSession& session, WavReader& reader, const RenderSettings& settings, const RenderSink& sink,
+                  RenderStats& stats, std::string& error);
+
+/** Same with a fresh session */
+bool renderStream(WavReader& reader, const RenderSettings& settings, const RenderSink& sink, RenderStats& stats,
+                  std::string& error);
@@ -0,0 +1,424 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Real-time safety check: drives the audio path with long random block and
+// automation streams while trapping allocations and blocking calls.
+//------------------------------------------------------------------------
+
+#include "delayEngine.hpp"
+#include "multiChannelBuffer.hpp"
+#include "parameters.hpp"
+#include "rtSafety.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Set by CMake when the plug-in sources and the VST 3 SDK are available
+#ifndef DELAY2_RTCHECK_PROCESSOR
+#define DELAY2_RTCHECK_PROCESSOR 0
+#endif
+
+#if DELAY2_RTCHECK_PROCESSOR
+#include "pluginState.h"
+#include "processor.h"
+#include "pluginterfaces/vst/ivstaudioprocessor.h"
+#include "public.sdk/source/common/memorystream.h"
+#include "public.sdk/source/vst/hosting/parameterchanges.h"
+#endif
+
+namespace {
+
+struct Options
+{
+    bool processor = DELAY2_RTCHECK_PROCESSOR != 0;
+    long numBlocks = 50000;
+    int maxBlockSize = 4096;
+    int numChannels = 2;
+    double sampleRate = 48000.0;
+    unsigned seed = 1;
+    bool convolution = false;
+    int rateReduction = 1;
+    bool keepGoing = false;
+};
+
+// Deterministic random stream, so a failing seed can be replayed
+struct Random
+{
+    unsigned state;
+    explicit Random(unsigned seed) : state(seed * 2654435761u + 1) {}
+    unsigned next()
+    {
+        state = state * 1664525u + 1013904223u;
+        return state >> 8;
+    }
+    int range(int count) { return static_cast<int>(next() % static_cast<unsigned>(count)); }
+    double unit() { return next() * (1.0 / 16777216.0); }
+};
+
+// One parameter point of a block, the same shape the processor collects from its queues
+struct Point
+{
+    int index;
+    int offset;
+    double value;
+};
+
+// Everything about the next block that is decided before it is processed, off the checked region
+struct BlockPlan
+{
+    int numSamples;
+    bool silent;
+    bool flagSilent;  // silent and marked so in the bus flags
+    std::vector<Point> points;
+};
+
+void planBlock(Random& random, const Options& options, BlockPlan& plan)
+{
+    // Mostly random sizes, plus the edges: empty, single sample and the maximum
+    const int kind = random.range(20);
+    if (kind == 0)
+        plan.numSamples = 0;
+    else if (kind == 1)
+        plan.numSamples = 1;
+    else if (kind == 2)
+        plan.numSamples = options.maxBlockSize;
+    else
+        plan.numSamples = 1 + random.range(options.maxBlockSize);
+
+    // Silence comes in stretches long enough to put the engine to sleep
+    if (random.range(64) == 0)
+        plan.silent = !plan.silent;
+    plan.flagSilent = plan.silent && random.range(2) == 0;
+
+    // Automation: nothing in most blocks, bursts of points in some
+    plan.points.clear();
+    if (random.range(4) != 0)
+        return;
+    const int numPoints = 1 + random.range(random.range(8) == 0 ? 64 : 4);
+    for (int i = 0; i < numPoints; i++)
+    {
+        // Keep the feedback low enough that the tail still ends and the sleep path is reached
+        const int index = random.range(kNumParams);
+        bool feedback = false;
+        for (int t = 0; t < DelayEngine::kMaxTaps; t++)
+            feedback = feedback || index == getTapParamIndex(t) + 2;
+        const double value = feedback ? random.unit() * 0.3 : random.unit();
+        plan.points.push_back({ index, plan.numSamples > 0 ? random.range(plan.numSamples) : 0, value });
+    }
+    std::stable_sort(plan.points.begin(), plan.points.end(),
+                     [](const Point& a, const Point& b) { return a.offset < b.offset; });
+}
+
+void fillInput(Random& random, const BlockPlan& plan, std::vector<std::vector<float>>& inputs)
+{
+    for (std::vector<float>& channel : inputs)
+    {
+        for (int n = 0; n < plan.numSamples; n++)
+            channel[n] = plan.silent ? 0.0f : static_cast<float>(random.unit() - 0.5);
+    }
+}
+
+//------------------------------------------------------------------------
+// The engine the way the processor drives it, without the SDK
+int runEngine(const Options& options)
+{
+    DelayEngine engine;
+    MultiChannelBuffer buffer;
+    engine.setRateReduction(options.rateReduction);
+    engine.setSampleRate(options.sampleRate);
+    buffer.setSize(DelayEngine::getRequiredCapacity(engine.getMaxDelay(), engine.getNetworkSampleRate()),
+                   options.numChannels);
+    engine.setConvolution(options.convolution, options.numChannels);
+    // Every tap in use, so the sorting and the kernel groups are exercised as well
+    Random setup(options.seed + 1);
+    engine.setNumTaps(DelayEngine::kMaxTaps);
+    for (int t = DelayEngine::kNumParamTaps; t < DelayEngine::kMaxTaps; t++)
+        engine.setTap(t, setup.unit(), setup.unit() * 0.5, 0.0);
+    engine.snapParameters();
+    engine.reset();
+
+    std::vector<std::vector<float>> inputs(options.numChannels, std::vector<float>(options.maxBlockSize));
+    std::vector<std::vector<float>> outputs(options.numChannels, std::vector<float>(options.maxBlockSize));
+    Random random(options.seed);
+    BlockPlan plan = { 0, false, false, {} };
+    plan.points.reserve(64);
+
+    std::thread audio([&] {
+        const float* in[MultiChannelBuffer::kMaxChannels];
+        float* out[MultiChannelBuffer::kMaxChannels];
+        for (long block = 0; block < options.numBlocks; block++)
+        {
+            planBlock(random, options, plan);
+            fillInput(random, plan, inputs);
+
+            RtSafety::Scope checked;
+            for (int c = 0; c < options.numChannels; c++)
+            {
+                in[c] = inputs[c].data();
+                out[c] = outputs[c].data();
+            }
+
+            // Asleep like the processor, on silent input into delay lines that have played out
+            if (plan.silent && engine.isTailSilent(options.numChannels))
+            {
+                for (const Point& p : plan.points)
+                    engine.setParameter(p.index, p.value);
+                if (!plan.points.empty())
+                    engine.snapParameters();
+                if (plan.flagSilent)
+                    engine.skipSilence(buffer, plan.numSamples);
+                else
+                    engine.processDry(buffer, in, out, plan.numSamples);
+                continue;
+            }
+
+            size_t point = 0;
+            int position = 0;
+            while (position < plan.numSamples)
+            {
+                while (point < plan.points.size() && plan.points[point].offset <= position)
+                {
+                    engine.setParameter(plan.points[point].index, plan.points[point].value);
+                    point++;
+                }
+                const int end = point < plan.points.size() ? plan.points[point].offset : plan.numSamples;
+                for (int c = 0; c < options.numChannels; c++)
+                {
+                    in[c] = inputs[c].data() + position;
+                    out[c] = outputs[c].data() + position;
+                }
+                engine.process(buffer, in, out, end - position);
+                position = end;
+            }
+            for (; point < plan.points.size(); point++)
+                engine.setParameter(plan.points[point].index, plan.points[point].value);
+        }
+    });
+    audio.join();
+    return 0;
+}
+
+#if DELAY2_RTCHECK_PROCESSOR
+
+//------------------------------------------------------------------------
+// The processor through the host calls, with a controller thread changing the max delay and loading presets meanwhile
+int runProcessor(const Options& options, Steinberg::Vst::SymbolicSampleSizes sampleSize)
+{
+    using namespace Steinberg;
+    using namespace Steinberg::Vst;
+
+    delayEffectProcessor::delay2Processor processor;
+    processor.initialize(nullptr);
+    processor.setConvolutionEnabled(options.convolution);
+    processor.setRateReduction(options.rateReduction);
+
+    // Any layout with the right channel count will do, wide ones run their channel groups in parallel
+    const int numChannels = options.numChannels;
+    SpeakerArrangement inputArrangement = numChannels >= 64 ? ~uint64(0) : (uint64(1) << numChannels) - 1;
+    SpeakerArrangement outputArrangement = inputArrangement;
+    processor.setBusArrangements(&inputArrangement, 1, &outputArrangement, 1);
+
+    ProcessSetup setup = { kRealtime, sampleSize, options.maxBlockSize, options.sampleRate };
+    processor.setupProcessing(setup);
+    processor.setActive(true);
+    processor.setProcessing(true);
+
+    // Both sample sizes get their own buffers, the unused one just sits there
+    std::vector<std::vector<Sample32>> inputs32(numChannels, std::vector<Sample32>(options.maxBlockSize));
+    std::vector<std::vector<Sample32>> outputs32(numChannels, std::vector<Sample32>(options.maxBlockSize));
+    std::vector<std::vector<Sample64>> inputs64(numChannels, std::vector<Sample64>(options.maxBlockSize));
+    std::vector<std::vector<Sample64>> outputs64(numChannels, std::vector<Sample64>(options.maxBlockSize));
+    std::vector<Sample32*> in32(numChannels);
+    std::vector<Sample32*> out32(numChannels);
+    std::vector<Sample64*> in64(numChannels);
+    std::vector<Sample64*> out64(numChannels);
+    for (int c = 0; c < numChannels; c++)
+    {
+        in32[c] = inputs32[c].data();
+        out32[c] = outputs32[c].data();
+        in64[c] = inputs64[c].data();
+        out64[c] = outputs64[c].data();
+    }
+
+    AudioBusBuffers inputBus;
+    AudioBusBuffers outputBus;
+    inputBus.numChannels = outputBus.numChannels = numChannels;
+    if (sampleSize == kSample64)
+    {
+        inputBus.channelBuffers64 = in64.data();
+        outputBus.channelBuffers64 = out64.data();
+    }
+    else
+    {
+        inputBus.channelBuffers32 = in32.data();
+        outputBus.channelBuffers32 = out32.data();
+    }
+
+    ParameterChanges changes(kNumParams);
+    ProcessData data;
+    data.processMode = kRealtime;
+    data.symbolicSampleSize = sampleSize;
+    data.numInputs = 1;
+    data.numOutputs = 1;
+    data.inputs = &inputBus;
+    data.outputs = &outputBus;
+    data.inputParameterChanges = &changes;
+
+    // The controller side: max delay changes grow the delay memory off the audio thread,
+    // and presets are saved and loaded the way a host switches them
+    std::atomic<bool> running(true);
+    std::thread controller([&] {
+        Random random(options.seed + 1);
+        while (running)
+        {
+            processor.setMaxDelay(DelayEngine::kMinMaxDelay + random.unit() * 4.0);
+
+            delayEffectProcessor::PluginState preset;
+            for (int i = 0; i < kNumParams; i++)
+                preset.values[i] = random.unit();
+            preset.maxDelaySeconds = processor.getMaxDelay();
+            preset.convolutionEnabled = options.convolution;
+            preset.rateReduction = options.rateReduction;
+            MemoryStream stream;
+            IBStreamer streamer(&stream, kLittleEndian);
+            preset.write(streamer);
+            stream.seek(0, IBStream::kIBSeekSet, nullptr);
+            processor.setState(&stream);
+
+            MemoryStream saved;
+            processor.getState(&saved);
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+    });
+
+    std::vector<std::vector<float>> plannedInput(numChannels, std::vector<float>(options.maxBlockSize));
+    Random random(options.seed);
+    BlockPlan plan = { 0, false, false, {} };
+    std::thread audio([&] {
+        for (long block = 0; block < options.numBlocks; block++)
+        {
+            planBlock(random, options, plan);
+            fillInput(random, plan, plannedInput);
+            for (int c = 0; c < numChannels; c++)
+            {
+                std::copy(plannedInput[c].begin(), plannedInput[c].begin() + plan.numSamples, inputs32[c].begin());
+                std::copy(plannedInput[c].begin(), plannedInput[c].begin() + plan.numSamples, inputs64[c].begin());
+            }
+            inputBus.silenceFlags = plan.flagSilent ? inputArrangement : 0;
+
+            // The queues are filled by the host before the call, which may allocate
+            changes.clearQueue();
+            for (const Point& point : plan.points)
+            {
+                int32 queueIndex = 0;
+                if (IParamValueQueue* queue = changes.addParameterData(kParamDescriptors[point.index].id, queueIndex))
+                {
+                    int32 pointIndex = 0;
+                    queue->addPoint(point.offset, point.value, pointIndex);
+                }
+            }
+            data.numSamples = plan.numSamples;
+
+            RtSafety::Scope checked;
+            processor.process(data);
+        }
+    });
+    audio.join();
+    running = false;
+    controller.join();
+
+    processor.setProcessing(false);
+    processor.setActive(false);
+    processor.terminate();
+    return 0;
+}
+
+#endif
+
+void printUsage()
+{
+    std::fprintf(stderr,
+        "usage: delay2-rtcheck [options]\n"
+        "  --engine              drive DelayEngine directly instead of the processor\n"
+        "  --blocks <count>      blocks to process, default 50000\n"
+        "  --max-block <frames>  largest block, default 4096\n"
+        "  --channels <count>    channels, default 2, at most 8 in --engine mode\n"
+        "  --rate <hz>           sample rate, default 48000\n"
+        "  --seed <number>       random stream to replay, default 1\n"
+        "  --convolution         enable the FFT convolution mode\n"
+        "  --eco <factor>        run the taps at 1/2 or 1/4 of the sample rate, 2 or 4\n"
+        "  --keep-going          count violations instead of aborting at the first\n");
+}
+
+bool parseOptions(int argc, char* argv[], Options& options)
+{
+    for (int i = 1; i < argc; i++)
+    {
+        const std::string arg = argv[i];
+        const bool hasValue = i + 1 < argc;
+        if (arg == "--engine")
+            options.processor = false;
+        else if (arg == "--blocks" && hasValue)
+            options.numBlocks = std::atol(argv[++i]);
+        else if (arg == "--max-block" && hasValue)
+            options.maxBlockSize = std::atoi(argv[++i]);
+        else if (arg == "--channels" && hasValue)
+            options.numChannels = std::atoi(argv[++i]);
+        else if (arg == "--rate" && hasValue)
+            options.sampleRate = std::atof(argv[++i]);
+        else if (arg == "--seed" && hasValue)
+            options.seed = static_cast<unsigned>(std::atol(argv[++i]));
+        else if (arg == "--convolution")
+            options.convolution = true;
+        else if (arg == "--eco" && hasValue)
+            options.rateReduction = std::atoi(argv[++i]);
+        else if (arg == "--keep-going")
+            options.keepGoing = true;
+        else
+            return false;
+    }
+#if DELAY2_RTCHECK_PROCESSOR
+    const int maxChannels = options.processor ? delayEffectProcessor::delay2Processor::kMaxBusChannels
+                                              : MultiChannelBuffer::kMaxChannels;
+#else
+    const int maxChannels = MultiChannelBuffer::kMaxChannels;
+#endif
+    return options.numBlocks > 0 && options.maxBlockSize > 0 && options.sampleRate > 0.0
+           && options.numChannels > 0 && options.numChannels <= maxChannels
+           && (options.rateReduction == 1 || options.rateReduction == 2 || options.rateReduction == 4);
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+int main(int argc, char* argv[])
+{
+    Options options;
+    if (!parseOptions(argc, argv, options))
+    {
+        printUsage();
+        return 2;
+    }
+
+    RtSafety::install();
+    RtSafety::setAbortOnViolation(!options.keepGoing);
+
+#if DELAY2_RTCHECK_PROCESSOR
+    if (options.processor)
+    {
+        runProcessor(options, Steinberg::Vst::kSample32);
+        runProcessor(options, Steinberg::Vst::kSample64);
+    }
+    else
+#endif
+        runEngine(options);
+
+    const int violations = RtSafety::getViolationCount();
+    std::printf("%s: %ld blocks, %d real-time violations\n", options.processor ? "processor" : "engine",
+                options.numBlocks, violations);
+    return violations == 0 ? 0 : 1;
+}
@@ -0,0 +1,409 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Traps allocations and blocking calls on threads marked as real-time.
+//------------------------------------------------------------------------
+
+#include "rtSafety.hpp"
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+
+#if defined(__linux__) || defined(__APPLE__)
+#include <execinfo.h>
+#include <unistd.h>
+#define DELAY2_HAS_BACKTRACE 1
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__)
+#include <dlfcn.h>
+#include <poll.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <sys/select.h>
+#include <time.h>
+#define DELAY2_TRAP_LIBC 1
+#endif
+
+namespace {
+
+// Plain types only: a thread_local with a constructor could allocate on first use
+thread_local int t_CheckDepth = 0;
+thread_local bool t_Reporting = false;
+
+std::atomic<bool> g_AbortOnViolation(true);
+std::atomic<int> g_Violations(0);
+
+// Writes straight to stderr, printf may allocate
+void writeMessage(const char* text)
+{
+#if DELAY2_HAS_BACKTRACE
+    ssize_t ignored = ::write(2, text, std::strlen(text));
+    (void)ignored;
+#else
+    std::fputs(text, stderr);
+#endif
+}
+
+// True if the call should go ahead unchecked. Otherwise reports it and either aborts or returns true
+// after counting, so the program can keep going.
+bool check(const char* function)
+{
+    if (t_CheckDepth == 0 || t_Reporting)
+        return true;
+
+    // Anything the report itself calls must not be reported again
+    t_Reporting = true;
+    g_Violations++;
+    writeMessage("real-time violation: ");
+    writeMessage(function);
+    writeMessage(" called on a real-time thread\n");
+#if DELAY2_HAS_BACKTRACE
+    void* frames[64];
+    const int numFrames = backtrace(frames, 64);
+    backtrace_symbols_fd(frames, numFrames, 2);
+#endif
+    if (g_AbortOnViolation)
+        std::abort();
+    t_Reporting = false;
+    return true;
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+namespace RtSafety {
+
+void enter()
+{
+    t_CheckDepth++;
+}
+
+void leave()
+{
+    t_CheckDepth--;
+}
+
+void setAbortOnViolation(bool abort)
+{
+    g_AbortOnViolation = abort;
+}
+
+int getViolationCount()
+{
+    return g_Violations.load();
+}
+
+} // namespace RtSafety
+
+//------------------------------------------------------------------------
+// malloc family and blocking calls, glibc only
+//------------------------------------------------------------------------
+#if DELAY2_TRAP_LIBC
+
+extern "C" {
+void* __libc_malloc(size_t size);
+void* __libc_calloc(size_t count, size_t size);
+void* __libc_realloc(void* pointer, size_t size);
+void* __libc_memalign(size_t alignment, size_t size);
+void __libc_free(void* pointer);
+}
+
+namespace {
+
+void* rawAllocate(size_t size)
+{
+    return __libc_malloc(size);
+}
+
+void rawFree(void* pointer)
+{
+    __libc_free(pointer);
+}
+
+void* rawAlignedAllocate(size_t alignment, size_t size)
+{
+    return __libc_memalign(alignment, size);
+}
+
+// The next definition of a wrapped function, looked up once
+template <typename Function>
+Function lookup(Function& cache, const char* name)
+{
+    if (cache == nullptr)
+        cache = reinterpret_cast<Function>(dlsym(RTLD_NEXT, name));
+    return cache;
+}
+
+int (*g_MutexLock)(pthread_mutex_t*);
+int (*g_CondWait)(pthread_cond_t*, pthread_mutex_t*);
+int (*g_CondTimedWait)(pthread_cond_t*, pthread_mutex_t*, const struct timespec*);
+int (*g_RwLockRead)(pthread_rwlock_t*);
+int (*g_RwLockWrite)(pthread_rwlock_t*);
+int (*g_Join)(pthread_t, void**);
+int (*g_SemWait)(sem_t*);
+int (*g_NanoSleep)(const struct timespec*, struct timespec*);
+int (*g_ClockNanoSleep)(clockid_t, int, const struct timespec*, struct timespec*);
+int (*g_USleep)(useconds_t);
+unsigned (*g_Sleep)(unsigned);
+ssize_t (*g_Read)(int, void*, size_t);
+ssize_t (*g_Write)(int, const void*, size_t);
+int (*g_Poll)(struct pollfd*, nfds_t, int);
+int (*g_Select)(int, fd_set*, fd_set*, fd_set*, struct timeval*);
+
+} // namespace
+
+void RtSafety::install()
+{
+    lookup(g_MutexLock, "pthread_mutex_lock");
+    lookup(g_CondWait, "pthread_cond_wait");
+    lookup(g_CondTimedWait, "pthread_cond_timedwait");
+    lookup(g_RwLockRead, "pthread_rwlock_rdlock");
+    lookup(g_RwLockWrite, "pthread_rwlock_wrlock");
+    lookup(g_Join, "pthread_join");
+    lookup(g_SemWait, "sem_wait");
+    lookup(g_NanoSleep, "nanosleep");
+    lookup(g_ClockNanoSleep, "clock_nanosleep");
+    lookup(g_USleep, "usleep");
+    lookup(g_Sleep, "sleep");
+    lookup(g_Read, "read");
+    lookup(g_Write, "write");
+    lookup(g_Poll, "poll");
+    lookup(g_Select, "select");
+}
+
+extern "C" {
+
+void* malloc(size_t size)
+{
+    check("malloc");
+    return __libc_malloc(size);
+}
+
+void* calloc(size_t count, size_t size)
+{
+    check("calloc");
+    return __libc_calloc(count, size);
+}
+
+void* realloc(void* pointer, size_t size)
+{
+    check("realloc");
+    return __libc_realloc(pointer, size);
+}
+
+void free(void* pointer)
+{
+    if (pointer != nullptr)
+        check("free");
+    __libc_free(pointer);
+}
+
+void* memalign(size_t alignment, size_t size)
+{
+    check("memalign");
+    return __libc_memalign(alignment, size);
+}
+
+void* aligned_alloc(size_t alignment, size_t size)
+{
+    check("aligned_alloc");
+    return __libc_memalign(alignment, size);
+}
+
+int posix_memalign(void** pointer, size_t alignment, size_t size)
+{
+    check("posix_memalign");
+    *pointer = __libc_memalign(alignment, size);
+    return *pointer != nullptr || size == 0 ? 0 : ENOMEM;
+}
+
+// Taking a mutex can block; trylock cannot and stays allowed
+int pthread_mutex_lock(pthread_mutex_t* mutex)
+{
+    check("pthread_mutex_lock");
+    return lookup(g_MutexLock, "pthread_mutex_lock")(mutex);
+}
+
+int pthread_cond_wait(pthread_cond_t* condition, pthread_mutex_t* mutex)
+{
+    check("pthread_cond_wait");
+    return lookup(g_CondWait, "pthread_cond_wait")(condition, mutex);
+}
+
+int pthread_cond_timedwait(pthread_cond_t* condition, pthread_mutex_t* mutex, const struct timespec* time)
+{
+    check("pthread_cond_timedwait");
+    return lookup(g_CondTimedWait, "pthread_cond_timedwait")(condition, mutex, time);
+}
+
+int pthread_rwlock_rdlock(pthread_rwlock_t* lock)
+{
+    check("pthread_rwlock_rdlock");
+    return lookup(g_RwLockRead, "pthread_rwlock_rdlock")(lock);
+}
+
+int pthread_rwlock_wrlock(pthread_rwlock_t* lock)
+{
+    check("pthread_rwlock_wrlock");
+    return lookup(g_RwLockWrite, "pthread_rwlock_wrlock")(lock);
+}
+
+int pthread_join(pthread_t thread, void** result)
+{
+    check("pthread_join");
+    return lookup(g_Join, "pthread_join")(thread, result);
+}
+
+int sem_wait(sem_t* semaphore)
+{
+    check("sem_wait");
+    return lookup(g_SemWait, "sem_wait")(semaphore);
+}
+
+int nanosleep(const struct timespec* duration, struct timespec* remaining)
+{
+    check("nanosleep");
+    return lookup(g_NanoSleep, "nanosleep")(duration, remaining);
+}
+
+int clock_nanosleep(clockid_t clock, int flags, const struct timespec* time, struct timespec* remaining)
+{
+    check("clock_nanosleep");
+    return lookup(g_ClockNanoSleep, "clock_nanosleep")(clock, flags, time, remaining);
+}
+
+int usleep(useconds_t microseconds)
+{
+    check("usleep");
+    return lookup(g_USleep, "usleep")(microseconds);
+}
+
+unsigned sleep(unsigned seconds)
+{
+    check("sleep");
+    return lookup(g_Sleep, "sleep")(seconds);
+}
+
+ssize_t read(int file, void* data, size_t size)
+{
+    check("read");
+    return lookup(g_Read, "read")(file, data, size);
+}
+
+ssize_t write(int file, const void* data, size_t size)
+{
+    check("write");
+    return lookup(g_Write, "write")(file, data, size);
+}
+
+int poll(struct pollfd* files, nfds_t numFiles, int timeout)
+{
+    check("poll");
+    return lookup(g_Poll, "poll")(files, numFiles, timeout);
+}
+
+int select(int numFiles, fd_set* readSet, fd_set* writeSet, fd_set* errorSet, struct timeval* timeout)
+{
+    check("select");
+    return lookup(g_Select, "select")(numFiles, readSet, writeSet, errorSet, timeout);
+}
+
+} // extern "C"
+
+#else
+
+namespace {
+
+void* rawAllocate(size_t size)
+{
+    return std::malloc(size);
+}
+
+void rawFree(void* pointer)
+{
+    std::free(pointer);
+}
+
+void* rawAlignedAllocate(size_t alignment, size_t size)
+{
+#if defined(_WIN32)
+    return _aligned_malloc(size, alignment);
+#else
+    void* pointer = nullptr;
+    return posix_memalign(&pointer, alignment, size) == 0 ? pointer : nullptr;
+#endif
+}
+
+} // namespace
+
+void RtSafety::install()
+{
+}
+
+#endif
+
+//------------------------------------------------------------------------
+// Global operator new and delete
+//------------------------------------------------------------------------
+namespace {
+
+void* allocate(size_t size, const char* function, bool throwing)
+{
+    check(function);
+    void* pointer = rawAllocate(size == 0 ? 1 : size);
+    if (pointer == nullptr && throwing)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void* allocateAligned(size_t size, std::align_val_t alignment, const char* function, bool throwing)
+{
+    check(function);
+    void* pointer = rawAlignedAllocate(static_cast<size_t>(alignment), size == 0 ? 1 : size);
+    if (pointer == nullptr && throwing)
+        throw std::bad_alloc();
+    return pointer;
+}
+
+void release(void* pointer, const char* function)
+{
+    if (pointer == nullptr)
+        return;
+    check(function);
+    rawFree(pointer);
+}
+
+void releaseAligned(void* pointer, const char* function)
+{
+    if (pointer == nullptr)
+        return;
+    check(function);
+#if defined(_WIN32) && !DELAY2_TRAP_LIBC
+    _aligned_free(pointer);
+#else
+    rawFree(pointer);
+#endif
+}
+
+} // namespace
+
+void* operator new(size_t size) { return allocate(size, "operator new", true); }
+void* operator new[](size_t size) { return allocate(size, "operator new[]", true); }
+void* operator new(size_t size, const std::nothrow_t&) noexcept { return allocate(size, "operator new", false); }
+void* operator new[](size_t size, const std::nothrow_t&) noexcept { return allocate(size, "operator new[]", false); }
+void* operator new(size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment, "operator new", true); }
+void* operator new[](size_t size, std::align_val_t alignment) { return allocateAligned(size, alignment, "operator new[]", true); }
+
+void operator delete(void* pointer) noexcept { release(pointer, "operator delete"); }
+void operator delete[](void* pointer) noexcept { release(pointer, "operator delete[]"); }
+void operator delete(void* pointer, size_t) noexcept { release(pointer, "operator delete"); }
+void operator delete[](void* pointer, size_t) noexcept { release(pointer, "operator delete[]"); }
+void operator delete(void* pointer, const std::nothrow_t&) noexcept { release(pointer, "operator delete"); }
+void operator delete[](void* pointer, const std::nothrow_t&) noexcept { release(pointer, "operator delete[]"); }
+void operator delete(void* pointer, std::align_val_t) noexcept { releaseAligned(pointer, "operator delete"); }
+void operator delete[](void* pointer, std::align_val_t) noexcept { releaseAligned(pointer, "operator delete[]"); }
+void operator delete(void* pointer, size_t, std::align_val_t) noexcept { releaseAligned(pointer, "operator delete"); }
+void operator delete[](void* pointer, size_t, std::align_val_t) noexcept { releaseAligned(pointer, "operator delete[]"); }
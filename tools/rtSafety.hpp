@@ -0,0 +1,44 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Traps allocations and blocking calls on threads marked as real-time.
+//------------------------------------------------------------------------
+
+#pragma once
+
+//------------------------------------------------------------------------
+//  RtSafety
+//------------------------------------------------------------------------
+// Linking rtSafety.cpp into an executable replaces the global operator
+// new and delete and, on Linux, malloc and friends plus the pthread, sleep
+// and file I/O calls that can block. Outside a checked region they behave
+// as usual. Inside one, on the thread that entered it, every call is a
+// violation: it is reported with a stack trace, then the process aborts
+// or the violation is counted, whichever was asked for.
+//
+// On other platforms only operator new and delete are trapped.
+namespace RtSafety {
+
+/** Resolves the wrapped functions up front, so the first check does not have to.
+    Call once from main before any checked region. */
+void install();
+
+/** Marks the calling thread as real-time until the matching leave() */
+void enter();
+void leave();
+
+/** Report and abort on the first violation (the default), or report and count */
+void setAbortOnViolation(bool abort);
+
+/** Violations counted so far, over all threads */
+int getViolationCount();
+
+// enter() and leave() for a scope
+struct Scope
+{
+    Scope() { enter(); }
+    ~Scope() { leave(); }
+    Scope(const Scope&) = delete;
+    Scope& operator=(const Scope&) = delete;
+};
+
+} // namespace RtSafety
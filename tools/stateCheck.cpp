@@ -0,0 +1,106 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// State check: feeds PluginState::read saved states, intact and corrupted,
+// and exits non-zero when it accepts a blob it should reject or the other
+// way round.
+//------------------------------------------------------------------------
+
+#include "delayEngine.hpp"
+#include "pluginState.h"
+#include "public.sdk/source/common/memorystream.h"
+#include <cstdio>
+#include <functional>
+#include <limits>
+#include <vector>
+
+using namespace Steinberg;
+using namespace delayEffectProcessor;
+
+namespace {
+
+// The bytes write produces for a state, after 'change' edited it
+std::vector<char> writeState(const std::function<void(PluginState&)>& change)
+{
+    PluginState state;
+    change(state);
+    MemoryStream stream;
+    IBStreamer streamer(&stream, kLittleEndian);
+    state.write(streamer);
+    return std::vector<char>(stream.getData(), stream.getData() + stream.getSize());
+}
+
+// Reads the bytes back into 'state', as the processor and controller do
+bool readState(std::vector<char> bytes, PluginState& state)
+{
+    MemoryStream stream(bytes.data(), static_cast<TSize>(bytes.size()));
+    IBStreamer streamer(&stream, kLittleEndian);
+    return state.read(streamer);
+}
+
+struct Case
+{
+    const char* name;
+    std::vector<char> bytes;
+    bool accepted;
+};
+
+} // namespace
+
+//------------------------------------------------------------------------
+int main()
+{
+    const double nan = std::numeric_limits<double>::quiet_NaN();
+    const double infinity = std::numeric_limits<double>::infinity();
+
+    std::vector<char> intact = writeState([](PluginState& state) {
+        state.values[getParamIndex(kParamWetMixId)] = 0.25;
+        state.maxDelaySeconds = 2.5;
+        state.convolutionEnabled = true;
+        state.rateReduction = 2;
+    });
+    std::vector<char> truncated(intact.begin(), intact.end() - 1);
+    std::vector<char> badMagic = intact;
+    badMagic[0] ^= 1;
+
+    const Case cases[] = {
+        { "intact", intact, true },
+        { "empty", {}, true },
+        { "truncated", truncated, false },
+        { "bad magic", badMagic, false },
+        { "NaN parameter", writeState([&](PluginState& state) { state.values[0] = nan; }), false },
+        { "infinite parameter", writeState([&](PluginState& state) { state.values[kNumParams - 1] = -infinity; }), false },
+        { "NaN max delay", writeState([&](PluginState& state) { state.maxDelaySeconds = nan; }), false },
+        { "infinite max delay", writeState([&](PluginState& state) { state.maxDelaySeconds = infinity; }), false },
+        { "rate reduction 0", writeState([](PluginState& state) { state.rateReduction = 0; }), false },
+        { "rate reduction 3", writeState([](PluginState& state) { state.rateReduction = 3; }), false },
+        { "rate reduction 8", writeState([](PluginState& state) { state.rateReduction = 8; }), false },
+        { "long max delay", writeState([](PluginState& state) { state.maxDelaySeconds = 1e9; }), true },
+    };
+
+    int failures = 0;
+    for (const Case& test : cases)
+    {
+        PluginState state;
+        const bool accepted = readState(test.bytes, state);
+        bool ok = accepted == test.accepted;
+
+        // What is accepted has to be safe to hand to the engine
+        if (ok && accepted)
+            ok = state.maxDelaySeconds >= DelayEngine::kMinMaxDelay && state.maxDelaySeconds <= DelayEngine::kMaxMaxDelay;
+        std::printf("%-20s %s%s\n", test.name, accepted ? "accepted" : "rejected", ok ? "" : "  FAILED");
+        failures += ok ? 0 : 1;
+    }
+
+    // The intact state comes back as it was written
+    PluginState state;
+    if (!readState(intact, state) || state.values[getParamIndex(kParamWetMixId)] != 0.25
+        || state.maxDelaySeconds != 2.5 || !state.convolutionEnabled || state.rateReduction != 2)
+    {
+        std::printf("round trip FAILED\n");
+        failures++;
+    }
+
+    std::printf("%d of %d passed\n", static_cast<int>(sizeof(cases) / sizeof(cases[0])) + 1 - failures,
+                static_cast<int>(sizeof(cases) / sizeof(cases[0])) + 1);
+    return failures == 0 ? 0 : 1;
+}
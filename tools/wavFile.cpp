@@ -0,0 +1,340 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Streaming WAV reader and writer for the command-line tools.
+//------------------------------------------------------------------------
+
+#include "wavFile.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace {
+
+const uint16_t kFormatPcm = 1;
+const uint16_t kFormatFloat = 3;
+const uint16_t kFormatExtensible = 0xFFFE;
+
+// Size of the header WavWriter writes: RIFF, fmt and data chunk headers
+const size_t kHeaderSize = 44;
+
+// Bytes collected before each write to the file
+const size_t kStagingSize = 1 << 16;
+
+uint32_t readU32(const unsigned char* p)
+{
+    return uint32_t(p[0]) | uint32_t(p[1]) << 8 | uint32_t(p[2]) << 16 | uint32_t(p[3]) << 24;
+}
+
+uint16_t readU16(const unsigned char* p)
+{
+    return uint16_t(p[0] | p[1] << 8);
+}
+
+void writeU32(unsigned char* p, uint32_t value)
+{
+    for (int i = 0; i < 4; i++)
+        p[i] = static_cast<unsigned char>(value >> (8 * i));
+}
+
+void writeU16(unsigned char* p, uint16_t value)
+{
+    p[0] = static_cast<unsigned char>(value);
+    p[1] = static_cast<unsigned char>(value >> 8);
+}
+
+bool isSupported(const WavFormat& format)
+{
+    if (format.numChannels <= 0 || format.sampleRate <= 0)
+        return false;
+    if (format.isFloat)
+        return format.bitsPerSample == 32 || format.bitsPerSample == 64;
+    return format.bitsPerSample == 16 || format.bitsPerSample == 24 || format.bitsPerSample == 32;
+}
+
+// One sample of 'format' at 'p' as a float in [-1, 1)
+float decodeSample(const unsigned char* p, const WavFormat& format)
+{
+    if (format.isFloat)
+    {
+        if (format.bitsPerSample == 32)
+        {
+            float value;
+            std::memcpy(&value, p, sizeof(value));
+            return value;
+        }
+        double value;
+        std::memcpy(&value, p, sizeof(value));
+        return static_cast<float>(value);
+    }
+
+    switch (format.bitsPerSample)
+    {
+        case 16:
+            return static_cast<int16_t>(readU16(p)) * (1.0f / 32768.0f);
+        case 24:
+            // Shift the 24 bits to the top so the sign comes along
+            return static_cast<int32_t>(uint32_t(p[0]) << 8 | uint32_t(p[1]) << 16 | uint32_t(p[2]) << 24)
+                   * (1.0f / 2147483648.0f);
+        default:
+            return static_cast<int32_t>(readU32(p)) * (1.0f / 2147483648.0f);
+    }
+}
+
+// 'value' as one sample of 'format' at 'p'
+void encodeSample(unsigned char* p, float value, const WavFormat& format)
+{
+    if (format.isFloat)
+    {
+        if (format.bitsPerSample == 32)
+        {
+            std::memcpy(p, &value, sizeof(value));
+            return;
+        }
+        const double wide = value;
+        std::memcpy(p, &wide, sizeof(wide));
+        return;
+    }
+
+    const double clipped = std::min(std::max(static_cast<double>(value), -1.0), 1.0);
+    switch (format.bitsPerSample)
+    {
+        case 16:
+            writeU16(p, static_cast<uint16_t>(static_cast<int16_t>(std::min(std::lround(clipped * 32768.0), 32767L))));
+            break;
+        case 24:
+        {
+            const int32_t sample = static_cast<int32_t>(std::min(std::lround(clipped * 8388608.0), 8388607L));
+            p[0] = static_cast<unsigned char>(sample);
+            p[1] = static_cast<unsigned char>(sample >> 8);
+            p[2] = static_cast<unsigned char>(sample >> 16);
+            break;
+        }
+        default:
+            writeU32(p, static_cast<uint32_t>(static_cast<int32_t>(std::min(std::llround(clipped * 2147483648.0), 2147483647LL))));
+            break;
+    }
+}
+
+} // namespace
+
+//------------------------------------------------------------------------
+bool parseSampleFormat(const char* name, WavFormat& format)
+{
+    struct Entry { const char* name; int bits; bool isFloat; };
+    static const Entry kFormats[] = {
+        { "pcm16", 16, false }, { "pcm24", 24, false }, { "pcm32", 32, false },
+        { "float32", 32, true }, { "float64", 64, true },
+    };
+    for (const Entry& entry : kFormats)
+    {
+        if (std::strcmp(entry.name, name) == 0)
+        {
+            format.bitsPerSample = entry.bits;
+            format.isFloat = entry.isFloat;
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------
+WavReader::WavReader()
+{
+    m_Format = { 0, 0, 0, false };
+    m_Samples = nullptr;
+    m_NumFrames = 0;
+    m_Position = 0;
+}
+
+//------------------------------------------------------------------------
+bool WavReader::open(const char* path, const char*& error)
+{
+    m_Samples = nullptr;
+    m_NumFrames = 0;
+    m_Position = 0;
+    if (!m_File.open(path))
+    {
+        error = "cannot open file";
+        return false;
+    }
+
+    const unsigned char* data = m_File.getData();
+    const size_t size = m_File.getSize();
+    if (size < 12 || std::memcmp(data, "RIFF", 4) != 0 || std::memcmp(data + 8, "WAVE", 4) != 0)
+    {
+        error = "not a RIFF WAVE file";
+        return false;
+    }
+
+    // Walk the chunks; fmt has to come before data
+    bool haveFormat = false;
+    size_t offset = 12;
+    while (offset + 8 <= size)
+    {
+        const unsigned char* chunk = data + offset;
+        const uint32_t chunkSize = readU32(chunk + 4);
+        const size_t available = std::min<size_t>(chunkSize, size - offset - 8);
+
+        if (std::memcmp(chunk, "fmt ", 4) == 0 && available >= 16)
+        {
+            uint16_t tag = readU16(chunk + 8);
+            m_Format.numChannels = readU16(chunk + 10);
+            m_Format.sampleRate = static_cast<int>(readU32(chunk + 12));
+            m_Format.bitsPerSample = readU16(chunk + 22);
+            // The sub format GUID starts with the actual format tag
+            if (tag == kFormatExtensible && available >= 26)
+                tag = readU16(chunk + 32);
+            m_Format.isFloat = tag == kFormatFloat;
+            if ((tag != kFormatPcm && tag != kFormatFloat) || !isSupported(m_Format))
+            {
+                error = "unsupported sample format";
+                return false;
+            }
+            haveFormat = true;
+        }
+        else if (std::memcmp(chunk, "data", 4) == 0)
+        {
+            if (!haveFormat)
+            {
+                error = "data chunk before fmt chunk";
+                return false;
+            }
+            // A file cut short still plays up to where it ends
+            m_Samples = chunk + 8;
+            m_NumFrames = static_cast<int64_t>(available / m_Format.getBytesPerFrame());
+            return true;
+        }
+
+        // Chunks are padded to an even size
+        offset += 8 + static_cast<size_t>(chunkSize) + (chunkSize & 1);
+    }
+
+    error = haveFormat ? "no data chunk" : "no fmt chunk";
+    return false;
+}
+
+//------------------------------------------------------------------------
+int WavReader::read(float* const* channels, int maxFrames)
+{
+    const int numFrames = static_cast<int>(std::min<int64_t>(maxFrames, m_NumFrames - m_Position));
+    if (numFrames <= 0)
+        return 0;
+
+    const int bytesPerSample = m_Format.bitsPerSample / 8;
+    const int bytesPerFrame = m_Format.getBytesPerFrame();
+    const unsigned char* frame = m_Samples + m_Position * bytesPerFrame;
+    for (int n = 0; n < numFrames; n++, frame += bytesPerFrame)
+    {
+        for (int c = 0; c < m_Format.numChannels; c++)
+            channels[c][n] = decodeSample(frame + c * bytesPerSample, m_Format);
+    }
+
+    m_Position += numFrames;
+    m_File.release(static_cast<size_t>(frame - m_File.getData()));
+    return numFrames;
+}
+
+//------------------------------------------------------------------------
+WavWriter::WavWriter()
+{
+    m_File = nullptr;
+    m_Format = { 0, 0, 0, false };
+    m_NumFrames = 0;
+    m_Failed = false;
+    m_StagingUsed = 0;
+}
+
+//------------------------------------------------------------------------
+WavWriter::~WavWriter()
+{
+    close();
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::open(const char* path, const WavFormat& format)
+{
+    close();
+    if (!isSupported(format))
+        return false;
+    m_File = std::fopen(path, "wb");
+    if (m_File == nullptr)
+        return false;
+
+    m_Format = format;
+    m_NumFrames = 0;
+    m_Failed = false;
+    m_Staging.resize(std::max<size_t>(kStagingSize, format.getBytesPerFrame()));
+    m_StagingUsed = 0;
+
+    // Sizes are left at 0 until close
+    unsigned char header[kHeaderSize] = {};
+    std::memcpy(header, "RIFF", 4);
+    std::memcpy(header + 8, "WAVEfmt ", 8);
+    writeU32(header + 16, 16);
+    writeU16(header + 20, format.isFloat ? kFormatFloat : kFormatPcm);
+    writeU16(header + 22, static_cast<uint16_t>(format.numChannels));
+    writeU32(header + 24, static_cast<uint32_t>(format.sampleRate));
+    writeU32(header + 28, static_cast<uint32_t>(format.sampleRate * format.getBytesPerFrame()));
+    writeU16(header + 32, static_cast<uint16_t>(format.getBytesPerFrame()));
+    writeU16(header + 34, static_cast<uint16_t>(format.bitsPerSample));
+    std::memcpy(header + 36, "data", 4);
+    m_Failed = std::fwrite(header, 1, kHeaderSize, m_File) != kHeaderSize;
+    return !m_Failed;
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::write(const float* const* channels, int numFrames)
+{
+    if (m_File == nullptr)
+        return false;
+
+    const int bytesPerSample = m_Format.bitsPerSample / 8;
+    const size_t bytesPerFrame = m_Format.getBytesPerFrame();
+    for (int n = 0; n < numFrames; n++)
+    {
+        if (m_StagingUsed + bytesPerFrame > m_Staging.size() && !flush())
+            return false;
+        unsigned char* frame = &m_Staging[m_StagingUsed];
+        for (int c = 0; c < m_Format.numChannels; c++)
+            encodeSample(frame + c * bytesPerSample, channels[c][n], m_Format);
+        m_StagingUsed += bytesPerFrame;
+    }
+    m_NumFrames += numFrames;
+    return true;
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::flush()
+{
+    if (m_StagingUsed > 0 && std::fwrite(m_Staging.data(), 1, m_StagingUsed, m_File) != m_StagingUsed)
+        m_Failed = true;
+    m_StagingUsed = 0;
+    return !m_Failed;
+}
+
+//------------------------------------------------------------------------
+bool WavWriter::close()
+{
+    if (m_File == nullptr)
+        return !m_Failed;
+
+    flush();
+
+    // RIFF sizes are 32 bit; longer files keep the largest size that fits, which most readers accept
+    const uint64_t dataBytes = static_cast<uint64_t>(m_NumFrames) * m_Format.getBytesPerFrame();
+    const uint32_t dataSize = static_cast<uint32_t>(std::min<uint64_t>(dataBytes, 0xFFFFFFFFu - kHeaderSize));
+    if (dataBytes & 1)
+    {
+        const unsigned char pad = 0;
+        m_Failed |= std::fwrite(&pad, 1, 1, m_File) != 1;
+    }
+
+    unsigned char size[4];
+    writeU32(size, dataSize + static_cast<uint32_t>(kHeaderSize) - 8 + (dataSize & 1));
+    m_Failed |= std::fseek(m_File, 4, SEEK_SET) != 0 || std::fwrite(size, 1, 4, m_File) != 4;
+    writeU32(size, dataSize);
+    m_Failed |= std::fseek(m_File, 40, SEEK_SET) != 0 || std::fwrite(size, 1, 4, m_File) != 4;
+    m_Failed |= std::fclose(m_File) != 0;
+    m_File = nullptr;
+    return !m_Failed;
+}
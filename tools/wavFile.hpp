@@ -0,0 +1,98 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Streaming WAV reader and writer for the command-line tools.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include "mappedFile.hpp"
+#include <cstdint>
+#include <cstdio>
+#include <vector>
+
+//------------------------------------------------------------------------
+//  WavFormat
+//------------------------------------------------------------------------
+// The sample formats both sides handle: 16, 24 and 32 bit PCM and 32 and
+// 64 bit float, plain or WAVE_FORMAT_EXTENSIBLE.
+struct WavFormat
+{
+    int numChannels;
+    int sampleRate;
+    int bitsPerSample;
+    bool isFloat;
+
+    int getBytesPerFrame() const { return numChannels * (bitsPerSample / 8); }
+};
+
+/** Sets the sample format of 'format' from a name: pcm16, pcm24, pcm32, float32 or float64.
+    Returns false for any other name. */
+bool parseSampleFormat(const char* name, WavFormat& format);
+
+//------------------------------------------------------------------------
+//  WavReader
+//------------------------------------------------------------------------
+// Reads the data chunk of a memory-mapped WAV file block by block into
+// planar floats, releasing the pages it has passed.
+class WavReader
+{
+public:
+    WavReader();
+
+    /** Maps 'path' and parses its header, returns false with a message in 'error' if that fails */
+    bool open(const char* path, const char*& error);
+
+    const WavFormat& getFormat() const { return m_Format; }
+    int64_t getNumFrames() const { return m_NumFrames; }
+    int64_t getPosition() const { return m_Position; }
+
+    /** Converts up to 'maxFrames' frames into one array per channel, returns how many were read */
+    int read(float* const* channels, int maxFrames);
+
+    /** Starts reading from the first frame again */
+    void rewind() { m_Position = 0; }
+
+private:
+    MappedFile m_File;
+    WavFormat m_Format;
+    const unsigned char* m_Samples;
+    int64_t m_NumFrames;
+    int64_t m_Position;
+};
+
+//------------------------------------------------------------------------
+//  WavWriter
+//------------------------------------------------------------------------
+// Writes planar floats through a fixed-size staging buffer and fills in the
+// chunk sizes on close, so any length can be written in constant memory.
+class WavWriter
+{
+public:
+    WavWriter();
+    ~WavWriter();
+
+    WavWriter(const WavWriter&) = delete;
+    WavWriter& operator=(const WavWriter&) = delete;
+
+    /** Creates 'path' and writes a header for 'format', returns false if the file cannot be created */
+    bool open(const char* path, const WavFormat& format);
+
+    /** Converts and appends 'numFrames' frames, PCM output is clipped and rounded */
+    bool write(const float* const* channels, int numFrames);
+
+    /** Flushes, patches the header and closes the file, returns false if anything failed to write */
+    bool close();
+
+    int64_t getNumFrames() const { return m_NumFrames; }
+
+private:
+    bool flush();
+
+    FILE* m_File;
+    WavFormat m_Format;
+    int64_t m_NumFrames;
+    bool m_Failed;
+
+    std::vector<unsigned char> m_Staging;
+    size_t m_StagingUsed;
+};
@@ -0,0 +1,80 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Thread pool that runs a fixed set of jobs, idle workers steal from busy ones.
+//------------------------------------------------------------------------
+
+#include "workStealingPool.hpp"
+#include <algorithm>
+#include <numeric>
+#include <thread>
+
+//------------------------------------------------------------------------
+WorkStealingPool::WorkStealingPool(int numWorkers)
+{
+    if (numWorkers <= 0)
+        numWorkers = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    for (int w = 0; w < numWorkers; w++)
+        m_Queues.emplace_back(new Queue());
+}
+
+//------------------------------------------------------------------------
+void WorkStealingPool::run(const std::vector<int64_t>& costs, const Job& job)
+{
+    // Most expensive first, dealt round robin so every queue gets a share of the big jobs
+    std::vector<int> order(costs.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&costs](int a, int b) { return costs[a] > costs[b]; });
+
+    const int numWorkers = getNumWorkers();
+    for (size_t i = 0; i < order.size(); i++)
+        m_Queues[i % numWorkers]->jobs.push_back(order[i]);
+
+    // No point in starting threads that would only find empty queues
+    const int numThreads = std::min(numWorkers, static_cast<int>(order.size()));
+    std::vector<std::thread> threads;
+    for (int w = 1; w < numThreads; w++)
+        threads.emplace_back(&WorkStealingPool::work, this, w, std::cref(job));
+    work(0, job);
+    for (std::thread& thread : threads)
+        thread.join();
+}
+
+//------------------------------------------------------------------------
+bool WorkStealingPool::takeOwn(int worker, int& job)
+{
+    Queue& queue = *m_Queues[worker];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty())
+        return false;
+    job = queue.jobs.front();
+    queue.jobs.pop_front();
+    return true;
+}
+
+//------------------------------------------------------------------------
+bool WorkStealingPool::steal(int worker, int& job)
+{
+    // Start with the next worker rather than always robbing worker 0
+    const int numWorkers = getNumWorkers();
+    for (int i = 1; i < numWorkers; i++)
+    {
+        Queue& victim = *m_Queues[(worker + i) % numWorkers];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.jobs.empty())
+        {
+            job = victim.jobs.back();
+            victim.jobs.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+//------------------------------------------------------------------------
+void WorkStealingPool::work(int worker, const Job& job)
+{
+    // Jobs are never added while running, so once stealing fails everything has been handed out
+    int index = 0;
+    while (takeOwn(worker, index) || steal(worker, index))
+        job(worker, index);
+}
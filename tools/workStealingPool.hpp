@@ -0,0 +1,53 @@
+//------------------------------------------------------------------------
+// Copyright(c) 2023 Oberon Day-West.
+// Thread pool that runs a fixed set of jobs, idle workers steal from busy ones.
+//------------------------------------------------------------------------
+
+#pragma once
+
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+//------------------------------------------------------------------------
+//  WorkStealingPool
+//------------------------------------------------------------------------
+// Every worker owns a queue of job indices. The jobs are dealt out by cost,
+// so each queue starts with a similar amount of work, and a worker runs
+// its own most expensive job first. A worker whose queue is empty takes the
+// cheapest job from the back of another worker's queue, so stragglers are
+// spread out instead of leaving cores idle at the end of a batch.
+//
+// The queues are only touched between jobs, so a mutex per queue is cheap
+// next to the jobs themselves (whole files here).
+class WorkStealingPool
+{
+public:
+    // Runs job 'job' on worker 'worker', 0..getNumWorkers()-1
+    typedef std::function<void(int worker, int job)> Job;
+
+    /** 'numWorkers' of 0 uses one worker per hardware thread */
+    explicit WorkStealingPool(int numWorkers);
+
+    int getNumWorkers() const { return static_cast<int>(m_Queues.size()); }
+
+    /** Runs 'job' for every index of 'costs' and returns once all have finished. The
+        costs only decide the order, any unit will do. The calling thread is worker 0. */
+    void run(const std::vector<int64_t>& costs, const Job& job);
+
+private:
+    struct Queue
+    {
+        std::mutex mutex;
+        std::deque<int> jobs;  // most expensive at the front
+    };
+
+    bool takeOwn(int worker, int& job);
+    bool steal(int worker, int& job);
+    void work(int worker, const Job& job);
+
+    std::vector<std::unique_ptr<Queue>> m_Queues;
+};